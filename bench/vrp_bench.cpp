@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <utility>
+
+#include <benchmark/benchmark.h>
+
+#include "assignment.h"
+#include "candidates.h"
+#include "haversine.h"
+#include "heuristic.h"
+#include "incremental.h"
+#include "relations.h"
+#include "solverlog.h"
+#include "synthetic.h"
+#include "vrp.h"
+
+/* Benchmarks on generated rosters (see synthetic.h), so they run without the input files, geocoding or network.
+Arguments are {employees, targets}. The solver benchmarks report the total km of their solution as a counter,
+to catch quality regressions next to speed ones (the heuristic ones also their gap to the exact solution).
+For numbers to keep around:
+    ./vrp_bench --benchmark_out=bench.json --benchmark_out_format=json */
+
+// a generated roster with its distances, made once per size
+struct Roster {
+    std::vector<Employee> employees;
+    std::vector<Target> targets;
+    DistanceMatrix distances;
+    RelationGraph relations;
+};
+
+static const Roster& roster(int num_employees, int num_targets)
+{
+    static std::map<std::pair<int, int>, Roster> rosters;
+    auto it = rosters.find({num_employees, num_targets});
+    if (it != rosters.end()) return it->second;
+
+    SyntheticOptions options;
+    options.num_employees = num_employees;
+    options.num_targets = num_targets;
+
+    Roster& r = rosters[{num_employees, num_targets}];
+    generateRoster(options, r.employees, r.targets);
+    r.distances = buildDistanceMatrix(r.employees, r.targets);
+    r.relations = buildRelations(r.employees);
+    return r;
+}
+
+// the solvers print their status, keep that out of the benchmark report
+class QuietSolvers {
+public:
+    QuietSolvers() { setSolverLog(nullptr); }
+    ~QuietSolvers() { setSolverLog(&std::cout); }
+};
+
+static void reportResult(benchmark::State& state, const AssignmentResult& result)
+{
+    if (!result.solved()) {
+        state.SkipWithError("no solution found");
+        return;
+    }
+    state.counters["total_km"] = result.total_km;
+    state.counters["longest_km"] = result.longest_km;
+}
+
+static void BM_Haversine(benchmark::State& state)
+{
+    const Roster& r = roster(1000, 1);
+    const Target& tar = r.targets[0];
+    for (auto _ : state) {
+        float sum = 0;
+        for (const auto& emp : r.employees) {
+            sum += haversine(emp.lat, emp.lon, tar.lat, tar.lon);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * r.employees.size());
+}
+BENCHMARK(BM_Haversine);
+
+// the same distances as BM_Haversine through the batch kernel (prepared points, simd when available)
+static void BM_HaversineBatch(benchmark::State& state)
+{
+    const Roster& r = roster(1000, 1);
+    Precision precision = state.range(0) ? Precision::Double : Precision::Single;
+    std::vector<float> emp_lat, emp_lon;
+    for (const auto& emp : r.employees) {
+        emp_lat.push_back(emp.lat);
+        emp_lon.push_back(emp.lon);
+    }
+    PreparedPoints from = preparePoints({r.targets[0].lat}, {r.targets[0].lon}, precision);
+    PreparedPoints to = preparePoints(emp_lat, emp_lon, precision);
+    std::vector<float> out(to.size());
+    for (auto _ : state) {
+        haversineBatch(from, 0, to, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * r.employees.size());
+    state.SetLabel(haversineKernelName());
+}
+BENCHMARK(BM_HaversineBatch)->Arg(0)->Arg(1);
+
+static void BM_DistanceMatrix(benchmark::State& state)
+{
+    const Roster& r = roster(state.range(0), state.range(1));
+    Precision precision = state.range(2) ? Precision::Double : Precision::Single;
+    for (auto _ : state) {
+        DistanceMatrix distances = buildDistanceMatrix(r.employees, r.targets, precision);
+        benchmark::DoNotOptimize(distances.dist.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1));
+    state.SetLabel(haversineKernelName());
+}
+BENCHMARK(BM_DistanceMatrix)->Args({1000, 50, 0})->Args({10000, 200, 0})->Args({10000, 200, 1})->Unit(benchmark::kMillisecond);
+
+static void BM_BuildRelations(benchmark::State& state)
+{
+    const Roster& r = roster(state.range(0), state.range(1));
+    for (auto _ : state) {
+        RelationGraph relations = buildRelations(r.employees);
+        benchmark::DoNotOptimize(relations.conflicts.data());
+    }
+}
+BENCHMARK(BM_BuildRelations)->Args({10000, 1})->Unit(benchmark::kMicrosecond);
+
+static void BM_BuildCandidates(benchmark::State& state)
+{
+    const Roster& r = roster(state.range(0), state.range(1));
+    PruningOptions pruning;
+    pruning.k_nearest = state.range(2);
+    for (auto _ : state) {
+        CandidateArcs arcs = buildCandidates(r.distances, r.targets, pruning);
+        benchmark::DoNotOptimize(arcs.allowed.data());
+    }
+}
+BENCHMARK(BM_BuildCandidates)->Args({2000, 100, 0})->Args({2000, 100, 50})->Unit(benchmark::kMicrosecond);
+
+// building the full enemies and friends MIP (variables, rows, friend rewards) without solving it
+static void BM_BuildModel(benchmark::State& state)
+{
+    const Roster& r = roster(state.range(0), state.range(1));
+    for (auto _ : state) {
+        operations_research::IncrementalAssigner assigner(r.distances, r.employees, r.targets, r.relations);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_BuildModel)->Args({100, 10})->Args({400, 30})->Unit(benchmark::kMillisecond);
+
+static void BM_AssignEmployees(benchmark::State& state)
+{
+    const Roster& r = roster(state.range(0), state.range(1));
+    std::vector<Employee> employees = r.employees;
+    std::vector<Target> targets = r.targets;
+    AssignmentResult result;
+    for (auto _ : state) {
+        QuietSolvers quiet;
+        result = operations_research::assignEmployees(r.distances, employees, targets);
+    }
+    reportResult(state, result);
+}
+BENCHMARK(BM_AssignEmployees)->Args({100, 10})->Args({400, 30})->Unit(benchmark::kMillisecond);
+
+static void BM_AssignEmployeesMinCostFlow(benchmark::State& state)
+{
+    const Roster& r = roster(state.range(0), state.range(1));
+    std::vector<Employee> employees = r.employees;
+    std::vector<Target> targets = r.targets;
+    AssignmentResult result;
+    for (auto _ : state) {
+        QuietSolvers quiet;
+        result = operations_research::assignEmployeesMinCostFlow(r.distances, employees, targets);
+    }
+    reportResult(state, result);
+}
+BENCHMARK(BM_AssignEmployeesMinCostFlow)->Args({100, 10})->Args({400, 30})->Args({2000, 100})->Unit(benchmark::kMillisecond);
+
+static void BM_AssignEmployeesBalanced(benchmark::State& state)
+{
+    const Roster& r = roster(state.range(0), state.range(1));
+    std::vector<Employee> employees = r.employees;
+    std::vector<Target> targets = r.targets;
+    AssignmentResult result;
+    for (auto _ : state) {
+        QuietSolvers quiet;
+        result = operations_research::assignEmployeesBalanced(r.distances, employees, targets);
+    }
+    reportResult(state, result);
+}
+BENCHMARK(BM_AssignEmployeesBalanced)->Args({100, 10})->Args({400, 30})->Args({2000, 100})->Unit(benchmark::kMillisecond);
+
+static void BM_AssignEmployeesEnemiesAndFriends(benchmark::State& state)
+{
+    const Roster& r = roster(state.range(0), state.range(1));
+    std::vector<Employee> employees = r.employees;
+    std::vector<Target> targets = r.targets;
+    AssignmentResult result;
+    for (auto _ : state) {
+        QuietSolvers quiet;
+        result = operations_research::assignEmployeesEnemiesAndFriends(r.distances, employees, targets, r.relations);
+    }
+    reportResult(state, result);
+}
+BENCHMARK(BM_AssignEmployeesEnemiesAndFriends)->Args({100, 10})->Args({400, 30})->Unit(benchmark::kMillisecond);
+
+static void BM_AssignEmployeesEnemiesAndFriendsCpSat(benchmark::State& state)
+{
+    const Roster& r = roster(state.range(0), state.range(1));
+    std::vector<Employee> employees = r.employees;
+    std::vector<Target> targets = r.targets;
+    AssignmentResult result;
+    for (auto _ : state) {
+        QuietSolvers quiet;
+        result = operations_research::assignEmployeesEnemiesAndFriendsCpSat(r.distances, employees, targets, r.relations);
+    }
+    reportResult(state, result);
+}
+BENCHMARK(BM_AssignEmployeesEnemiesAndFriendsCpSat)->Args({100, 10})->Args({400, 30})->Unit(benchmark::kMillisecond);
+
+// km minus the friend rewards of a solution, relations only counted when asked for
+static double objective(const Roster& r, const AssignmentResult& result, bool use_relations)
+{
+    std::vector<int> target_of(r.employees.size(), -1);
+    for (const auto& pair : result.pairs) {
+        target_of[pair.employee] = pair.target;
+    }
+    LocalSearch search(r.distances, r.targets, r.relations, use_relations);
+    search.load(target_of);
+    return search.objective();
+}
+
+// how far the heuristic plan is from the exact solution, in percent of its objective
+static void reportGap(benchmark::State& state, const Roster& r, const AssignmentResult& result, const AssignmentResult& exact, bool use_relations)
+{
+    reportResult(state, result);
+    if (!exact.solved()) return;
+    double best = objective(r, exact, use_relations);
+    state.counters["gap_pct"] = 100.0 * (objective(r, result, use_relations) - best) / std::max(std::abs(best), 1e-9);
+}
+
+// against the min cost flow optimum
+static void BM_HeuristicShortest(benchmark::State& state)
+{
+    const Roster& r = roster(state.range(0), state.range(1));
+    std::vector<Employee> employees = r.employees;
+    std::vector<Target> targets = r.targets;
+    QuietSolvers quiet;
+    AssignmentResult exact = operations_research::assignEmployeesMinCostFlow(r.distances, employees, targets);
+    AssignmentResult result;
+    for (auto _ : state) {
+        result = operations_research::assignEmployeesHeuristic(r.distances, employees, targets, RelationGraph());
+    }
+    reportGap(state, r, result, exact, false);
+}
+BENCHMARK(BM_HeuristicShortest)->Args({100, 10})->Args({400, 30})->Args({2000, 100})->Unit(benchmark::kMillisecond);
+
+// against the scip enemies and friends model, friend rewards included
+static void BM_HeuristicFriends(benchmark::State& state)
+{
+    const Roster& r = roster(state.range(0), state.range(1));
+    std::vector<Employee> employees = r.employees;
+    std::vector<Target> targets = r.targets;
+    QuietSolvers quiet;
+    AssignmentResult exact = operations_research::assignEmployeesEnemiesAndFriends(r.distances, employees, targets, r.relations);
+    AssignmentResult result;
+    for (auto _ : state) {
+        result = operations_research::assignEmployeesHeuristic(r.distances, employees, targets, r.relations);
+    }
+    reportGap(state, r, result, exact, true);
+}
+BENCHMARK(BM_HeuristicFriends)->Args({100, 10})->Args({400, 30})->Unit(benchmark::kMillisecond);
+
+// the enemies and friends model started from the heuristic plan, compare with BM_AssignEmployeesEnemiesAndFriends
+static void BM_WarmStartFriends(benchmark::State& state)
+{
+    const Roster& r = roster(state.range(0), state.range(1));
+    std::vector<Employee> employees = r.employees;
+    std::vector<Target> targets = r.targets;
+    vrp::Options options;
+    options.mode = vrp::Mode::Friends;
+    options.warm_start = true;
+    AssignmentResult result;
+    for (auto _ : state) {
+        QuietSolvers quiet;
+        result = vrp::solve(r.distances, employees, targets, r.relations, options);
+    }
+    reportResult(state, result);
+}
+BENCHMARK(BM_WarmStartFriends)->Args({100, 10})->Args({400, 30})->Unit(benchmark::kMillisecond);
+
+// the library api: the same problem solved over and over on one context, which keeps its buffers
+static void BM_ContextSolve(benchmark::State& state)
+{
+    const Roster& r = roster(state.range(0), state.range(1));
+    std::vector<vrp::Location> employees, targets;
+    std::vector<int> required;
+    for (const auto& emp : r.employees) employees.push_back({emp.lat, emp.lon});
+    for (const auto& tar : r.targets) {
+        targets.push_back({tar.lat, tar.lon});
+        required.push_back(tar.req_employees);
+    }
+    vrp::Problem problem;
+    problem.employees = employees;
+    problem.targets = targets;
+    problem.required = required;
+
+    vrp::Options options;
+    options.mode = vrp::Mode::Shortest;
+    vrp::Context context;
+    QuietSolvers quiet;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(context.solve(problem, options).total_km);
+    }
+    reportResult(state, context.solve(problem, options));
+}
+BENCHMARK(BM_ContextSolve)->Args({400, 30})->Args({2000, 100})->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
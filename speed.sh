@@ -15,6 +15,11 @@ run() {
     ./main
 }
 
+bench() {
+    cd build || exit 1
+    ./vrp_bench --benchmark_out=bench.json --benchmark_out_format=json
+}
+
 clean() {
     # make sure you're already in the vrp dir
     rm -rf build/*
@@ -33,6 +38,10 @@ case "$1" in
     run
     exit 0
     ;;
+  bench)
+    bench
+    exit 0
+    ;;
   clean)
     clean
     exit 0
@@ -0,0 +1,392 @@
+#include "addressindex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "trace.h"
+
+// lowercase, dots/commas/quotes dropped, dashes and runs of whitespace become one space.
+// "'s-Gravenhage" -> "s gravenhage", "Burg. de Withstraat" -> "burg de withstraat"
+static std::string normalizeName(const std::string& s)
+{
+    std::string out;
+    out.reserve(s.size());
+    bool pending_space = false;
+    for (unsigned char c : s) {
+        if (c == '.' || c == ',' || c == '\'' || c == '"') continue;
+        if (std::isspace(c) || c == '-' || c == '/') {
+            pending_space = !out.empty();
+            continue;
+        }
+        if (pending_space) {
+            out += ' ';
+            pending_space = false;
+        }
+        out += static_cast<char>(std::tolower(c));
+    }
+    return out;
+}
+
+// "12a" -> 12 + "a", "12-2" -> 12 + "2", false without leading digits
+static bool parseHouseNumber(const std::string& token, uint32_t& number, std::string& addition)
+{
+    size_t digits = 0;
+    while (digits < token.size() && std::isdigit(static_cast<unsigned char>(token[digits]))) ++digits;
+    if (digits == 0 || digits > 9) return false;
+
+    number = std::strtoul(token.substr(0, digits).c_str(), nullptr, 10);
+    addition.clear();
+    for (size_t i = digits; i < token.size() && addition.size() < 4; ++i) {
+        unsigned char c = token[i];
+        if (std::isalnum(c)) addition += static_cast<char>(std::tolower(c));
+    }
+    return true;
+}
+
+// 1234 AB -> a number below 10000 * 676, 0 if it isn't a dutch postcode
+static uint64_t postcodeCode(const std::string& digits, const std::string& letters)
+{
+    if (digits.size() != 4 || letters.size() != 2) return 0;
+    uint64_t code = std::strtoul(digits.c_str(), nullptr, 10);
+    for (char c : letters) {
+        if (!std::isalpha(static_cast<unsigned char>(c))) return 0;
+        code = code * 26 + (std::tolower(c) - 'a');
+    }
+    return code + 1;
+}
+
+static uint64_t postcodeKey(uint64_t code, uint32_t number)
+{
+    return code << 32 | number;
+}
+
+// finds "1234 AB" / "1234AB" in text, cuts it out and returns its code (0 when there's none)
+static uint64_t extractPostcode(std::string& text)
+{
+    for (size_t i = 0; i + 6 <= text.size(); ++i) {
+        if (i > 0 && std::isalnum(static_cast<unsigned char>(text[i - 1]))) continue;
+        size_t j = i;
+        while (j < text.size() && j - i < 4 && std::isdigit(static_cast<unsigned char>(text[j]))) ++j;
+        if (j - i != 4) continue;
+        size_t letters = j < text.size() && text[j] == ' ' ? j + 1 : j;
+        if (letters + 2 > text.size()) continue;
+        bool ends = letters + 2 == text.size() || !std::isalnum(static_cast<unsigned char>(text[letters + 2]));
+        uint64_t code = postcodeCode(text.substr(i, 4), text.substr(letters, 2));
+        if (code && ends) {
+            text.erase(i, letters + 2 - i);
+            return code;
+        }
+    }
+    return 0;
+}
+
+static void copyAddition(const std::string& addition, char out[4])
+{
+    std::memset(out, 0, 4);
+    std::memcpy(out, addition.data(), std::min<size_t>(addition.size(), 4));
+}
+
+// one line of csv, quoted fields may contain the separator and "" for a quote
+static void splitCsv(const char* begin, const char* end, char separator, std::vector<std::string>& fields)
+{
+    fields.clear();
+    std::string field;
+    bool quoted = false;
+    for (const char* p = begin; p < end; ++p) {
+        if (quoted) {
+            if (*p == '"' && p + 1 < end && p[1] == '"') {
+                field += '"';
+                ++p;
+            } else if (*p == '"') {
+                quoted = false;
+            } else {
+                field += *p;
+            }
+        } else if (*p == '"') {
+            quoted = true;
+        } else if (*p == separator) {
+            fields.push_back(std::move(field));
+            field.clear();
+        } else if (*p != '\r') {
+            field += *p;
+        }
+    }
+    fields.push_back(std::move(field));
+}
+
+// index of the first header that is one of names, -1 if none
+static int findColumn(const std::vector<std::string>& header, std::initializer_list<const char*> names)
+{
+    for (size_t i = 0; i < header.size(); ++i) {
+        for (const char* name : names) {
+            if (header[i] == name) return i;
+        }
+    }
+    return -1;
+}
+
+bool AddressIndex::load(const std::string& path)
+{
+    ScopedTimer timer("address index load");
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "can't open address index " << path << std::endl;
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string data = buffer.str();
+
+    const char* p = data.data();
+    const char* end = p + data.size();
+    const char* line_end = std::find(p, end, '\n');
+
+    std::string header_line(p, line_end);
+    char separator = std::count(header_line.begin(), header_line.end(), ';') > std::count(header_line.begin(), header_line.end(), ',') ? ';' : ',';
+    std::vector<std::string> header;
+    splitCsv(p, line_end, separator, header);
+    for (auto& name : header) name = normalizeName(name);
+
+    int street_col = findColumn(header, {"street", "straat", "openbareruimte", "openbare_ruimte", "addr:street"});
+    int number_col = findColumn(header, {"housenumber", "huisnummer", "number", "addr:housenumber"});
+    int letter_col = findColumn(header, {"huisletter", "addition", "letter"});
+    int addition_col = findColumn(header, {"toevoeging", "huisnummertoevoeging"});
+    int postcode_col = findColumn(header, {"postcode", "postal_code", "zip", "addr:postcode"});
+    int city_col = findColumn(header, {"city", "woonplaats", "plaats", "addr:city"});
+    int lat_col = findColumn(header, {"lat", "latitude"});
+    int lon_col = findColumn(header, {"lon", "lng", "longitude"});
+    if (street_col < 0 || number_col < 0 || city_col < 0 || lat_col < 0 || lon_col < 0) {
+        std::cerr << "address index " << path << " needs street, housenumber, city, lat and lon columns" << std::endl;
+        return false;
+    }
+    int needed = std::max({street_col, number_col, letter_col, addition_col, postcode_col, city_col, lat_col, lon_col}) + 1;
+
+    // streets get an id in order of appearance first, they're sorted once everything is read
+    std::unordered_map<std::string, uint32_t> street_ids;
+    std::vector<std::string> keys;
+    struct Row {
+        uint32_t street;
+        uint64_t postcode;
+        Address address;
+    };
+    std::vector<Row> rows;
+
+    std::vector<std::string> fields;
+    std::string addition;
+    size_t skipped = 0;
+    for (p = line_end < end ? line_end + 1 : end; p < end; p = line_end < end ? line_end + 1 : end) {
+        line_end = std::find(p, end, '\n');
+        if (line_end == p) continue;
+        splitCsv(p, line_end, separator, fields);
+
+        Row row;
+        if ((int)fields.size() < needed || !parseHouseNumber(fields[number_col], row.address.number, addition)) {
+            ++skipped;
+            continue;
+        }
+        if (letter_col >= 0) addition += normalizeName(fields[letter_col]);
+        if (addition_col >= 0) addition += normalizeName(fields[addition_col]);
+        copyAddition(addition, row.address.addition);
+        char* lat_end;
+        char* lon_end;
+        row.address.lat = std::strtof(fields[lat_col].c_str(), &lat_end);
+        row.address.lon = std::strtof(fields[lon_col].c_str(), &lon_end);
+        // without coordinates it would be found at 0,0
+        if (lat_end == fields[lat_col].c_str() || lon_end == fields[lon_col].c_str()) {
+            ++skipped;
+            continue;
+        }
+
+        row.postcode = 0;
+        if (postcode_col >= 0) {
+            std::string postcode = fields[postcode_col];
+            row.postcode = extractPostcode(postcode);
+        }
+
+        std::string key = normalizeName(fields[city_col]) + "|" + normalizeName(fields[street_col]);
+        auto [it, inserted] = street_ids.try_emplace(std::move(key), keys.size());
+        if (inserted) keys.push_back(it->first);
+        row.street = it->second;
+        rows.push_back(row);
+    }
+
+    std::vector<uint32_t> order(keys.size());
+    for (size_t s = 0; s < keys.size(); ++s) order[s] = s;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+    std::vector<uint32_t> rank(keys.size());
+    for (size_t r = 0; r < order.size(); ++r) rank[order[r]] = r;
+
+    // by street, then number, an address without addition before the ones with
+    std::sort(rows.begin(), rows.end(), [&](const Row& a, const Row& b) {
+        if (a.street != b.street) return rank[a.street] < rank[b.street];
+        if (a.address.number != b.address.number) return a.address.number < b.address.number;
+        return std::memcmp(a.address.addition, b.address.addition, 4) < 0;
+    });
+
+    addresses.clear();
+    streets.clear();
+    street_by_key.clear();
+    by_postcode.clear();
+    addresses.reserve(rows.size());
+    streets.reserve(keys.size());
+    for (uint32_t s : order) {
+        streets.push_back({std::move(keys[s]), 0, 0});
+    }
+    for (const Row& row : rows) {
+        Street& street = streets[rank[row.street]];
+        if (street.last == 0) street.first = addresses.size();
+        street.last = addresses.size() + 1;
+        if (row.postcode) {
+            by_postcode.try_emplace(postcodeKey(row.postcode, row.address.number), addresses.size());
+        }
+        addresses.push_back(row.address);
+    }
+    for (size_t s = 0; s < streets.size(); ++s) {
+        street_by_key.emplace(streets[s].key, s);
+    }
+
+    std::cout << "address index: " << addresses.size() << " addresses on " << streets.size() << " streets";
+    if (skipped) std::cout << " (" << skipped << " lines skipped)";
+    std::cout << std::endl;
+    return true;
+}
+
+AddressMatch AddressIndex::findOnStreet(uint32_t street, uint32_t number, const std::string& addition, float& lat, float& lon) const
+{
+    const Address* first = addresses.data() + streets[street].first;
+    const Address* last = addresses.data() + streets[street].last;
+    const Address* it = std::lower_bound(first, last, number, [](const Address& a, uint32_t n) { return a.number < n; });
+
+    if (it != last && it->number == number) {
+        // the right letter/addition if it's there, the building itself otherwise
+        const Address* match = it;
+        char wanted[4];
+        copyAddition(addition, wanted);
+        for (const Address* a = it; a != last && a->number == number; ++a) {
+            if (std::memcmp(a->addition, wanted, 4) == 0) {
+                match = a;
+                break;
+            }
+        }
+        lat = match->lat;
+        lon = match->lon;
+        return AddressMatch::Exact;
+    }
+
+    // closest number that is in the extract
+    const Address* nearest = it == last ? it - 1 : it;
+    if (it != first && it != last && number - (it - 1)->number < it->number - number) {
+        nearest = it - 1;
+    }
+    lat = nearest->lat;
+    lon = nearest->lon;
+    return AddressMatch::NearestNumber;
+}
+
+// levenshtein distance, anything above limit is reported as limit + 1
+static size_t editDistance(std::string_view a, std::string_view b, size_t limit)
+{
+    if (a.size() > b.size() + limit || b.size() > a.size() + limit) return limit + 1;
+    std::vector<size_t> row(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) row[j] = j;
+    for (size_t i = 1; i <= a.size(); ++i) {
+        size_t diagonal = row[0];
+        row[0] = i;
+        size_t row_min = row[0];
+        for (size_t j = 1; j <= b.size(); ++j) {
+            size_t above = row[j];
+            row[j] = std::min({row[j] + 1, row[j - 1] + 1, diagonal + (a[i - 1] != b[j - 1])});
+            diagonal = above;
+            row_min = std::min(row_min, row[j]);
+        }
+        if (row_min > limit) return limit + 1;
+    }
+    return row[b.size()];
+}
+
+int64_t AddressIndex::matchStreet(const std::string& key, size_t city_length, bool& fuzzy) const
+{
+    fuzzy = false;
+    auto exact = street_by_key.find(key);
+    if (exact != street_by_key.end()) return exact->second;
+
+    auto byKey = [](const Street& street, const std::string& k) { return street.key < k; };
+    fuzzy = true;
+
+    // an abbreviated street ("kerkstr"), the first street that starts with it
+    auto prefix = std::lower_bound(streets.begin(), streets.end(), key, byKey);
+    if (prefix != streets.end() && prefix->key.compare(0, key.size(), key) == 0) {
+        return prefix - streets.begin();
+    }
+
+    // a typo: the closest street name of the same city, one edit per 5 characters and at most 2
+    std::string city_prefix = key.substr(0, city_length + 1);
+    std::string_view name = std::string_view(key).substr(city_length + 1);
+    size_t limit = std::min<size_t>(2, std::max<size_t>(1, name.size() / 5));
+    int64_t best = -1;
+    size_t best_distance = limit + 1;
+    for (auto it = std::lower_bound(streets.begin(), streets.end(), city_prefix, byKey);
+         it != streets.end() && it->key.compare(0, city_prefix.size(), city_prefix) == 0; ++it) {
+        size_t distance = editDistance(name, std::string_view(it->key).substr(city_prefix.size()), best_distance - 1);
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = it - streets.begin();
+            if (distance == 0) break;
+        }
+    }
+    return best;
+}
+
+AddressMatch AddressIndex::lookup(const std::string& city, const std::string& address, float& lat, float& lon) const
+{
+    if (addresses.empty()) return AddressMatch::None;
+
+    std::string city_text = city;
+    std::string street_text = address;
+    uint64_t postcode = extractPostcode(street_text);
+    if (!postcode) postcode = extractPostcode(city_text);
+
+    // the house number is the last token that starts with a digit ("2e Helmersstraat 5"), a short token after it
+    // is the addition ("12 A"). with a postcode the number alone is enough
+    std::istringstream words(street_text);
+    std::vector<std::string> tokens;
+    for (std::string word; words >> word;) tokens.push_back(word);
+    int number_token = -1;
+    for (int i = tokens.size() - 1; i >= (postcode ? 0 : 1) && number_token < 0; --i) {
+        if (std::isdigit(static_cast<unsigned char>(tokens[i][0]))) number_token = i;
+    }
+    uint32_t number = 0;
+    std::string addition;
+    if (number_token < 0 || !parseHouseNumber(tokens[number_token], number, addition)) {
+        return AddressMatch::None;
+    }
+    for (size_t i = number_token + 1; i < tokens.size() && addition.size() < 4; ++i) {
+        if (tokens[i].size() <= 4) addition += normalizeName(tokens[i]);
+    }
+    addition = addition.substr(0, 4);
+
+    if (postcode) {
+        auto it = by_postcode.find(postcodeKey(postcode, number));
+        if (it != by_postcode.end()) {
+            lat = addresses[it->second].lat;
+            lon = addresses[it->second].lon;
+            return AddressMatch::Postcode;
+        }
+    }
+
+    if (number_token == 0) return AddressMatch::None;
+    std::string street;
+    for (int i = 0; i < number_token; ++i) street += (i ? " " : "") + tokens[i];
+    std::string city_key = normalizeName(city_text);
+    bool fuzzy;
+    int64_t match = matchStreet(city_key + "|" + normalizeName(street), city_key.size(), fuzzy);
+    if (match < 0) return AddressMatch::None;
+
+    AddressMatch found = findOnStreet(match, number, addition, lat, lon);
+    return fuzzy ? AddressMatch::Fuzzy : found;
+}
@@ -0,0 +1,76 @@
+#ifndef ADDRESSINDEX_H
+#define ADDRESSINDEX_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// how an address was found in the index
+enum class AddressMatch {
+    None,
+    // street + house number (+ letter/addition) in the city
+    Exact,
+    // postcode + house number
+    Postcode,
+    // the street is right but the number isn't in the extract, the closest number on that street
+    NearestNumber,
+    // the street name only matched by prefix or with a typo or two
+    Fuzzy,
+};
+
+/* Offline geocoding from a local address extract (e.g. the BAG or an OSM export) as csv with a header line.
+The columns are found by name: street (or straat/openbareruimte), housenumber (huisnummer/number), optional
+addition (huisletter/toevoeging), optional postcode, city (woonplaats), lat and lon.
+Streets and cities are interned, the addresses are sorted per street by house number, so one address is a
+few bytes plus its coordinates. An exact lookup is two hash lookups and a binary search; a street that isn't
+known is matched by prefix, and then by edit distance against the other streets of the same city.
+Lookups don't change anything, so the index can be shared between threads. */
+class AddressIndex {
+public:
+    AddressIndex() = default;
+    // street_by_key points into the street keys, a copy (or move) would point into the other index
+    AddressIndex(const AddressIndex&) = delete;
+    AddressIndex& operator=(const AddressIndex&) = delete;
+
+    // false (and a message on stderr) if the file can't be read or misses a required column
+    bool load(const std::string& path);
+
+    // address like "Kerkstraat 12a" or "Kerkstraat 12-2", optionally with a postcode ("1234 AB") in the address
+    // or the city field. lat/lon are only written when the result isn't AddressMatch::None
+    AddressMatch lookup(const std::string& city, const std::string& address, float& lat, float& lon) const;
+
+    size_t size() const { return addresses.size(); }
+    bool empty() const { return addresses.empty(); }
+
+private:
+    struct Address {
+        uint32_t number;
+        // huisletter/toevoeging, lowercase, zero padded
+        char addition[4];
+        float lat;
+        float lon;
+    };
+    struct Street {
+        // "city|street", normalized
+        std::string key;
+        // its addresses, sorted by number: addresses[first .. last)
+        uint32_t first;
+        uint32_t last;
+    };
+
+    AddressMatch findOnStreet(uint32_t street, uint32_t number, const std::string& addition, float& lat, float& lon) const;
+    // the street of "city|street" that best matches, or -1
+    int64_t matchStreet(const std::string& key, size_t city_length, bool& fuzzy) const;
+
+    std::vector<Address> addresses;
+    // sorted by key, so the streets of one city are next to each other and prefixes are found by binary search
+    std::vector<Street> streets;
+    // views into the keys above
+    std::unordered_map<std::string_view, uint32_t> street_by_key;
+    // dutch postcode (1234 AB) packed together with the house number -> index into addresses
+    std::unordered_map<uint64_t, uint32_t> by_postcode;
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include "aggregate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+EmployeeClasses singletonClasses(int num_employees)
+{
+    EmployeeClasses classes;
+    classes.members.resize(num_employees);
+    classes.class_of.resize(num_employees);
+    for (int e = 0; e < num_employees; ++e) {
+        classes.members[e] = {e};
+        classes.class_of[e] = e;
+    }
+    return classes;
+}
+
+// what has to match between two members: the exact float, or the distance rounded to the tolerance
+static uint64_t distanceKey(float km, float tolerance_km)
+{
+    if (tolerance_km > 0) {
+        return static_cast<uint64_t>(std::llround(km / tolerance_km));
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &km, sizeof(bits));
+    return bits;
+}
+
+static bool sameRow(const DistanceMatrix& distances, int a, int b, float tolerance_km)
+{
+    for (int t = 0; t < distances.num_targets; ++t) {
+        if (distanceKey(distances.at(a, t), tolerance_km) != distanceKey(distances.at(b, t), tolerance_km)) return false;
+    }
+    return true;
+}
+
+EmployeeClasses groupEmployees(const DistanceMatrix& distances, const RelationGraph& relations, float tolerance_km)
+{
+    int num_employees = distances.num_employees;
+
+    // one hash per distance row, walked target by target since that's how the matrix is laid out
+    std::vector<uint64_t> hashes(num_employees, 1469598103934665603ull);
+    for (int t = 0; t < distances.num_targets; ++t) {
+        for (int e = 0; e < num_employees; ++e) {
+            hashes[e] = (hashes[e] ^ distanceKey(distances.at(e, t), tolerance_km)) * 1099511628211ull;
+        }
+    }
+
+    auto related = [&](int e) {
+        const auto& conflicts = relations.conflict_graph.start;
+        const auto& friends = relations.friend_graph.start;
+        bool has_conflict = !conflicts.empty() && conflicts[e + 1] > conflicts[e];
+        bool has_friend = !friends.empty() && friends[e + 1] > friends[e];
+        return has_conflict || has_friend;
+    };
+
+    EmployeeClasses classes;
+    classes.class_of.assign(num_employees, -1);
+    // row hash -> classes with that hash (more than one only on a collision)
+    std::unordered_map<uint64_t, std::vector<int>> by_hash;
+
+    for (int e = 0; e < num_employees; ++e) {
+        if (!related(e)) {
+            std::vector<int>& candidates = by_hash[hashes[e]];
+            auto match = std::find_if(candidates.begin(), candidates.end(),
+                [&](int c) { return sameRow(distances, classes.members[c].front(), e, tolerance_km); });
+            if (match != candidates.end()) {
+                classes.class_of[e] = *match;
+                classes.members[*match].push_back(e);
+                continue;
+            }
+            candidates.push_back(classes.members.size());
+        }
+        classes.class_of[e] = classes.members.size();
+        classes.members.push_back({e});
+    }
+    return classes;
+}
+
+double classDistance(const EmployeeClasses& classes, const DistanceMatrix& distances, int c, int t)
+{
+    const std::vector<int>& members = classes.members[c];
+    if (members.size() == 1) return distances.at(members[0], t);
+
+    double sum = 0;
+    for (int e : members) sum += distances.at(e, t);
+    return sum / members.size();
+}
+
+std::vector<std::pair<int, int>> expandCounts(const EmployeeClasses& classes, const std::vector<std::vector<std::pair<int, int>>>& counts,
+    const DistanceMatrix& distances)
+{
+    std::vector<std::pair<int, int>> pairs;
+    for (int c = 0; c < classes.size(); ++c) {
+        const std::vector<int>& members = classes.members[c];
+        if (counts[c].empty()) continue;
+
+        if (counts[c].size() == 1) {
+            // one target: which members go doesn't matter without a tolerance, otherwise the closest ones
+            auto [target, count] = counts[c][0];
+            std::vector<int> order = members;
+            std::sort(order.begin(), order.end(), [&](int a, int b) { return distances.at(a, target) < distances.at(b, target); });
+            for (int k = 0; k < count && k < (int)order.size(); ++k) pairs.emplace_back(order[k], target);
+            continue;
+        }
+
+        // several targets: cheapest member/target combinations first
+        std::vector<std::pair<float, std::pair<int, int>>> options;
+        for (int e : members) {
+            for (const auto& [target, count] : counts[c]) options.push_back({distances.at(e, target), {e, target}});
+        }
+        std::sort(options.begin(), options.end());
+
+        std::unordered_map<int, int> remaining(counts[c].begin(), counts[c].end());
+        std::unordered_map<int, bool> used;
+        for (const auto& [km, option] : options) {
+            auto [e, target] = option;
+            if (used[e] || remaining[target] == 0) continue;
+            used[e] = true;
+            --remaining[target];
+            pairs.emplace_back(e, target);
+        }
+    }
+    return pairs;
+}
@@ -0,0 +1,38 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <utility>
+#include <vector>
+
+#include "assignment.h"
+
+// employees the models can't tell apart: the same distance to every target (same address, same student house)
+// and no enemies or friends of their own. one class gets one integer variable per target (how many of them go
+// there) instead of a binary per employee, which takes away the symmetry scip would otherwise branch through
+struct EmployeeClasses {
+    // members[c] = employee indices in class c, class_of[e] = the class of employee e
+    std::vector<std::vector<int>> members;
+    std::vector<int> class_of;
+
+    int size() const { return members.size(); }
+    int classSize(int c) const { return members[c].size(); }
+    // nothing was merged
+    bool trivial() const { return members.size() == class_of.size(); }
+};
+
+// every employee in a class of their own
+EmployeeClasses singletonClasses(int num_employees);
+
+// groups employees whose distance rows are equal, or within tolerance_km per target when that's > 0.
+// employees with a conflict or friend always stay on their own, their constraints are per person
+EmployeeClasses groupEmployees(const DistanceMatrix& distances, const RelationGraph& relations, float tolerance_km = 0);
+
+// the model cost of sending one member of class c to target t: their mean distance (all equal without a tolerance)
+double classDistance(const EmployeeClasses& classes, const DistanceMatrix& distances, int c, int t);
+
+// turns counts[c] = (target, how many) of a solved aggregated model back into (employee, target) pairs.
+// with a tolerance the members aren't quite equal, so the closest member/target combinations go first
+std::vector<std::pair<int, int>> expandCounts(const EmployeeClasses& classes, const std::vector<std::vector<std::pair<int, int>>>& counts,
+    const DistanceMatrix& distances);
+
+#endif
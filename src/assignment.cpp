@@ -1,333 +1,354 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+
 #include "assignment.h"
+#include "aggregate.h"
+#include "candidates.h"
+#include "solverlog.h"
+#include "trace.h"
 #include "ortools/linear_solver/linear_solver.h"
-
-#define FAVOR_COEFFICIENT 100.0
+#include "ortools/linear_solver/linear_solver_callback.h"
 
 namespace operations_research {
-/* This version of the assignment function tries to compute the combination of assignments that would
-lead to the least amount of kilometers travelled. This will have some outliers. People with very short 
-and very long distances */
-void assignEmployees(std::vector<Distance>& distances, std::vector<Employee>& employees, std::vector<Target>& targets)
-{
-    int num_employees = employees.size();
-    int num_targets = targets.size();
-
-    MPSolver solver("EmployeeAssignment", MPSolver::SCIP_MIXED_INTEGER_PROGRAMMING);
-
-    // x[i][j] = 1 if employee i is assigned to target j
-    std::vector<std::vector<const MPVariable*>> x(num_employees, std::vector<const MPVariable*>(num_targets, nullptr));
+// x[c][j] = how many employees of class c are assigned to target j, nullptr if the pair was pruned.
+// most classes are a single employee, then it's the usual 0/1 variable (see aggregate.h)
+using AssignmentVars = std::vector<std::vector<const MPVariable*>>;
 
-    // map employee ID to its index
-    std::unordered_map<int, int> id_to_index;
-    for (int i = 0; i < num_employees; ++i) {
-        id_to_index[employees[i].id] = i; 
+// interchangeable employees grouped into classes, unless switched off
+static EmployeeClasses makeClasses(const DistanceMatrix& distances, const RelationGraph& relations, const SolverOptions& options)
+{
+    if (!options.aggregate) {
+        return singletonClasses(distances.num_employees);
     }
-
-    // same for target (using .target_number instead of .id)
-    std::unordered_map<int, int> tar_num_to_index;
-    for (int i = 0; i < num_targets; ++i) {
-        tar_num_to_index[targets[i].target_number] = i; 
+    TRACE_SCOPE("aggregate employees");
+    EmployeeClasses classes = groupEmployees(distances, relations, options.aggregate_km);
+    if (!classes.trivial()) {
+        solverLog() << "aggregated " << distances.num_employees << " employees into " << classes.size() << " classes" << std::endl;
     }
+    return classes;
+}
+
+// decision variables for every candidate pair and the rows all the models share
+static AssignmentVars makeAssignmentModel(MPSolver& solver, const CandidateArcs& arcs, const EmployeeClasses& classes, std::vector<Target>& targets)
+{
+    int num_classes = classes.size();
+    int num_targets = arcs.num_targets;
 
-    // create the decision variables
-    for (const auto& d : distances) {
-        int employee_index = id_to_index[d.employee.id];
-        int target_index = tar_num_to_index[d.target.target_number];
+    AssignmentVars x(num_classes, std::vector<const MPVariable*>(num_targets, nullptr));
 
-        x[employee_index][target_index] = solver.MakeIntVar(0, 1, "x_" + std::to_string(employee_index) + "_" + std::to_string(target_index));
+    // create the decision variables, a class can go to a target if any of its members can
+    for (int c = 0; c < num_classes; ++c) {
+        for (int j = 0; j < num_targets; ++j) {
+            const std::vector<int>& members = classes.members[c];
+            bool allowed = std::any_of(members.begin(), members.end(), [&](int i) { return arcs.isAllowed(i, j); });
+            if (allowed) {
+                int upper = std::min(classes.classSize(c), targets[j].req_employees);
+                x[c][j] = solver.MakeIntVar(0, upper, "x_" + std::to_string(c) + "_" + std::to_string(j));
+            }
+        }
     }
 
-    // constraint: each employee is assigned at most once
-    for (int i = 0; i < num_employees; ++i) {
+    // constraint: each employee is assigned at most once (a class at most as often as it has members)
+    for (int c = 0; c < num_classes; ++c) {
         LinearExpr expr;
         for (int j = 0; j < num_targets; ++j) {
-            expr += x[i][j];
+            if (x[c][j]) expr += x[c][j];
         }
-        solver.MakeRowConstraint(expr <= 1);
+        solver.MakeRowConstraint(expr <= classes.classSize(c));
     }
 
     // constraint: each target has a required number of people that need to be on location
     for (int j = 0; j < num_targets; ++j) {
         LinearExpr expr;
-        for (int i = 0; i < num_employees; ++i) {
-            expr += x[i][j];
+        for (int c = 0; c < num_classes; ++c) {
+            if (x[c][j]) expr += x[c][j];
         }
         solver.MakeRowConstraint(expr == targets[j].req_employees);
     }
 
-    // objective: minimize the total distance
-    MPObjective* objective = solver.MutableObjective();
-    for (const auto& d : distances) {
-        int employee_index = id_to_index[d.employee.id];
-        int target_index = tar_num_to_index[d.target.target_number];
+    return x;
+}
 
-        objective->SetCoefficient(x[employee_index][target_index], d.distance);
+// objective: minimize the total distance
+static void setDistanceObjective(MPObjective* objective, const AssignmentVars& x, const EmployeeClasses& classes, const DistanceMatrix& distances)
+{
+    for (size_t c = 0; c < x.size(); ++c) {
+        for (size_t j = 0; j < x[c].size(); ++j) {
+            if (x[c][j]) objective->SetCoefficient(x[c][j], classDistance(classes, distances, c, j));
+        }
     }
-    
-    objective->SetMinimization();
-
-    // solve
-    MPSolver::ResultStatus result_status = solver.Solve();
+}
 
-    if (result_status == MPSolver::OPTIMAL) {
-        std::cout << "Optimal assignment found!" << std::endl;
-        for (const auto& d : distances) {
-            int employee_index = id_to_index[d.employee.id];
-            int target_index = tar_num_to_index[d.target.target_number];
-
-            if (x[employee_index][target_index]->solution_value() > 0.5) {
-                std::cout << "employee " << employees[employee_index].name << " assigned to Target:" << targets[target_index].target_number << " - "
-                          << targets[target_index].address << " (distance = " << d.distance << " km)" << std::endl;
-            }
+// the (employee, target) pairs of a solution, the class counts handed out to the members
+static std::vector<std::pair<int, int>> assignedPairs(const AssignmentVars& x, const EmployeeClasses& classes, const DistanceMatrix& distances,
+    const std::function<double(const MPVariable*)>& value)
+{
+    std::vector<std::vector<std::pair<int, int>>> counts(x.size());
+    for (size_t c = 0; c < x.size(); ++c) {
+        for (size_t j = 0; j < x[c].size(); ++j) {
+            if (!x[c][j]) continue;
+            int count = std::lround(value(x[c][j]));
+            if (count > 0) counts[c].emplace_back(j, count);
         }
-        std::cout << "total cost: " << objective->Value() << " km" << std::endl;
-    } else {
-        std::cout << "no optimal solution found..." << std::endl;
     }
+    return expandCounts(classes, counts, distances);
 }
 
-/* This version of the assignment function tries to get a more balanced solution.
-More uniform results, less outliers with very high distances, but will result in a higher overall distance travelled*/
-void assignEmployeesBalanced(std::vector<Distance>& distances, std::vector<Employee>& employees, std::vector<Target>& targets)
+// warm start from options.hint: how many of every class's members the plan puts on every target
+static void setHint(MPSolver& solver, const AssignmentVars& x, const EmployeeClasses& classes, const std::vector<std::pair<int, int>>& pairs)
 {
-    int num_employees = employees.size();
-    int num_targets = targets.size();
-
-    MPSolver solver("EmployeeAssignment", MPSolver::SCIP_MIXED_INTEGER_PROGRAMMING);
-
-    // x[i][j] = 1 if employee i is assigned to target j
-    std::vector<std::vector<const MPVariable*>> x(num_employees, std::vector<const MPVariable*>(num_targets, nullptr));
-
-    // map employee ID to its index
-    std::unordered_map<int, int> id_to_index;
-    for (int i = 0; i < num_employees; ++i) {
-        id_to_index[employees[i].id] = i; 
+    if (pairs.empty()) return;
+    std::vector<std::vector<int>> counts(x.size(), std::vector<int>(x.empty() ? 0 : x[0].size(), 0));
+    for (const auto& [i, j] : pairs) {
+        ++counts[classes.class_of[i]][j];
     }
-
-    // same for target (using .target_number instead of .id)
-    std::unordered_map<int, int> tar_num_to_index;
-    for (int i = 0; i < num_targets; ++i) {
-        tar_num_to_index[targets[i].target_number] = i; 
+    std::vector<std::pair<const MPVariable*, double>> hint;
+    for (size_t c = 0; c < x.size(); ++c) {
+        for (size_t j = 0; j < x[c].size(); ++j) {
+            if (x[c][j]) hint.emplace_back(x[c][j], counts[c][j]);
+        }
     }
+    solver.SetHint(hint);
+}
 
-    // create the decision variables
-    for (const auto& d : distances) {
-        int employee_index = id_to_index[d.employee.id];
-        int target_index = tar_num_to_index[d.target.target_number];
+// pruned models can turn out infeasible (conflicts aren't part of the candidate check),
+// in that case the candidates get widened and the model is built again
+static bool retryWithMoreArcs(MPSolver::ResultStatus result_status, CandidateArcs& arcs, const DistanceMatrix& distances)
+{
+    if (result_status != MPSolver::INFEASIBLE || !widenCandidates(arcs, distances)) {
+        return false;
+    }
+    solverLog() << "pruned model is infeasible, retrying with " << arcs.count() << " candidate pairs..." << std::endl;
+    return true;
+}
 
-        x[employee_index][target_index] = solver.MakeIntVar(0, 1, "x_" + std::to_string(employee_index) + "_" + std::to_string(target_index));
+// hands every new mip solution to options.on_incumbent while scip is still searching
+class IncumbentCallback : public MPCallback {
+public:
+    IncumbentCallback(const AssignmentVars& x, const EmployeeClasses& classes, const DistanceMatrix& distances,
+        const std::function<void(const Incumbent&)>& on_incumbent)
+        : MPCallback(false, false), x(x), classes(classes), distances(distances), on_incumbent(on_incumbent), start(std::chrono::steady_clock::now())
+    {
     }
 
-    // constraint: each employee is assigned at most once
-    for (int i = 0; i < num_employees; ++i) {
-        LinearExpr expr;
-        for (int j = 0; j < num_targets; ++j) {
-            expr += x[i][j];
+    void RunCallback(MPCallbackContext* context) override
+    {
+        if (context->Event() != MPCallbackEvent::kMipSolution || !context->CanQueryVariableValues()) {
+            return;
         }
-        solver.MakeRowConstraint(expr <= 1);
-    }
 
-    // constraint: each target has a required number of people that need to be on location
-    for (int j = 0; j < num_targets; ++j) {
-        LinearExpr expr;
-        for (int i = 0; i < num_employees; ++i) {
-            expr += x[i][j];
+        Incumbent incumbent;
+        incumbent.km = 0;
+        incumbent.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        incumbent.pairs = assignedPairs(x, classes, distances, [&](const MPVariable* var) { return context->VariableValue(var); });
+        for (const auto& [i, j] : incumbent.pairs) {
+            incumbent.km += distances.at(i, j);
         }
-        solver.MakeRowConstraint(expr == targets[j].req_employees);
+        on_incumbent(incumbent);
     }
 
-    // calculate the average distance
-    float total_distance = 0.0;
-    for (const auto& d : distances) {
-        total_distance += d.distance;
+private:
+    const AssignmentVars& x;
+    const EmployeeClasses& classes;
+    const DistanceMatrix& distances;
+    const std::function<void(const Incumbent&)>& on_incumbent;
+    std::chrono::steady_clock::time_point start;
+};
+
+// solve with the time limit / gap from the options, streaming incumbents if asked to.
+// after a time limit the best solution so far comes back as FEASIBLE
+static MPSolver::ResultStatus solveAnytime(MPSolver& solver, const AssignmentVars& x, const EmployeeClasses& classes, const DistanceMatrix& distances,
+    const SolverOptions& options)
+{
+    if (options.time_limit_seconds > 0) {
+        solver.SetTimeLimit(absl::Milliseconds(static_cast<int64_t>(options.time_limit_seconds * 1000)));
     }
-    float average_distance = total_distance / distances.size();
 
-    // objective: minimize the sum of squared differences from the average distance
-    MPObjective* objective = solver.MutableObjective();
-    for (const auto& d : distances) {
-        int employee_index = id_to_index[d.employee.id];
-        int target_index = tar_num_to_index[d.target.target_number];
+    MPSolverParameters parameters;
+    if (options.relative_gap > 0) {
+        parameters.SetDoubleParam(MPSolverParameters::RELATIVE_MIP_GAP, options.relative_gap);
+    }
 
-        // calculate the squared difference from the average distance
-        float squared_difference = (d.distance - average_distance) * (d.distance - average_distance);
-        objective->SetCoefficient(x[employee_index][target_index], squared_difference);
+    std::unique_ptr<IncumbentCallback> callback;
+    if (options.on_incumbent && solver.SupportsCallbacks()) {
+        callback.reset(new IncumbentCallback(x, classes, distances, options.on_incumbent));
+        solver.SetCallback(callback.get());
     }
-    
-    objective->SetMinimization();
 
-    // solve
-    MPSolver::ResultStatus result_status = solver.Solve();
+    ScopedTimer timer("scip solve");
+    timer.arg("variables", solver.NumVariables());
+    timer.arg("constraints", solver.NumConstraints());
+    MPSolver::ResultStatus result_status = solver.Solve(parameters);
+    solver.SetCallback(nullptr);
+    return result_status;
+}
+
+// "Optimal assignment found!" or, when the search was cut short, the proven gap of what we have
+static void setSolveStatus(AssignmentResult& result, MPSolver::ResultStatus result_status, const MPSolver& solver)
+{
+    result.stats.num_variables = solver.NumVariables();
+    result.stats.num_constraints = solver.NumConstraints();
+    result.stats.nodes = solver.nodes();
+    result.stats.wall_seconds = solver.wall_time() / 1000.0;
 
     if (result_status == MPSolver::OPTIMAL) {
-        std::cout << "Balanced assignment found!" << std::endl;
-        for (const auto& d : distances) {
-            int employee_index = id_to_index[d.employee.id];
-            int target_index = tar_num_to_index[d.target.target_number];
-
-            if (x[employee_index][target_index]->solution_value() > 0.5) {
-                std::cout << "employee " << employees[employee_index].name << " assigned to Target:" << targets[target_index].target_number << " - "
-                          << targets[target_index].address << " (distance = " << d.distance << " km)" << std::endl;
-            }
-        }
-        std::cout << "total average distance: " << average_distance << " km" << std::endl;
-    } else {
-        std::cout << "no balanced solution found..." << std::endl;
+        result.status = SolveStatus::Optimal;
+        solverLog() << "Optimal assignment found!" << std::endl;
+        return;
     }
+
+    double value = solver.Objective().Value();
+    double bound = solver.Objective().BestBound();
+    result.status = SolveStatus::Feasible;
+    result.gap = std::abs(value - bound) / std::max(std::abs(value), 1e-9);
+    solverLog() << "Feasible assignment found (stopped early, gap: " << result.gap * 100.0 << "%)" << std::endl;
 }
 
-// constraint: some employees are favored to be paired together (based on favor_coefficient)
-// which reduces the total distance assigned (artificially just to favor certain pairings 
-// to be assigned to the same location)
-void addFriendConstraint(MPSolver& solver, MPObjective* objective, std::vector<std::pair<int, std::vector<int>>>& friend_groups,
-    std::unordered_map<int, int>& id_to_index, std::vector<std::vector<const MPVariable*>>& x, int num_targets)
+// the chosen pairs of a solved model
+static void collectAssignment(AssignmentResult& result, const AssignmentVars& x, const EmployeeClasses& classes, const DistanceMatrix& distances)
 {
-    for (const auto& group : friend_groups) {
-        // the person who has the friend group
-        const auto& main_character = group.first;
-        // the people inside that person's friend group
-        const auto& friends = group.second;
-
-        if (!id_to_index.count(group.first)) continue;
-        int main_character_id = id_to_index[main_character];
-    
-        for (const auto& frend : friends) {
-            if (!id_to_index.count(frend)) continue;
-            int friend_id = id_to_index[frend];
-
-            for (int t = 0; t < num_targets; ++t) {
-                const MPVariable* x1 = x[main_character_id][t]; 
-                const MPVariable* x2 = x[friend_id][t];
-                if (!x1 || !x2) continue;
-
-                // y = 1 if both x1 and x2 are assigned to this target
-                MPVariable* y = solver.MakeIntVar(0, 1, "y_" + std::to_string(main_character_id) + "_" + std::to_string(friend_id) + "_" + std::to_string(t));
-
-                // y <= x1
-                MPConstraint* c1 = solver.MakeRowConstraint(-MPSolver::infinity(), 0);
-                c1->SetCoefficient(y, 1);
-                c1->SetCoefficient(x1, -1);
-
-                // y <= x2
-                MPConstraint* c2 = solver.MakeRowConstraint(-MPSolver::infinity(), 0);
-                c2->SetCoefficient(y, 1);
-                c2->SetCoefficient(x2, -1);
-
-                // y >= x1 + x2 - 1  -->  y - x1 - x2 >= -1
-                MPConstraint* c3 = solver.MakeRowConstraint(-1, MPSolver::infinity());
-                c3->SetCoefficient(y, 1);
-                c3->SetCoefficient(x1, -1);
-                c3->SetCoefficient(x2, -1);
-
-                // reward in objective
-                objective->SetCoefficient(y, -FAVOR_COEFFICIENT);                    
-            }
-        }
+    for (const auto& [i, j] : assignedPairs(x, classes, distances, [](const MPVariable* var) { return var->solution_value(); })) {
+        result.add(i, j, distances.at(i, j));
     }
 }
 
-
-void assignEmployeesEnemiesAndFriends(std::vector<Distance>& distances, std::vector<Employee>& employees, 
-    std::vector<Target>& targets, std::vector<No_pair>& conflicts, std::vector<std::pair<int, std::vector<int>>> &friend_groups)
+/* This version of the assignment function tries to compute the combination of assignments that would
+lead to the least amount of kilometers travelled. This will have some outliers. People with very short
+and very long distances */
+AssignmentResult assignEmployees(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets, const SolverOptions& options)
 {
-    int num_employees = employees.size();
-    int num_targets = targets.size();
+    AssignmentResult result;
+    result.solver = "scip";
 
-    MPSolver solver("EmployeeAssignment", MPSolver::SCIP_MIXED_INTEGER_PROGRAMMING);
+    CandidateArcs arcs = buildCandidates(distances, targets, options.pruning);
+    EmployeeClasses classes = makeClasses(distances, RelationGraph(), options);
 
-    // x[i][j] = 1 if employee i is assigned to target j
-    std::vector<std::vector<const MPVariable*>> x(num_employees, std::vector<const MPVariable*>(num_targets, nullptr));
+    while (true) {
+        ScopedTimer build_timer("build model");
+        MPSolver solver("EmployeeAssignment", MPSolver::SCIP_MIXED_INTEGER_PROGRAMMING);
+        AssignmentVars x = makeAssignmentModel(solver, arcs, classes, targets);
 
-    // map employee ID to its index
-    std::unordered_map<int, int> id_to_index;
-    for (int i = 0; i < num_employees; ++i) {
-        id_to_index[employees[i].id] = i; 
-    }
+        // objective: minimize the total distance
+        MPObjective* objective = solver.MutableObjective();
+        setDistanceObjective(objective, x, classes, distances);
 
-    // same for target (using .target_number instead of .id)
-    std::unordered_map<int, int> tar_num_to_index;
-    for (int i = 0; i < num_targets; ++i) {
-        tar_num_to_index[targets[i].target_number] = i; 
-    }
+        objective->SetMinimization();
+        setHint(solver, x, classes, options.hint);
 
-    // create the decision variables
-    for (const auto& d : distances) {
-        int employee_index = id_to_index[d.employee.id];
-        int target_index = tar_num_to_index[d.target.target_number];
+        build_timer.stop();
 
-        x[employee_index][target_index] = solver.MakeIntVar(0, 1, "x_" + std::to_string(employee_index) + "_" + std::to_string(target_index));
-    }
+        // solve
+        MPSolver::ResultStatus result_status = solveAnytime(solver, x, classes, distances, options);
 
-    // constraint: each employee is assigned at most once
-    for (int i = 0; i < num_employees; ++i) {
-        LinearExpr expr;
-        for (int j = 0; j < num_targets; ++j) {
-            expr += x[i][j];
+        if (result_status == MPSolver::OPTIMAL || result_status == MPSolver::FEASIBLE) {
+            setSolveStatus(result, result_status, solver);
+            collectAssignment(result, x, classes, distances);
+        } else if (retryWithMoreArcs(result_status, arcs, distances)) {
+            continue;
+        } else {
+            solverLog() << "no solution found..." << std::endl;
         }
-        solver.MakeRowConstraint(expr <= 1);
+        break;
     }
+    return result;
+}
 
-    // constraint: each target has a required number of people that need to be on location
-    for (int j = 0; j < num_targets; ++j) {
-        LinearExpr expr;
-        for (int i = 0; i < num_employees; ++i) {
-            expr += x[i][j];
+// constraint: some employees are favored to be paired together (based on favor_coefficient)
+// which reduces the total distance assigned (artificially just to favor certain pairings
+// to be assigned to the same location)
+// (friends are never aggregated, so their classes are just them)
+void addFriendConstraint(MPSolver& solver, MPObjective* objective, const RelationGraph& relations,
+    std::vector<std::vector<const MPVariable*>>& x, const EmployeeClasses& classes, int num_targets)
+{
+    for (const auto& [main_character_id, friend_id] : relations.friends) {
+        for (int t = 0; t < num_targets; ++t) {
+            const MPVariable* x1 = x[classes.class_of[main_character_id]][t];
+            const MPVariable* x2 = x[classes.class_of[friend_id]][t];
+            if (!x1 || !x2) continue;
+
+            // y = 1 if both x1 and x2 are assigned to this target
+            MPVariable* y = solver.MakeIntVar(0, 1, "y_" + std::to_string(main_character_id) + "_" + std::to_string(friend_id) + "_" + std::to_string(t));
+
+            // y <= x1
+            MPConstraint* c1 = solver.MakeRowConstraint(-MPSolver::infinity(), 0);
+            c1->SetCoefficient(y, 1);
+            c1->SetCoefficient(x1, -1);
+
+            // y <= x2
+            MPConstraint* c2 = solver.MakeRowConstraint(-MPSolver::infinity(), 0);
+            c2->SetCoefficient(y, 1);
+            c2->SetCoefficient(x2, -1);
+
+            // y >= x1 + x2 - 1  -->  y - x1 - x2 >= -1
+            MPConstraint* c3 = solver.MakeRowConstraint(-1, MPSolver::infinity());
+            c3->SetCoefficient(y, 1);
+            c3->SetCoefficient(x1, -1);
+            c3->SetCoefficient(x2, -1);
+
+            // reward in objective
+            objective->SetCoefficient(y, -FAVOR_COEFFICIENT);
         }
-        solver.MakeRowConstraint(expr == targets[j].req_employees);
     }
+}
+
+
+AssignmentResult assignEmployeesEnemiesAndFriends(const DistanceMatrix& distances, std::vector<Employee>& employees,
+    std::vector<Target>& targets, const RelationGraph& relations, const SolverOptions& options)
+{
+    int num_targets = targets.size();
+    AssignmentResult result;
+    result.solver = "scip";
 
-    // constraint: some employees hate one another, don't pair them
-    for (const auto& conflict : conflicts) {
-        if (id_to_index.count(conflict.first) && id_to_index.count(conflict.second)) {
-            int first_employee = id_to_index[conflict.first];
-            int second_employee = id_to_index[conflict.second];
+    CandidateArcs arcs = buildCandidates(distances, targets, options.pruning);
+    EmployeeClasses classes = makeClasses(distances, relations, options);
 
+    while (true) {
+        ScopedTimer build_timer("build model");
+        MPSolver solver("EmployeeAssignment", MPSolver::SCIP_MIXED_INTEGER_PROGRAMMING);
+        AssignmentVars x = makeAssignmentModel(solver, arcs, classes, targets);
+
+        // constraint: some employees hate one another, don't pair them (they're in classes of their own)
+        for (const auto& [first_employee, second_employee] : relations.conflicts) {
+            const std::vector<const MPVariable*>& first = x[classes.class_of[first_employee]];
+            const std::vector<const MPVariable*>& second = x[classes.class_of[second_employee]];
             for (int k = 0; k < num_targets; ++k) {
-                if (x[first_employee][k] && x[second_employee][k]) {
+                if (first[k] && second[k]) {
                     LinearExpr expr;
-                    expr += x[first_employee][k]; 
-                    expr += x[second_employee][k];
+                    expr += first[k];
+                    expr += second[k];
                     solver.MakeRowConstraint(expr <= 1);
                 }
             }
         }
-    }  
-
-    // objective: minimize the total distance
-    MPObjective* objective = solver.MutableObjective();
-    for (const auto& d : distances) {
-        int employee_index = id_to_index[d.employee.id];
-        int target_index = tar_num_to_index[d.target.target_number];
-        objective->SetCoefficient(x[employee_index][target_index], d.distance);
-    }
 
-    addFriendConstraint(solver, objective, friend_groups, id_to_index, x, num_targets);
-    
-    objective->SetMinimization();
+        // objective: minimize the total distance
+        MPObjective* objective = solver.MutableObjective();
+        setDistanceObjective(objective, x, classes, distances);
 
-    // since we decrease the objective->Value() by the FAVOR_COEFFICIENT every time we pair friends
-    // keep track of the total distance of the assignment by summing up the distance traveled by every employee
-    float km_sum = 0;
+        addFriendConstraint(solver, objective, relations, x, classes, num_targets);
 
-    // solve
-    MPSolver::ResultStatus result_status = solver.Solve();
+        objective->SetMinimization();
+        setHint(solver, x, classes, options.hint);
 
-    if (result_status == MPSolver::OPTIMAL) {
-        std::cout << "Optimal assignment found!" << std::endl;
-        for (const auto& d : distances) {
-            int employee_index = id_to_index[d.employee.id];
-            int target_index = tar_num_to_index[d.target.target_number];
+        build_timer.stop();
 
-            if (x[employee_index][target_index]->solution_value() > 0.5) {
-                std::cout << "employee " << employees[employee_index].name << " assigned to Target:" << targets[target_index].target_number << " - "
-                          << targets[target_index].address << " (distance = " << d.distance << " km)" << std::endl;
+        // solve
+        MPSolver::ResultStatus result_status = solveAnytime(solver, x, classes, distances, options);
 
-                km_sum += d.distance;
-            }
+        // since we decrease the objective->Value() by the FAVOR_COEFFICIENT every time we pair friends
+        // the total distance of the assignment is summed up from the distance traveled by every employee
+        if (result_status == MPSolver::OPTIMAL || result_status == MPSolver::FEASIBLE) {
+            setSolveStatus(result, result_status, solver);
+            collectAssignment(result, x, classes, distances);
+        } else if (retryWithMoreArcs(result_status, arcs, distances)) {
+            continue;
+        } else {
+            solverLog() << "no solution found..." << std::endl;
         }
-        std::cout << "total cost: " << km_sum << " km" << std::endl;
-    } else {
-        std::cout << "no optimal solution found..." << std::endl;
+        break;
     }
+    return result;
 }
 }
@@ -1,8 +1,16 @@
 #ifndef HELPER_H
 #define HELPER_H
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <vector>
 #include <string>
+#include <utility>
+
+// km subtracted from the objective for every pair of friends on the same location
+#define FAVOR_COEFFICIENT 100.0
 
 // add country???
 struct Employee {
@@ -16,12 +24,26 @@ struct Employee {
     float lat;
 };
 
-struct No_pair {
-    int first;
-    int second;
+// neighbours of employee e are adj[start[e] .. start[e + 1])
+struct Adjacency {
+    std::vector<int> start;
+    std::vector<int> adj;
+};
+
+// who hates who and who are friends, by index in the employees vector (see relations.h).
+// symmetric and without duplicates: every pair is listed once with first < second
+struct RelationGraph {
+    std::vector<std::pair<int, int>> conflicts;
+    std::vector<std::pair<int, int>> friends;
+
+    // the same, per employee (both directions)
+    Adjacency conflict_graph;
+    Adjacency friend_graph;
 
-    // constructor to initialize the fields
-    No_pair(int f, int s) : first(f), second(s) {}
+    // no_pair/friends names that don't match any employee
+    std::vector<std::string> unknown_names;
+
+    bool empty() const { return conflicts.empty() && friends.empty(); }
 };
 
 struct Target {
@@ -32,19 +54,149 @@ struct Target {
     int req_employees;
     float lon;
     float lat;
-    // TODO: add a time slot to the struct (evening, night) so employees can be assigned to evening + night in the future
+    // time slot of the visit, e.g. day "mon" and shift "evening"/"night". empty = a single one-off slot.
+    // an employee can work once per slot, so evening + night on the same day is possible
+    std::string day;
+    std::string shift;
+};
+
+// distances between every employee and target, indexed by position in the employees/targets vectors.
+// stored target-major, so the distances from one target to all employees are contiguous
+struct DistanceMatrix {
+    int num_employees = 0;
+    int num_targets = 0;
+
+    // coordinates in the same order as the employees/targets vectors
+    std::vector<float> emp_lat;
+    std::vector<float> emp_lon;
+    std::vector<float> tar_lat;
+    std::vector<float> tar_lon;
+
+    // dist[t * num_employees + e]
+    std::vector<float> dist;
+
+    // a matrix loaded from a MatrixStore (see matrixstore.h) doesn't copy anything into dist, it reads straight
+    // from the mapped file: mapped[tar_slot[t] * mapped_stride + emp_slot[e]]. mapping keeps the file mapped
+    const float* mapped = nullptr;
+    size_t mapped_stride = 0;
+    std::vector<uint32_t> emp_slot;
+    std::vector<uint32_t> tar_slot;
+    std::shared_ptr<const void> mapping;
+
+    float at(int employee_index, int target_index) const
+    {
+        if (mapped) {
+            return mapped[(size_t)tar_slot[target_index] * mapped_stride + emp_slot[employee_index]];
+        }
+        return dist[(size_t)target_index * num_employees + employee_index];
+    }
+    // only for matrices that own their distances (mapped ones aren't contiguous per target)
+    const float* row(int target_index) const { return &dist[(size_t)target_index * num_employees]; }
+};
+
+// pruning of implausible employee-target pairs before the model is built (see candidates.h).
+// both off means every pair gets a variable
+struct PruningOptions {
+    // keep the k nearest employees of every target
+    int k_nearest = 0;
+    // and/or everyone within this many km of the target
+    float radius_km = 0;
+};
+
+// which solver the enemies and friends model is handed to
+enum class Backend {
+    Scip,
+    CpSat,
 };
 
-struct Distance {
-    Employee employee;
-    Target target;
-    float distance;
+// an improving solution found while the solver is still searching
+struct Incumbent {
+    // total distance of this solution (without the friend rewards)
+    double km;
+    // since the solve started
+    double seconds;
+    // (employee index, target index) pairs
+    std::vector<std::pair<int, int>> pairs;
+};
+
+struct SolverOptions {
+    PruningOptions pruning;
+    Backend backend = Backend::Scip;
+    // cp-sat search threads, 0 = all cores
+    int num_workers = 0;
+
+    // stop searching after this many seconds and keep the best solution so far, 0 = no limit
+    double time_limit_seconds = 0;
+    // stop once the solution is proven within this relative gap of optimal (0.01 = 1%), 0 = solver default
+    double relative_gap = 0;
+    // called for every improving solution during the search (scip and cp-sat models)
+    std::function<void(const Incumbent&)> on_incumbent;
+
+    // scip models: employees with the same distances and no enemies/friends share one integer variable per target
+    // (see aggregate.h). aggregate_km > 0 also merges employees whose distances only differ by about that much
+    bool aggregate = true;
+    float aggregate_km = 0;
+
+    // (employee index, target index) pairs of a known plan (e.g. from assignEmployeesHeuristic, heuristic.h),
+    // handed to scip/cp-sat as the solution to start from. pairs that were pruned are left out
+    std::vector<std::pair<int, int>> hint;
+
+    // roster mode: how many shifts one employee may work on the same day
+    int max_shifts_per_day = 2;
+};
+
+enum class SolveStatus {
+    NotSolved,
+    Optimal,
+    // a solution, but the search stopped before proving it optimal (time limit / gap)
+    Feasible,
+};
+
+// one employee on one target
+struct AssignedPair {
+    int employee;
+    int target;
+    float km;
+};
+
+// size of the (last) model that was solved and how long the search took
+struct SolverStats {
+    int num_variables = 0;
+    int num_constraints = 0;
+    // branch and bound nodes (scip), branches (cp-sat) or perturbation rounds (heuristic)
+    int64_t nodes = 0;
+    double wall_seconds = 0;
+};
+
+// what a solver came up with, printed or exported by result.h
+struct AssignmentResult {
+    // "scip", "cp-sat", "min-cost-flow", "balanced", "roster", "incremental" or "heuristic"
+    std::string solver;
+    SolveStatus status = SolveStatus::NotSolved;
+    // relative gap between the solution and the best bound, 0 when optimal
+    double gap = 0;
+    // summed up from the distances, so it doesn't include the friend rewards
+    double total_km = 0;
+    // the longest single distance (what the balanced mode minimizes)
+    double longest_km = 0;
+    std::vector<AssignedPair> pairs;
+    SolverStats stats;
+
+    bool solved() const { return status != SolveStatus::NotSolved; }
+    void add(int employee, int target, float km)
+    {
+        pairs.push_back({employee, target, km});
+        total_km += km;
+        longest_km = std::max<double>(longest_km, km);
+    }
 };
 
 namespace operations_research {
-    void assignEmployees(std::vector<Distance>& distances, std::vector<Employee>& employees, std::vector<Target>& targets);
-    void assignEmployeesBalanced(std::vector<Distance>& distances, std::vector<Employee>& employees, std::vector<Target>& targets);
-    void assignEmployeesEnemiesAndFriends(std::vector<Distance>& distances, std::vector<Employee>& employees, std::vector<Target>& targets, std::vector<No_pair>& conflicts, std::vector<std::pair<int, std::vector<int>>> &friend_groups);
+    AssignmentResult assignEmployees(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets, const SolverOptions& options = SolverOptions());
+    AssignmentResult assignEmployeesMinCostFlow(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets, const SolverOptions& options = SolverOptions());
+    AssignmentResult assignEmployeesBalanced(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets, const SolverOptions& options = SolverOptions());
+    AssignmentResult assignEmployeesEnemiesAndFriends(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets, const RelationGraph& relations, const SolverOptions& options = SolverOptions());
+    AssignmentResult assignEmployeesEnemiesAndFriendsCpSat(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets, const RelationGraph& relations, const SolverOptions& options = SolverOptions());
 }
 
 #endif 
\ No newline at end of file
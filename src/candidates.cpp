@@ -0,0 +1,266 @@
+#include "candidates.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+#include "solverlog.h"
+#include "trace.h"
+#include "ortools/graph/max_flow.h"
+
+KdTree::KdTree(const PreparedPoints& points)
+    : coords{points.xf, points.yf, points.zf}, order(points.xf.size())
+{
+    std::iota(order.begin(), order.end(), 0);
+    build(0, order.size(), 0);
+}
+
+void KdTree::build(int lo, int hi, int axis)
+{
+    if (hi - lo <= 1) {
+        return;
+    }
+
+    int mid = (lo + hi) / 2;
+    const std::vector<float>& c = coords[axis];
+    std::nth_element(order.begin() + lo, order.begin() + mid, order.begin() + hi, [&c](int a, int b) { return c[a] < c[b]; });
+
+    build(lo, mid, (axis + 1) % 3);
+    build(mid + 1, hi, (axis + 1) % 3);
+}
+
+void KdTree::searchNearest(int lo, int hi, int axis, const float q[3], size_t k, std::vector<std::pair<float, int>>& heap) const
+{
+    if (lo >= hi) {
+        return;
+    }
+
+    int mid = (lo + hi) / 2;
+    int p = order[mid];
+    float dx = coords[0][p] - q[0], dy = coords[1][p] - q[1], dz = coords[2][p] - q[2];
+    float d2 = dx * dx + dy * dy + dz * dz;
+
+    // heap is a max-heap on distance holding the best k so far
+    if (heap.size() < k) {
+        heap.emplace_back(d2, p);
+        std::push_heap(heap.begin(), heap.end());
+    } else if (d2 < heap.front().first) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = {d2, p};
+        std::push_heap(heap.begin(), heap.end());
+    }
+
+    float diff = q[axis] - coords[axis][p];
+    int next_axis = (axis + 1) % 3;
+    bool left_first = diff < 0;
+
+    if (left_first) {
+        searchNearest(lo, mid, next_axis, q, k, heap);
+    } else {
+        searchNearest(mid + 1, hi, next_axis, q, k, heap);
+    }
+
+    // only cross the split plane if it's closer than the current k-th best
+    if (heap.size() < k || diff * diff < heap.front().first) {
+        if (left_first) {
+            searchNearest(mid + 1, hi, next_axis, q, k, heap);
+        } else {
+            searchNearest(lo, mid, next_axis, q, k, heap);
+        }
+    }
+}
+
+void KdTree::searchChord(int lo, int hi, int axis, const float q[3], float chord2, std::vector<int>& out) const
+{
+    if (lo >= hi) {
+        return;
+    }
+
+    int mid = (lo + hi) / 2;
+    int p = order[mid];
+    float dx = coords[0][p] - q[0], dy = coords[1][p] - q[1], dz = coords[2][p] - q[2];
+    if (dx * dx + dy * dy + dz * dz <= chord2) {
+        out.push_back(p);
+    }
+
+    float diff = q[axis] - coords[axis][p];
+    int next_axis = (axis + 1) % 3;
+    if (diff < 0 || diff * diff <= chord2) {
+        searchChord(lo, mid, next_axis, q, chord2, out);
+    }
+    if (diff >= 0 || diff * diff <= chord2) {
+        searchChord(mid + 1, hi, next_axis, q, chord2, out);
+    }
+}
+
+void KdTree::nearest(float x, float y, float z, int k, std::vector<int>& out) const
+{
+    out.clear();
+    if (k <= 0) {
+        return;
+    }
+
+    const float q[3] = {x, y, z};
+    std::vector<std::pair<float, int>> heap;
+    heap.reserve(k + 1);
+    searchNearest(0, order.size(), 0, q, k, heap);
+
+    std::sort_heap(heap.begin(), heap.end());
+    for (const auto& [d2, p] : heap) {
+        out.push_back(p);
+    }
+}
+
+void KdTree::withinChord(float x, float y, float z, float chord, std::vector<int>& out) const
+{
+    out.clear();
+    const float q[3] = {x, y, z};
+    searchChord(0, order.size(), 0, q, chord * chord, out);
+}
+
+bool CandidateArcs::complete() const
+{
+    return std::all_of(allowed.begin(), allowed.end(), [](char a) { return a != 0; });
+}
+
+size_t CandidateArcs::count() const
+{
+    return std::count(allowed.begin(), allowed.end(), 1);
+}
+
+CandidateArcs allArcs(const DistanceMatrix& distances)
+{
+    CandidateArcs arcs;
+    arcs.num_employees = distances.num_employees;
+    arcs.num_targets = distances.num_targets;
+    arcs.allowed.assign((size_t)arcs.num_employees * arcs.num_targets, 1);
+    return arcs;
+}
+
+// fills arcs.allowed from arcs.k_nearest / arcs.radius_km
+static void generateArcs(CandidateArcs& arcs, const DistanceMatrix& distances)
+{
+    int k = arcs.k_nearest;
+    bool use_radius = arcs.radius_km > 0;
+
+    if ((k <= 0 && !use_radius) || k >= arcs.num_employees) {
+        arcs.allowed.assign(arcs.allowed.size(), 1);
+        return;
+    }
+
+    arcs.allowed.assign(arcs.allowed.size(), 0);
+
+    PreparedPoints emp_points = preparePoints(distances.emp_lat, distances.emp_lon, Precision::Single);
+    PreparedPoints tar_points = preparePoints(distances.tar_lat, distances.tar_lon, Precision::Single);
+    KdTree tree(emp_points);
+
+    // arc length on the sphere -> straight line through it
+    float chord = 2.0f * std::sin(std::min(arcs.radius_km / (2.0f * R), 1.5707963f));
+
+    std::vector<int> found;
+    for (int t = 0; t < arcs.num_targets; ++t) {
+        char* row = &arcs.allowed[(size_t)t * arcs.num_employees];
+        float x = tar_points.xf[t], y = tar_points.yf[t], z = tar_points.zf[t];
+
+        if (k > 0) {
+            tree.nearest(x, y, z, k, found);
+            for (int e : found) {
+                row[e] = 1;
+            }
+        }
+        if (use_radius) {
+            tree.withinChord(x, y, z, chord, found);
+            for (int e : found) {
+                row[e] = 1;
+            }
+        }
+    }
+}
+
+bool widenCandidates(CandidateArcs& arcs, const DistanceMatrix& distances)
+{
+    if (arcs.complete()) {
+        return false;
+    }
+
+    if (arcs.k_nearest > 0) {
+        arcs.k_nearest *= 2;
+    }
+    if (arcs.radius_km > 0) {
+        arcs.radius_km *= 2;
+        // half the earth's circumference covers everything
+        if (arcs.radius_km >= M_PI * R) {
+            arcs.k_nearest = arcs.num_employees;
+        }
+    }
+    generateArcs(arcs, distances);
+    return true;
+}
+
+// max flow source -> employees (capacity 1) -> allowed targets (1) -> sink (req_employees), over the pairs
+// usable() lets through. push-relabel, so no recursion however many people are required
+template <typename Usable>
+static bool staffable(const CandidateArcs& arcs, const std::vector<Target>& targets, Usable usable)
+{
+    TRACE_SCOPE("max flow");
+    int num_employees = arcs.num_employees;
+    int num_targets = arcs.num_targets;
+
+    int64_t total_required = 0;
+    for (const auto& tar : targets) {
+        total_required += tar.req_employees;
+    }
+    if (total_required > num_employees) {
+        return false;
+    }
+
+    int source = num_employees + num_targets;
+    int sink = source + 1;
+    operations_research::SimpleMaxFlow max_flow;
+    for (int e = 0; e < num_employees; ++e) {
+        max_flow.AddArcWithCapacity(source, e, 1);
+    }
+    for (int t = 0; t < num_targets; ++t) {
+        int candidates = 0;
+        for (int e = 0; e < num_employees; ++e) {
+            if (arcs.isAllowed(e, t) && usable(e, t)) {
+                max_flow.AddArcWithCapacity(e, num_employees + t, 1);
+                ++candidates;
+            }
+        }
+        // not even enough candidates of its own, no need for the flow
+        if (candidates < targets[t].req_employees) {
+            return false;
+        }
+        max_flow.AddArcWithCapacity(num_employees + t, sink, targets[t].req_employees);
+    }
+
+    return max_flow.Solve(source, sink) == operations_research::SimpleMaxFlow::OPTIMAL && max_flow.OptimalFlow() == total_required;
+}
+
+bool staffingFeasible(const CandidateArcs& arcs, const std::vector<Target>& targets)
+{
+    return staffable(arcs, targets, [](int, int) { return true; });
+}
+
+bool staffingFeasible(const CandidateArcs& arcs, const std::vector<Target>& targets, const DistanceMatrix& distances, float max_distance)
+{
+    return staffable(arcs, targets, [&](int e, int t) { return distances.at(e, t) <= max_distance; });
+}
+
+CandidateArcs buildCandidates(const DistanceMatrix& distances, const std::vector<Target>& targets, const PruningOptions& pruning)
+{
+    TRACE_SCOPE("candidates");
+    CandidateArcs arcs = allArcs(distances);
+    arcs.k_nearest = pruning.k_nearest;
+    arcs.radius_km = pruning.radius_km;
+    generateArcs(arcs, distances);
+
+    // with every pair allowed the arcs are as feasible as the instance itself (main checks the total requirement),
+    // so only pruned arcs need the max flow
+    while (!arcs.complete() && !staffingFeasible(arcs, targets) && widenCandidates(arcs, distances)) {
+        solverLog() << "candidate arcs can't staff every target, widening to k = " << arcs.k_nearest << ", radius = " << arcs.radius_km << " km" << std::endl;
+    }
+    return arcs;
+}
@@ -0,0 +1,62 @@
+#ifndef CANDIDATES_H
+#define CANDIDATES_H
+
+#include <vector>
+
+#include "assignment.h"
+#include "haversine.h"
+
+// k-d tree over points on the unit sphere (see PreparedPoints). straight-line (chord) distance
+// between unit vectors orders points the same way as the great circle distance does
+class KdTree {
+public:
+    explicit KdTree(const PreparedPoints& points);
+
+    // indices of the k points closest to (x, y, z), closest first
+    void nearest(float x, float y, float z, int k, std::vector<int>& out) const;
+    // indices of all points within the given chord length of (x, y, z), unordered
+    void withinChord(float x, float y, float z, float chord, std::vector<int>& out) const;
+
+private:
+    void build(int lo, int hi, int axis);
+    void searchNearest(int lo, int hi, int axis, const float q[3], size_t k, std::vector<std::pair<float, int>>& heap) const;
+    void searchChord(int lo, int hi, int axis, const float q[3], float chord2, std::vector<int>& out) const;
+
+    std::vector<float> coords[3];
+    // implicit tree: the node of [lo, hi) is order[(lo + hi) / 2], split axis cycles x -> y -> z
+    std::vector<int> order;
+};
+
+// which employee-target pairs get a decision variable in the models.
+// allowed[t * num_employees + e], same layout as DistanceMatrix::dist
+struct CandidateArcs {
+    int num_employees = 0;
+    int num_targets = 0;
+    std::vector<char> allowed;
+
+    // the settings these arcs were generated with, widen() grows them
+    int k_nearest = 0;
+    float radius_km = 0;
+
+    bool isAllowed(int employee_index, int target_index) const { return allowed[(size_t)target_index * num_employees + employee_index]; }
+    bool complete() const;
+    size_t count() const;
+};
+
+// every pair allowed, what the models did before pruning existed
+CandidateArcs allArcs(const DistanceMatrix& distances);
+
+// k nearest employees per target and/or everyone within the radius. widened until every target can
+// get its req_employees from its own candidates (ignoring conflicts), so the pruned model stays feasible
+CandidateArcs buildCandidates(const DistanceMatrix& distances, const std::vector<Target>& targets, const PruningOptions& pruning);
+
+// doubles k and the radius (or allows everything once that stops making sense).
+// returns false if the arcs were already complete, so callers can stop retrying
+bool widenCandidates(CandidateArcs& arcs, const DistanceMatrix& distances);
+
+// can every target be staffed using only allowed arcs, with nobody assigned twice (a max flow)
+bool staffingFeasible(const CandidateArcs& arcs, const std::vector<Target>& targets);
+// the same, only with the allowed pairs that are no longer than max_distance
+bool staffingFeasible(const CandidateArcs& arcs, const std::vector<Target>& targets, const DistanceMatrix& distances, float max_distance);
+
+#endif
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#include "assignment.h"
+#include "candidates.h"
+#include "solverlog.h"
+#include "trace.h"
+#include "ortools/sat/cp_model.h"
+#include "ortools/sat/cp_model_solver.h"
+#include "ortools/sat/sat_parameters.pb.h"
+
+namespace operations_research {
+/* Same model as assignEmployeesEnemiesAndFriends, but for the CP-SAT solver. Conflicts become AddAtMostOne
+per target, and a friend pairing is a boolean y <=> (x1 AND x2) instead of three linear rows. CP-SAT needs
+integer costs, so distances (and the friend reward) are scaled to metres. It searches with
+options.num_workers threads, and stops early on options.time_limit_seconds / options.relative_gap. */
+AssignmentResult assignEmployeesEnemiesAndFriendsCpSat(const DistanceMatrix& distances, std::vector<Employee>& employees,
+    std::vector<Target>& targets, const RelationGraph& relations, const SolverOptions& options)
+{
+    int num_employees = employees.size();
+    int num_targets = targets.size();
+    AssignmentResult result;
+    result.solver = "cp-sat";
+
+    CandidateArcs arcs = buildCandidates(distances, targets, options.pruning);
+
+    while (true) {
+        ScopedTimer build_timer("build model");
+        sat::CpModelBuilder cp_model;
+
+        // x[i][j] = 1 if employee i is assigned to target j, has[i][j] tells whether the pair survived pruning
+        std::vector<std::vector<sat::BoolVar>> x(num_employees, std::vector<sat::BoolVar>(num_targets));
+        std::vector<std::vector<char>> has(num_employees, std::vector<char>(num_targets, 0));
+
+        std::vector<sat::BoolVar> objective_vars;
+        std::vector<int64_t> objective_coeffs;
+
+        for (int i = 0; i < num_employees; ++i) {
+            for (int j = 0; j < num_targets; ++j) {
+                if (!arcs.isAllowed(i, j)) continue;
+
+                x[i][j] = cp_model.NewBoolVar().WithName("x_" + std::to_string(i) + "_" + std::to_string(j));
+                has[i][j] = 1;
+
+                // objective: minimize the total distance (in metres)
+                objective_vars.push_back(x[i][j]);
+                objective_coeffs.push_back(std::llround(distances.at(i, j) * 1000.0));
+            }
+        }
+
+        // constraint: each employee is assigned at most once
+        for (int i = 0; i < num_employees; ++i) {
+            std::vector<sat::BoolVar> row;
+            for (int j = 0; j < num_targets; ++j) {
+                if (has[i][j]) row.push_back(x[i][j]);
+            }
+            cp_model.AddAtMostOne(row);
+        }
+
+        // constraint: each target has a required number of people that need to be on location
+        for (int j = 0; j < num_targets; ++j) {
+            std::vector<sat::BoolVar> column;
+            for (int i = 0; i < num_employees; ++i) {
+                if (has[i][j]) column.push_back(x[i][j]);
+            }
+            cp_model.AddEquality(sat::LinearExpr::Sum(column), targets[j].req_employees);
+        }
+
+        // constraint: some employees hate one another, don't pair them
+        for (const auto& [first_employee, second_employee] : relations.conflicts) {
+            for (int k = 0; k < num_targets; ++k) {
+                if (has[first_employee][k] && has[second_employee][k]) {
+                    cp_model.AddAtMostOne({x[first_employee][k], x[second_employee][k]});
+                }
+            }
+        }
+
+        // friends: y <=> x1 AND x2, rewarded in the objective
+        for (const auto& [main_character_id, friend_id] : relations.friends) {
+            for (int t = 0; t < num_targets; ++t) {
+                if (!has[main_character_id][t] || !has[friend_id][t]) continue;
+                sat::BoolVar x1 = x[main_character_id][t];
+                sat::BoolVar x2 = x[friend_id][t];
+
+                sat::BoolVar y = cp_model.NewBoolVar().WithName("y_" + std::to_string(main_character_id) + "_" + std::to_string(friend_id) + "_" + std::to_string(t));
+                cp_model.AddBoolAnd({x1, x2}).OnlyEnforceIf(y);
+                cp_model.AddBoolOr({x1.Not(), x2.Not()}).OnlyEnforceIf(y.Not());
+
+                objective_vars.push_back(y);
+                objective_coeffs.push_back(-std::llround(FAVOR_COEFFICIENT * 1000.0));
+            }
+        }
+
+        cp_model.Minimize(sat::LinearExpr::WeightedSum(objective_vars, objective_coeffs));
+
+        // warm start from options.hint, every pair that is in the model
+        if (!options.hint.empty()) {
+            std::vector<std::vector<char>> hinted(num_employees, std::vector<char>(num_targets, 0));
+            for (const auto& [i, j] : options.hint) {
+                hinted[i][j] = 1;
+            }
+            for (int i = 0; i < num_employees; ++i) {
+                for (int j = 0; j < num_targets; ++j) {
+                    if (has[i][j]) cp_model.AddHint(x[i][j], hinted[i][j]);
+                }
+            }
+        }
+        const sat::CpModelProto model_proto = cp_model.Build();
+        build_timer.stop();
+
+        // all cores unless told otherwise
+        int num_workers = options.num_workers > 0 ? options.num_workers : std::max(1u, std::thread::hardware_concurrency());
+
+        sat::SatParameters parameters;
+        parameters.set_num_workers(num_workers);
+        if (options.time_limit_seconds > 0) {
+            parameters.set_max_time_in_seconds(options.time_limit_seconds);
+        }
+        if (options.relative_gap > 0) {
+            parameters.set_relative_gap_limit(options.relative_gap);
+        }
+
+        sat::Model model;
+        model.Add(sat::NewSatParameters(parameters));
+
+        // stream every improving solution while the workers keep searching
+        if (options.on_incumbent) {
+            auto start = std::chrono::steady_clock::now();
+            model.Add(sat::NewFeasibleSolutionObserver([&](const sat::CpSolverResponse& r) {
+                Incumbent incumbent;
+                incumbent.km = 0;
+                incumbent.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                for (int i = 0; i < num_employees; ++i) {
+                    for (int j = 0; j < num_targets; ++j) {
+                        if (has[i][j] && sat::SolutionBooleanValue(r, x[i][j])) {
+                            incumbent.pairs.emplace_back(i, j);
+                            incumbent.km += distances.at(i, j);
+                        }
+                    }
+                }
+                options.on_incumbent(incumbent);
+            }));
+        }
+
+        ScopedTimer solve_timer("cp-sat solve");
+        solve_timer.arg("variables", model_proto.variables_size());
+        solve_timer.arg("constraints", model_proto.constraints_size());
+        const sat::CpSolverResponse response = sat::SolveCpModel(model_proto, &model);
+        solve_timer.stop();
+
+        result.stats.num_variables = model_proto.variables_size();
+        result.stats.num_constraints = model_proto.constraints_size();
+        result.stats.nodes = response.num_branches();
+        result.stats.wall_seconds = response.wall_time();
+
+        if (response.status() == sat::CpSolverStatus::OPTIMAL || response.status() == sat::CpSolverStatus::FEASIBLE) {
+            if (response.status() == sat::CpSolverStatus::OPTIMAL) {
+                result.status = SolveStatus::Optimal;
+                solverLog() << "Optimal assignment found! (cp-sat, " << num_workers << " workers)" << std::endl;
+            } else {
+                result.status = SolveStatus::Feasible;
+                result.gap = std::abs(response.objective_value() - response.best_objective_bound())
+                    / std::max(std::abs(response.objective_value()), 1e-9);
+                solverLog() << "Feasible assignment found (cp-sat, " << num_workers << " workers, stopped early, gap: " << result.gap * 100.0 << "%)" << std::endl;
+            }
+
+            // the objective contains the friend rewards, so the km are summed up separately
+            for (int i = 0; i < num_employees; ++i) {
+                for (int j = 0; j < num_targets; ++j) {
+                    if (has[i][j] && sat::SolutionBooleanValue(response, x[i][j])) {
+                        result.add(i, j, distances.at(i, j));
+                    }
+                }
+            }
+        } else if (response.status() == sat::CpSolverStatus::INFEASIBLE && widenCandidates(arcs, distances)) {
+            solverLog() << "pruned model is infeasible, retrying with " << arcs.count() << " candidate pairs..." << std::endl;
+            continue;
+        } else {
+            solverLog() << "no solution found..." << std::endl;
+        }
+        break;
+    }
+    return result;
+}
+}
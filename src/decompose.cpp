@@ -0,0 +1,326 @@
+#include "decompose.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+#include "haversine.h"
+#include "heuristic.h"
+#include "relations.h"
+#include "solverlog.h"
+#include "trace.h"
+#include "ortools/graph/min_cost_flow.h"
+
+namespace operations_research {
+using Point = std::array<double, 3>;
+
+static Point unitVector(float lat, float lon)
+{
+    double la = lat * M_PI / 180.0;
+    double lo = lon * M_PI / 180.0;
+    return {std::cos(la) * std::cos(lo), std::cos(la) * std::sin(lo), std::sin(la)};
+}
+
+static double squaredChord(const Point& a, const Point& b)
+{
+    double dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+// k-means over the target locations, every target weighted by its req_employees. starts from the farthest
+// point heuristic instead of random centers, so the regions are the same every run.
+// returns the region of every target, empty regions are dropped
+static std::vector<int> clusterTargets(const DistanceMatrix& distances, const std::vector<Target>& targets, int k)
+{
+    TRACE_SCOPE("cluster targets");
+    int num_targets = targets.size();
+    std::vector<Point> points(num_targets);
+    for (int j = 0; j < num_targets; ++j) {
+        points[j] = unitVector(distances.tar_lat[j], distances.tar_lon[j]);
+    }
+
+    // farthest point: start with the target farthest from the overall mean, then keep adding the target
+    // farthest from all centers so far
+    Point mean = {0, 0, 0};
+    for (const auto& p : points) {
+        for (int a = 0; a < 3; ++a) mean[a] += p[a] / num_targets;
+    }
+    std::vector<double> nearest(num_targets, std::numeric_limits<double>::infinity());
+    std::vector<Point> centers;
+    int next = 0;
+    for (int j = 1; j < num_targets; ++j) {
+        if (squaredChord(points[j], mean) > squaredChord(points[next], mean)) next = j;
+    }
+    while ((int)centers.size() < k) {
+        centers.push_back(points[next]);
+        for (int j = 0; j < num_targets; ++j) {
+            nearest[j] = std::min(nearest[j], squaredChord(points[j], centers.back()));
+        }
+        next = std::max_element(nearest.begin(), nearest.end()) - nearest.begin();
+        // fewer distinct locations than regions
+        if (nearest[next] == 0) break;
+    }
+
+    std::vector<int> region(num_targets, 0);
+    for (int iteration = 0; iteration < 50; ++iteration) {
+        bool changed = false;
+        for (int j = 0; j < num_targets; ++j) {
+            int best = 0;
+            for (int c = 1; c < (int)centers.size(); ++c) {
+                if (squaredChord(points[j], centers[c]) < squaredChord(points[j], centers[best])) best = c;
+            }
+            if (best != region[j] || iteration == 0) changed = true;
+            region[j] = best;
+        }
+        if (!changed) break;
+
+        std::vector<Point> sums(centers.size(), Point{0, 0, 0});
+        std::vector<double> weights(centers.size(), 0);
+        for (int j = 0; j < num_targets; ++j) {
+            double w = std::max(1, targets[j].req_employees);
+            for (int a = 0; a < 3; ++a) sums[region[j]][a] += points[j][a] * w;
+            weights[region[j]] += w;
+        }
+        for (size_t c = 0; c < centers.size(); ++c) {
+            if (weights[c] > 0) {
+                for (int a = 0; a < 3; ++a) centers[c][a] = sums[c][a] / weights[c];
+            }
+        }
+    }
+
+    // renumber without the empty ones
+    std::vector<int> renumber(centers.size(), -1);
+    int num_regions = 0;
+    for (int& r : region) {
+        if (renumber[r] < 0) renumber[r] = num_regions++;
+        r = renumber[r];
+    }
+    return region;
+}
+
+// hands every region its req_employees plus a share of the spare employees (in proportion to its demand),
+// using the employees closest to the region's targets. employees nobody needs stay at -1
+static std::vector<int> assignEmployeesToRegions(const DistanceMatrix& distances, const std::vector<Target>& targets,
+    const std::vector<int>& target_region, int num_regions)
+{
+    TRACE_SCOPE("region quotas");
+    int num_employees = distances.num_employees;
+    int num_targets = targets.size();
+
+    std::vector<int64_t> demand(num_regions, 0);
+    int64_t total_demand = 0;
+    for (int j = 0; j < num_targets; ++j) {
+        demand[target_region[j]] += targets[j].req_employees;
+        total_demand += targets[j].req_employees;
+    }
+    int64_t spare = num_employees - total_demand;
+    std::vector<int64_t> quota(num_regions);
+    int64_t total_quota = 0;
+    for (int r = 0; r < num_regions; ++r) {
+        quota[r] = demand[r] + (total_demand > 0 ? spare * demand[r] / total_demand : 0);
+        total_quota += quota[r];
+    }
+
+    // employee -> region costs the distance to the closest target of that region. only the closest few
+    // regions of every employee get an arc, all of them if that turns out infeasible
+    std::vector<std::pair<float, int>> closest(num_regions);
+    for (int per_employee = std::min(num_regions, 8);; per_employee = num_regions) {
+        int source = num_employees + num_regions;
+        int sink = source + 1;
+        SimpleMinCostFlow flow;
+        for (int i = 0; i < num_employees; ++i) {
+            flow.AddArcWithCapacityAndUnitCost(source, i, 1, 0);
+        }
+        std::vector<std::pair<int, int>> arc_pairs;
+        std::vector<int> arc_index;
+        for (int i = 0; i < num_employees; ++i) {
+            for (int r = 0; r < num_regions; ++r) {
+                closest[r] = {std::numeric_limits<float>::infinity(), r};
+            }
+            for (int j = 0; j < num_targets; ++j) {
+                float& km = closest[target_region[j]].first;
+                km = std::min(km, distances.at(i, j));
+            }
+            std::partial_sort(closest.begin(), closest.begin() + per_employee, closest.end());
+            for (int o = 0; o < per_employee; ++o) {
+                const auto& [km, r] = closest[o];
+                arc_index.push_back(flow.AddArcWithCapacityAndUnitCost(i, num_employees + r, 1, std::llround(km * 1000.0)));
+                arc_pairs.emplace_back(i, r);
+            }
+        }
+        for (int r = 0; r < num_regions; ++r) {
+            flow.AddArcWithCapacityAndUnitCost(num_employees + r, sink, quota[r], 0);
+        }
+        flow.SetNodeSupply(source, total_quota);
+        flow.SetNodeSupply(sink, -total_quota);
+
+        if (flow.Solve() == SimpleMinCostFlow::OPTIMAL) {
+            std::vector<int> employee_region(num_employees, -1);
+            for (size_t a = 0; a < arc_index.size(); ++a) {
+                if (flow.Flow(arc_index[a]) > 0) employee_region[arc_pairs[a].first] = arc_pairs[a].second;
+            }
+            return employee_region;
+        }
+        if (per_employee == num_regions) break;
+    }
+
+    // more people needed than there are, nobody gets a region
+    return std::vector<int>(num_employees, -1);
+}
+
+// one region as an instance of its own, indices mapped back through emp_index/tar_index
+struct Region {
+    std::vector<int> emp_index;
+    std::vector<int> tar_index;
+    AssignmentResult result;
+};
+
+static void solveRegion(Region& region, const DistanceMatrix& distances, const std::vector<Employee>& employees,
+    const std::vector<Target>& targets, const RelationGraph& relations, const SolverOptions& options, const AssignFn& solve)
+{
+    ScopedTimer timer("region solve");
+    int num_employees = region.emp_index.size();
+    int num_targets = region.tar_index.size();
+    timer.arg("employees", num_employees);
+    timer.arg("targets", num_targets);
+
+    DistanceMatrix sub = subMatrix(distances, region.emp_index, region.tar_index);
+    std::vector<Employee> sub_employees;
+    std::vector<Target> sub_targets;
+    std::vector<int> to_local(employees.size(), -1);
+    for (int i = 0; i < num_employees; ++i) {
+        to_local[region.emp_index[i]] = i;
+        sub_employees.push_back(employees[region.emp_index[i]]);
+    }
+    for (int t : region.tar_index) {
+        sub_targets.push_back(targets[t]);
+    }
+    RelationGraph sub_relations = subRelations(relations, to_local, num_employees);
+
+    AssignmentResult local = solve(sub, sub_employees, sub_targets, sub_relations, options);
+    region.result = local;
+    region.result.pairs.clear();
+    for (const auto& pair : local.pairs) {
+        region.result.pairs.push_back({region.emp_index[pair.employee], region.tar_index[pair.target], pair.km});
+    }
+}
+
+// km per region of the given assignment
+static std::vector<double> regionKm(const AssignmentResult& result, const std::vector<int>& target_region, int num_regions)
+{
+    std::vector<double> km(num_regions, 0);
+    for (const auto& pair : result.pairs) {
+        km[target_region[pair.target]] += pair.km;
+    }
+    return km;
+}
+
+AssignmentResult assignDecomposed(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets,
+    const RelationGraph& relations, const SolverOptions& options, const DecomposeOptions& decompose, const AssignFn& solve)
+{
+    int num_targets = targets.size();
+    AssignmentResult result;
+    result.solver = "decomposed";
+    if (num_targets == 0) {
+        result.status = SolveStatus::Optimal;
+        return result;
+    }
+
+    int k = decompose.num_regions > 0 ? decompose.num_regions : (num_targets + 24) / 25;
+    k = std::max(1, std::min(k, num_targets));
+    std::vector<int> target_region = clusterTargets(distances, targets, k);
+    int num_regions = *std::max_element(target_region.begin(), target_region.end()) + 1;
+    std::vector<int> employee_region = assignEmployeesToRegions(distances, targets, target_region, num_regions);
+
+    std::vector<Region> regions(num_regions);
+    for (int j = 0; j < num_targets; ++j) {
+        regions[target_region[j]].tar_index.push_back(j);
+    }
+    for (int i = 0; i < distances.num_employees; ++i) {
+        if (employee_region[i] >= 0) regions[employee_region[i]].emp_index.push_back(i);
+    }
+
+    // the regions run side by side, so each one gets a single solver thread and nobody streams incumbents
+    SolverOptions region_options = options;
+    region_options.num_workers = 1;
+    region_options.on_incumbent = nullptr;
+
+    std::atomic<size_t> next_region{0};
+    auto worker = [&]() {
+        for (size_t r = next_region++; r < regions.size(); r = next_region++) {
+            solveRegion(regions[r], distances, employees, targets, relations, region_options, solve);
+        }
+    };
+
+    int num_threads = options.num_workers > 0 ? options.num_workers : std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::max(1, std::min<int>(num_threads, num_regions));
+    solverLog() << "solving " << num_regions << " region(s) on " << num_threads << " thread(s)..." << std::endl;
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < num_threads; ++w) {
+        threads.emplace_back(worker);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    // the regions' solutions put together, improved across the region borders (targets left short by a region
+    // without a solution are filled first)
+    LocalSearch repair(distances, targets, relations, decompose.use_relations);
+    int unsolved = 0;
+    for (const auto& region : regions) {
+        if (!region.result.solved()) ++unsolved;
+        for (const auto& pair : region.result.pairs) {
+            repair.place(pair.employee, pair.target);
+        }
+        result.stats.num_variables += region.result.stats.num_variables;
+        result.stats.num_constraints += region.result.stats.num_constraints;
+        result.stats.nodes += region.result.stats.nodes;
+        result.stats.wall_seconds = std::max(result.stats.wall_seconds, region.result.stats.wall_seconds);
+    }
+
+    bool complete;
+    {
+        TRACE_SCOPE("boundary repair");
+        complete = repair.fill();
+        for (int round = 0; round < decompose.repair_rounds; ++round) {
+            if (!repair.improve()) break;
+        }
+    }
+
+    const std::vector<int>& target_of = repair.assignment();
+    for (int i = 0; i < distances.num_employees; ++i) {
+        if (target_of[i] >= 0) result.add(i, target_of[i], distances.at(i, target_of[i]));
+    }
+    // not proven optimal, even if every region was
+    result.status = complete ? SolveStatus::Feasible : SolveStatus::NotSolved;
+    solverLog() << num_regions - unsolved << "/" << num_regions << " region(s) solved, boundary repair made " << repair.numMoves() << " move(s)" << std::endl;
+    if (!complete) {
+        solverLog() << "some targets couldn't be staffed..." << std::endl;
+    }
+
+    if (decompose.compare_full) {
+        solverLog() << "solving the whole instance for comparison..." << std::endl;
+        AssignmentResult full = solve(distances, employees, targets, relations, options);
+        if (!full.solved()) {
+            solverLog() << "no full solution to compare with" << std::endl;
+            return result;
+        }
+
+        std::vector<double> decomposed_km = regionKm(result, target_region, num_regions);
+        std::vector<double> full_km = regionKm(full, target_region, num_regions);
+        for (int r = 0; r < num_regions; ++r) {
+            double loss = full_km[r] > 0 ? (decomposed_km[r] - full_km[r]) / full_km[r] * 100.0 : 0;
+            solverLog() << "region " << r << ": " << regions[r].tar_index.size() << " targets, " << regions[r].emp_index.size() << " employees, "
+                      << decomposed_km[r] << " km (full solve: " << full_km[r] << " km, " << (loss >= 0 ? "+" : "") << loss << "%)" << std::endl;
+        }
+        double loss = full.total_km > 0 ? (result.total_km - full.total_km) / full.total_km * 100.0 : 0;
+        solverLog() << "decomposed: " << result.total_km << " km, full solve: " << full.total_km << " km (" << (loss >= 0 ? "+" : "") << loss << "%)" << std::endl;
+    }
+    return result;
+}
+}
@@ -0,0 +1,36 @@
+#ifndef DECOMPOSE_H
+#define DECOMPOSE_H
+
+#include <functional>
+#include <vector>
+
+#include "assignment.h"
+
+// solves one (sub)instance, e.g. with the min cost flow or the enemies and friends MIP
+using AssignFn = std::function<AssignmentResult(const DistanceMatrix&, std::vector<Employee>&, std::vector<Target>&,
+    const RelationGraph&, const SolverOptions&)>;
+
+struct DecomposeOptions {
+    // number of regions, 0 = about one per 25 targets
+    int num_regions = 0;
+    // rounds of boundary repair, stops early once a round doesn't improve anything
+    int repair_rounds = 5;
+    // whether the solver keeps enemies apart and rewards friends (the repair has to do the same)
+    bool use_relations = true;
+    // also solve the whole instance in one go and report how much worse every region came out.
+    // only for instances that are still small enough to solve at once
+    bool compare_full = false;
+};
+
+namespace operations_research {
+    /* For instances too big for one model: the targets are clustered into regions (k-means on their
+    location, weighted by req_employees) and every region gets a share of the employees, the closest ones,
+    through a small transportation problem. The regions are solved as independent sub-instances in parallel
+    (options.num_workers threads, 0 = all cores). Then a boundary repair works on the whole solution: it fills
+    targets a region couldn't staff and swaps/replaces employees with nearby ones from other regions whenever
+    that lowers the cost, keeping enemies apart. */
+    AssignmentResult assignDecomposed(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets,
+        const RelationGraph& relations, const SolverOptions& options, const DecomposeOptions& decompose, const AssignFn& solve);
+}
+
+#endif
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include "assignment.h"
+#include "candidates.h"
+#include "solverlog.h"
+#include "trace.h"
+#include "ortools/graph/min_cost_flow.h"
+
+namespace operations_research {
+// min cost flow over the candidate arcs no longer than max_distance: source -> every employee (capacity 1)
+// -> every candidate target (capacity 1, cost = distance) -> sink (capacity req_employees). the source has to
+// push sum(req_employees) units through, so the cheapest flow is the assignment with the least km.
+// assigned gets the (employee index, target index) pairs of the solution, stats the size of the network
+static SimpleMinCostFlow::Status solveMinCostFlow(const DistanceMatrix& distances, const std::vector<Target>& targets,
+    const CandidateArcs& arcs, float max_distance, std::vector<std::pair<int, int>>& assigned, SolverStats& stats)
+{
+    ScopedTimer timer("min cost flow");
+
+    int num_employees = distances.num_employees;
+    int num_targets = distances.num_targets;
+
+    int source = num_employees + num_targets;
+    int sink = source + 1;
+
+    int64_t total_required = 0;
+    for (const auto& t : targets) {
+        total_required += t.req_employees;
+    }
+
+    SimpleMinCostFlow min_cost_flow;
+
+    for (int i = 0; i < num_employees; ++i) {
+        min_cost_flow.AddArcWithCapacityAndUnitCost(source, i, 1, 0);
+    }
+
+    // costs have to be integers, distances are used in metres
+    std::vector<std::pair<int, int>> arc_pairs;
+    std::vector<int> arc_indices;
+    for (int j = 0; j < num_targets; ++j) {
+        for (int i = 0; i < num_employees; ++i) {
+            if (!arcs.isAllowed(i, j) || distances.at(i, j) > max_distance) continue;
+
+            int64_t metres = std::llround(distances.at(i, j) * 1000.0);
+            arc_indices.push_back(min_cost_flow.AddArcWithCapacityAndUnitCost(i, num_employees + j, 1, metres));
+            arc_pairs.emplace_back(i, j);
+        }
+    }
+
+    for (int j = 0; j < num_targets; ++j) {
+        min_cost_flow.AddArcWithCapacityAndUnitCost(num_employees + j, sink, targets[j].req_employees, 0);
+    }
+
+    min_cost_flow.SetNodeSupply(source, total_required);
+    min_cost_flow.SetNodeSupply(sink, -total_required);
+
+    auto start = std::chrono::steady_clock::now();
+    SimpleMinCostFlow::Status status = min_cost_flow.Solve();
+
+    // arcs are the variables of a flow, the flow conservation per node its constraints
+    stats.num_variables = min_cost_flow.NumArcs();
+    stats.num_constraints = min_cost_flow.NumNodes();
+    stats.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    timer.arg("arcs", stats.num_variables);
+
+    assigned.clear();
+    if (status == SimpleMinCostFlow::OPTIMAL) {
+        for (size_t a = 0; a < arc_indices.size(); ++a) {
+            if (min_cost_flow.Flow(arc_indices[a]) > 0) {
+                assigned.push_back(arc_pairs[a]);
+            }
+        }
+    }
+    return status;
+}
+
+// the total is summed up from the float distances so it matches what the MIP would report
+static void collectAssignment(AssignmentResult& result, const std::vector<std::pair<int, int>>& assigned, const DistanceMatrix& distances)
+{
+    result.status = SolveStatus::Optimal;
+    for (const auto& [i, j] : assigned) {
+        result.add(i, j, distances.at(i, j));
+    }
+}
+
+/* The plain distance-minimizing assignment (each employee at most once, each target exactly req_employees)
+is a transportation problem, which a network flow solves exactly. */
+AssignmentResult assignEmployeesMinCostFlow(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets, const SolverOptions& options)
+{
+    AssignmentResult result;
+    result.solver = "min-cost-flow";
+    CandidateArcs arcs = buildCandidates(distances, targets, options.pruning);
+    std::vector<std::pair<int, int>> assigned;
+
+    while (true) {
+        SimpleMinCostFlow::Status status = solveMinCostFlow(distances, targets, arcs, std::numeric_limits<float>::infinity(), assigned, result.stats);
+
+        if (status == SimpleMinCostFlow::OPTIMAL) {
+            solverLog() << "Optimal assignment found!" << std::endl;
+            collectAssignment(result, assigned, distances);
+        } else if (status == SimpleMinCostFlow::INFEASIBLE && widenCandidates(arcs, distances)) {
+            solverLog() << "pruned network is infeasible, retrying with " << arcs.count() << " candidate pairs..." << std::endl;
+            continue;
+        } else {
+            solverLog() << "no optimal solution found... (min cost flow status " << status << ")" << std::endl;
+        }
+        break;
+    }
+    return result;
+}
+
+/* This version of the assignment function tries to get a more balanced solution: it minimizes the longest
+distance anyone has to travel (bottleneck assignment), and then the total distance among all assignments
+that stay under that longest distance. Less outliers with very high distances, but will result in a higher
+overall distance travelled.
+The longest distance is found with a binary search over the sorted distinct distances, checking with a
+max flow whether the targets can still be staffed using only pairs up to that distance. That only gives the
+exact bottleneck over every pair, so there's no pruning here: the checks only use the pairs under their
+threshold anyway. */
+AssignmentResult assignEmployeesBalanced(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets, const SolverOptions& options)
+{
+    int num_employees = employees.size();
+    int num_targets = targets.size();
+    AssignmentResult result;
+    result.solver = "balanced";
+
+    if (options.pruning.k_nearest > 0 || options.pruning.radius_km > 0) {
+        solverLog() << "the balanced mode looks at every pair (a pruned bottleneck isn't exact), ignoring the pruning options" << std::endl;
+    }
+    CandidateArcs arcs = buildCandidates(distances, targets, PruningOptions());
+
+    // with every pair allowed it can only fail when there aren't enough employees at all
+    int required = 0;
+    for (const auto& tar : targets) required += tar.req_employees;
+    if (required > num_employees) {
+        solverLog() << "no balanced solution found..." << std::endl;
+        return result;
+    }
+
+    std::vector<float> thresholds;
+    thresholds.reserve(arcs.count());
+    for (int j = 0; j < num_targets; ++j) {
+        for (int i = 0; i < num_employees; ++i) {
+            if (arcs.isAllowed(i, j)) thresholds.push_back(distances.at(i, j));
+        }
+    }
+    std::sort(thresholds.begin(), thresholds.end());
+    thresholds.erase(std::unique(thresholds.begin(), thresholds.end()), thresholds.end());
+    if (thresholds.empty()) {
+        // no targets at all
+        thresholds.push_back(0);
+    }
+
+    // smallest threshold that still staffs every target (the largest one always does)
+    size_t lo = 0;
+    size_t hi = thresholds.size() - 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (staffingFeasible(arcs, targets, distances, thresholds[mid])) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    float bottleneck = thresholds[lo];
+
+    // least total km among the assignments that respect the bottleneck
+    std::vector<std::pair<int, int>> assigned;
+    SimpleMinCostFlow::Status status = solveMinCostFlow(distances, targets, arcs, bottleneck, assigned, result.stats);
+
+    if (status == SimpleMinCostFlow::OPTIMAL) {
+        solverLog() << "Balanced assignment found! (longest distance: " << bottleneck << " km)" << std::endl;
+        collectAssignment(result, assigned, distances);
+    } else {
+        solverLog() << "no balanced solution found... (min cost flow status " << status << ")" << std::endl;
+    }
+    return result;
+}
+}
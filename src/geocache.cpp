@@ -0,0 +1,159 @@
+#include "geocache.h"
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// bump when the layout of the cache file changes, older files are ignored then
+#define GEOCACHE_VERSION 1
+
+GeoCache::GeoCache(std::string path) : path(std::move(path)) {}
+
+static std::string normalizePart(const std::string& s)
+{
+    std::string out;
+    out.reserve(s.size());
+
+    bool pending_space = false;
+    for (unsigned char c : s) {
+        if (std::isspace(c) || c == ',') {
+            pending_space = !out.empty();
+            continue;
+        }
+        if (pending_space) {
+            out += ' ';
+            pending_space = false;
+        }
+        out += static_cast<char>(std::tolower(c));
+    }
+    return out;
+}
+
+std::string GeoCache::normalizeKey(const std::string& city, const std::string& street, const std::string& country)
+{
+    return normalizePart(city) + "|" + normalizePart(street) + "|" + normalizePart(country);
+}
+
+bool GeoCache::load()
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    try {
+        json j;
+        file >> j;
+
+        if (j.value("version", 0) != GEOCACHE_VERSION) {
+            std::cerr << "ignoring geocache " << path << " (unknown version)" << std::endl;
+            return false;
+        }
+
+        for (const auto& [key, loc] : j["entries"].items()) {
+            entries[key] = CachedLocation{loc[0].get<float>(), loc[1].get<float>()};
+        }
+        for (const auto& [owner, key] : j["owners"].items()) {
+            owners[owner] = key.get<std::string>();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "can't read geocache " << path << ": " << e.what() << std::endl;
+        entries.clear();
+        owners.clear();
+        return false;
+    }
+
+    dirty = false;
+    return true;
+}
+
+bool GeoCache::save()
+{
+    if (!dirty) {
+        return true;
+    }
+
+    json j;
+    j["version"] = GEOCACHE_VERSION;
+    j["entries"] = json::object();
+    j["owners"] = json::object();
+    for (const auto& [key, loc] : entries) {
+        j["entries"][key] = {loc.lat, loc.lon};
+    }
+    for (const auto& [owner, key] : owners) {
+        j["owners"][owner] = key;
+    }
+
+    // write to a temp file first so an interrupted run can't leave half a cache behind
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path);
+        if (!file.is_open()) {
+            std::cerr << "can't write geocache " << tmp_path << std::endl;
+            return false;
+        }
+        file << j.dump(1);
+    }
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "can't replace geocache " << path << std::endl;
+        return false;
+    }
+
+    dirty = false;
+    return true;
+}
+
+// the owner was geocoded with a different address before (moved, or the address got fixed),
+// drop the old coordinates unless someone else still lives there
+void GeoCache::invalidate(const std::string& owner, const std::string& old_key)
+{
+    for (const auto& [other, key] : owners) {
+        if (other != owner && key == old_key) {
+            return;
+        }
+    }
+    entries.erase(old_key);
+    dirty = true;
+}
+
+bool GeoCache::lookup(const std::string& owner, const std::string& key, float& lat, float& lon)
+{
+    auto owner_it = owners.find(owner);
+    if (owner_it != owners.end() && owner_it->second != key) {
+        std::string old_key = owner_it->second;
+        owners.erase(owner_it);
+        dirty = true;
+        invalidate(owner, old_key);
+    }
+
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        ++miss_count;
+        return false;
+    }
+
+    // address already known through someone else
+    std::string& owned = owners[owner];
+    if (owned != key) {
+        owned = key;
+        dirty = true;
+    }
+
+    lat = it->second.lat;
+    lon = it->second.lon;
+    ++hit_count;
+    return true;
+}
+
+void GeoCache::store(const std::string& owner, const std::string& key, float lat, float lon)
+{
+    entries[key] = CachedLocation{lat, lon};
+    owners[owner] = key;
+    dirty = true;
+}
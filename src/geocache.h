@@ -0,0 +1,48 @@
+#ifndef GEOCACHE_H
+#define GEOCACHE_H
+
+#include <string>
+#include <unordered_map>
+
+struct CachedLocation {
+    float lat;
+    float lon;
+};
+
+// persistent lon/lat cache so known addresses don't have to go through the api again.
+// entries are keyed by the normalized address (city + street + country). every employee/target
+// also remembers which key it was geocoded with (its "owner" key, e.g. "emp:12" or "tar:3"),
+// so when someone moves the old entry is dropped instead of silently reused.
+class GeoCache {
+public:
+    explicit GeoCache(std::string path);
+
+    // returns false if there is no cache file yet (or it can't be parsed), the cache is empty then
+    bool load();
+    // only writes when something changed since load()
+    bool save();
+
+    // true + lat/lon filled in when the address is known, counts as a hit or miss
+    bool lookup(const std::string& owner, const std::string& key, float& lat, float& lon);
+    // call after a successful api response
+    void store(const std::string& owner, const std::string& key, float lat, float lon);
+
+    int hits() const { return hit_count; }
+    int misses() const { return miss_count; }
+    size_t size() const { return entries.size(); }
+
+    // lowercased, whitespace collapsed, "city|street|country"
+    static std::string normalizeKey(const std::string& city, const std::string& street, const std::string& country);
+
+private:
+    void invalidate(const std::string& owner, const std::string& old_key);
+
+    std::string path;
+    std::unordered_map<std::string, CachedLocation> entries;
+    std::unordered_map<std::string, std::string> owners;
+    int hit_count = 0;
+    int miss_count = 0;
+    bool dirty = false;
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "geocoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+
+#include "trace.h"
+
+using json = nlohmann::json;
+
+RateLimit rateLimitFor(const std::string& provider, const std::string& tier)
+{
+    static const std::vector<RateLimit> known_limits = {
+        // free tier: 2 requests/s and 5000/day
+        {"locationiq", "free", 2.0, 1},
+        // local mock servers, effectively unlimited
+        {"local", "mock", 1000.0, 64},
+    };
+
+    for (const auto& limit : known_limits) {
+        if (limit.provider == provider && limit.tier == tier) {
+            return limit;
+        }
+    }
+
+    std::cerr << "no rate limit known for " << provider << "/" << tier << ", using the locationiq free tier" << std::endl;
+    return known_limits[0];
+}
+
+TokenBucket::TokenBucket(double rate, int burst)
+    : rate(rate), capacity(std::max(1, burst)), tokens(std::max(1, burst)), last_refill(std::chrono::steady_clock::now())
+{
+}
+
+void TokenBucket::acquire()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - last_refill).count();
+        tokens = std::min(capacity, tokens + elapsed * rate);
+        last_refill = now;
+
+        if (tokens >= 1.0) {
+            tokens -= 1.0;
+            return;
+        }
+
+        // sleep (holding the lock, so waiting workers queue up in order) until the next token is there
+        std::this_thread::sleep_for(std::chrono::duration<double>((1.0 - tokens) / rate));
+    }
+}
+
+GeocodeConfig geocodeConfigFromEnv(const char* apiKey)
+{
+    GeocodeConfig config;
+    config.api_key = apiKey ? apiKey : "";
+
+    if (const char* url = std::getenv("LIQ_BASE_URL")) {
+        config.base_url = url;
+    }
+    if (const char* tier = std::getenv("LIQ_TIER")) {
+        config.limit = rateLimitFor(config.base_url.find("locationiq") != std::string::npos ? "locationiq" : "local", tier);
+    }
+    if (const char* rate = std::getenv("LIQ_RATE_LIMIT")) {
+        config.limit.requests_per_second = std::max(0.1, std::atof(rate));
+    }
+    if (const char* workers = std::getenv("GEOCODE_WORKERS")) {
+        config.workers = std::max(1, std::atoi(workers));
+    }
+    return config;
+}
+
+cpr::Response forwardGeolocate(const std::string& query, const GeocodeConfig& config)
+{
+    // example api req: https://us1.locationiq.com/v1/search?key=YOUR_API_KEY&q=Statue%20of%20Liberty,%20New%20York&format=json
+
+    // TODO: make sure the query isn't ambiguous (can return multiple objects)
+    // consider using country, postal code as well.
+    ScopedTimer timer("http request", "http");
+    cpr::Response r = cpr::Get(
+        cpr::Url{config.base_url},
+        cpr::Parameters{
+            {"key", config.api_key},
+            {"q", query},
+            {"format", "json"}
+        },
+        cpr::Timeout{config.timeout});
+    timer.arg("status", r.status_code);
+    timer.arg("query", query);
+    return r;
+}
+
+// 429 (rate limited), 5xx and network errors (status 0) are worth another try, anything else is final
+static bool isRetryable(long status_code)
+{
+    return status_code == 0 || status_code == 429 || status_code >= 500;
+}
+
+static std::chrono::milliseconds backoffDelay(const cpr::Response& r, const GeocodeConfig& config, int attempt, std::mt19937& rng)
+{
+    // respect Retry-After (in seconds) when the api tells us how long to wait
+    auto retry_after = r.header.find("Retry-After");
+    if (retry_after != r.header.end()) {
+        int seconds = std::atoi(retry_after->second.c_str());
+        if (seconds > 0) {
+            return std::chrono::milliseconds(seconds * 1000);
+        }
+    }
+
+    // exponential backoff with some jitter so the workers don't retry in lockstep
+    auto delay = config.initial_backoff * (1 << std::min(attempt, 6));
+    std::uniform_int_distribution<long> jitter(0, delay.count() / 2);
+    return delay + std::chrono::milliseconds(jitter(rng));
+}
+
+static void parseResponse(GeocodeJob& job, const cpr::Response& r)
+{
+    try {
+        json response = json::parse(r.text);
+
+        if (!response.empty()) {
+            // api returns lon/lat as string
+            job.lat = std::stof(response[0]["lat"].get<std::string>());
+            job.lon = std::stof(response[0]["lon"].get<std::string>());
+            job.found = true;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "JSON parse error for '" << job.query << "': " << e.what() << std::endl;
+    }
+}
+
+void geocodeAll(std::vector<GeocodeJob>& jobs, const GeocodeConfig& config)
+{
+    TRACE_SCOPE("geocode requests");
+    if (jobs.empty()) {
+        return;
+    }
+
+    TokenBucket bucket(config.limit.requests_per_second, config.limit.burst);
+    std::atomic<size_t> next_job{0};
+
+    auto worker = [&](unsigned seed) {
+        std::mt19937 rng(seed);
+
+        for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+            GeocodeJob& job = jobs[i];
+
+            for (job.attempts = 1; ; ++job.attempts) {
+                bucket.acquire();
+                cpr::Response r = forwardGeolocate(job.query, config);
+                job.status_code = r.status_code;
+
+                if (r.status_code == 200) {
+                    parseResponse(job, r);
+                    break;
+                }
+                if (!isRetryable(r.status_code) || job.attempts > config.max_retries) {
+                    break;
+                }
+                std::this_thread::sleep_for(backoffDelay(r, config, job.attempts - 1, rng));
+            }
+        }
+    };
+
+    int num_workers = std::max(1, std::min<int>(config.workers, jobs.size()));
+    std::vector<std::thread> threads;
+    for (int w = 0; w < num_workers; ++w) {
+        threads.emplace_back(worker, 1234u + w);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef GEOCODER_H
+#define GEOCODER_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <cpr/cpr.h>
+
+// requests per second an api allows, looked up per provider + pricing tier
+struct RateLimit {
+    std::string provider;
+    std::string tier;
+    double requests_per_second;
+    int burst;
+};
+
+// known limits, falls back to the locationiq free tier (2 req/s) for anything unknown
+RateLimit rateLimitFor(const std::string& provider, const std::string& tier);
+
+// token bucket shared by all geocoding workers, acquire() blocks until a request may be sent
+class TokenBucket {
+public:
+    TokenBucket(double rate, int burst);
+    void acquire();
+
+private:
+    std::mutex mutex;
+    double rate;
+    double capacity;
+    double tokens;
+    std::chrono::steady_clock::time_point last_refill;
+};
+
+struct GeocodeConfig {
+    // point this at a local mock server to test without burning api quota
+    std::string base_url = "https://eu1.locationiq.com/v1/search";
+    std::string api_key;
+    RateLimit limit = rateLimitFor("locationiq", "free");
+    // number of requests kept in flight at the same time
+    int workers = 4;
+    // retries for 429/5xx/network errors, with exponential backoff starting at initial_backoff
+    int max_retries = 4;
+    std::chrono::milliseconds initial_backoff{500};
+    std::chrono::milliseconds timeout{10000};
+};
+
+// one address to geocode, results are filled in by geocodeAll
+struct GeocodeJob {
+    std::string query;
+    float lat = 0;
+    float lon = 0;
+    bool found = false;
+    long status_code = 0;
+    int attempts = 0;
+};
+
+// reads base url / tier / workers from env (LIQ_BASE_URL, LIQ_TIER, LIQ_RATE_LIMIT, GEOCODE_WORKERS)
+GeocodeConfig geocodeConfigFromEnv(const char* apiKey);
+
+cpr::Response forwardGeolocate(const std::string& query, const GeocodeConfig& config);
+
+// geocodes all jobs with config.workers requests in flight, never exceeding the rate limit.
+// every worker parses its own responses, so parsing overlaps with the other requests' network time
+void geocodeAll(std::vector<GeocodeJob>& jobs, const GeocodeConfig& config);
+
+#endif
@@ -0,0 +1,252 @@
+#include "haversine.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+#include "trace.h"
+
+float haversine(float lat1, float lon1, float lat2, float lon2)
+{
+    // this does not take actual roads into account
+    // it calculates the distance from point a to b in a direct (albeit CURVED, ASSUMING the earth is round) line
+
+    // delta lat / lan (converted to radian)
+    float dlat = (lat2 - lat1) * M_PI / 180.0;
+    float dlon = (lon2 - lon1) * M_PI / 180.0;
+
+    // lats also converted to radian
+    lat1 = lat1 * M_PI / 180.0;
+    lat2 = lat2 * M_PI / 180.0;
+
+    float a = sin(dlat / 2) * sin(dlat / 2) + cos(lat1) * cos(lat2) * sin(dlon / 2) * sin(dlon / 2);
+
+    float c = 2 * atan2(sqrt(a), sqrt(1 - a));
+
+    return R * c;
+}
+
+PreparedPoints preparePoints(const std::vector<float>& lat, const std::vector<float>& lon, Precision precision)
+{
+    PreparedPoints p;
+    p.precision = precision;
+    size_t n = lat.size();
+
+    if (precision == Precision::Single) {
+        p.xf.resize(n);
+        p.yf.resize(n);
+        p.zf.resize(n);
+    } else {
+        p.xd.resize(n);
+        p.yd.resize(n);
+        p.zd.resize(n);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        // always computed in double, the float version is only rounded at the end
+        double la = lat[i] * M_PI / 180.0;
+        double lo = lon[i] * M_PI / 180.0;
+        double x = std::cos(la) * std::cos(lo);
+        double y = std::cos(la) * std::sin(lo);
+        double z = std::sin(la);
+
+        if (precision == Precision::Single) {
+            p.xf[i] = x;
+            p.yf[i] = y;
+            p.zf[i] = z;
+        } else {
+            p.xd[i] = x;
+            p.yd[i] = y;
+            p.zd[i] = z;
+        }
+    }
+    return p;
+}
+
+// asin for x in [0, 1] (cephes asinf), accurate to about 1 float ulp.
+// above 0.5 it uses asin(x) = pi/2 - 2 * asin(sqrt((1 - x) / 2)) so the polynomial stays in range
+static inline float asinPositive(float x)
+{
+    bool big = x > 0.5f;
+    float z = big ? 0.5f * (1.0f - x) : x * x;
+    float s = big ? std::sqrt(z) : x;
+    float p = (((4.2163199048E-2f * z + 2.4181311049E-2f) * z + 4.5470025998E-2f) * z + 7.4953002686E-2f) * z + 1.6666752422E-1f;
+    float r = s + s * z * p;
+    return big ? 1.5707963267948966f - 2.0f * r : r;
+}
+
+static inline float chordToKm(float chord)
+{
+    // rounding can push two antipodal points just over 2
+    return 2.0f * R * asinPositive(std::min(chord * 0.5f, 1.0f));
+}
+
+#if defined(__AVX512F__)
+static size_t haversineBatchSimd(float px, float py, float pz, const float* xs, const float* ys, const float* zs, float* out, size_t n)
+{
+    const __m512 vx = _mm512_set1_ps(px), vy = _mm512_set1_ps(py), vz = _mm512_set1_ps(pz);
+    const __m512 half = _mm512_set1_ps(0.5f), one = _mm512_set1_ps(1.0f), two = _mm512_set1_ps(2.0f);
+    const __m512 half_pi = _mm512_set1_ps(1.5707963267948966f), two_r = _mm512_set1_ps(2.0f * R);
+    const __m512 c0 = _mm512_set1_ps(4.2163199048E-2f), c1 = _mm512_set1_ps(2.4181311049E-2f), c2 = _mm512_set1_ps(4.5470025998E-2f);
+    const __m512 c3 = _mm512_set1_ps(7.4953002686E-2f), c4 = _mm512_set1_ps(1.6666752422E-1f);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 dx = _mm512_sub_ps(_mm512_loadu_ps(xs + i), vx);
+        __m512 dy = _mm512_sub_ps(_mm512_loadu_ps(ys + i), vy);
+        __m512 dz = _mm512_sub_ps(_mm512_loadu_ps(zs + i), vz);
+        __m512 sq = _mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx)));
+        __m512 x = _mm512_min_ps(_mm512_mul_ps(_mm512_sqrt_ps(sq), half), one);
+
+        // same branches as asinPositive, blended per lane
+        __mmask16 big = _mm512_cmp_ps_mask(x, half, _CMP_GT_OQ);
+        __m512 z = _mm512_mask_blend_ps(big, _mm512_mul_ps(x, x), _mm512_mul_ps(half, _mm512_sub_ps(one, x)));
+        __m512 s = _mm512_mask_blend_ps(big, x, _mm512_sqrt_ps(z));
+        __m512 p = _mm512_fmadd_ps(c0, z, c1);
+        p = _mm512_fmadd_ps(p, z, c2);
+        p = _mm512_fmadd_ps(p, z, c3);
+        p = _mm512_fmadd_ps(p, z, c4);
+        __m512 r = _mm512_fmadd_ps(_mm512_mul_ps(s, z), p, s);
+        r = _mm512_mask_blend_ps(big, r, _mm512_fnmadd_ps(two, r, half_pi));
+
+        _mm512_storeu_ps(out + i, _mm512_mul_ps(two_r, r));
+    }
+    return i;
+}
+#elif defined(__AVX2__) && defined(__FMA__)
+static size_t haversineBatchSimd(float px, float py, float pz, const float* xs, const float* ys, const float* zs, float* out, size_t n)
+{
+    const __m256 vx = _mm256_set1_ps(px), vy = _mm256_set1_ps(py), vz = _mm256_set1_ps(pz);
+    const __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f);
+    const __m256 half_pi = _mm256_set1_ps(1.5707963267948966f), two_r = _mm256_set1_ps(2.0f * R);
+    const __m256 c0 = _mm256_set1_ps(4.2163199048E-2f), c1 = _mm256_set1_ps(2.4181311049E-2f), c2 = _mm256_set1_ps(4.5470025998E-2f);
+    const __m256 c3 = _mm256_set1_ps(7.4953002686E-2f), c4 = _mm256_set1_ps(1.6666752422E-1f);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + i), vx);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + i), vy);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(zs + i), vz);
+        __m256 sq = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+        __m256 x = _mm256_min_ps(_mm256_mul_ps(_mm256_sqrt_ps(sq), half), one);
+
+        // same branches as asinPositive, blended per lane
+        __m256 big = _mm256_cmp_ps(x, half, _CMP_GT_OQ);
+        __m256 z = _mm256_blendv_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(half, _mm256_sub_ps(one, x)), big);
+        __m256 s = _mm256_blendv_ps(x, _mm256_sqrt_ps(z), big);
+        __m256 p = _mm256_fmadd_ps(c0, z, c1);
+        p = _mm256_fmadd_ps(p, z, c2);
+        p = _mm256_fmadd_ps(p, z, c3);
+        p = _mm256_fmadd_ps(p, z, c4);
+        __m256 r = _mm256_fmadd_ps(_mm256_mul_ps(s, z), p, s);
+        r = _mm256_blendv_ps(r, _mm256_fnmadd_ps(two, r, half_pi), big);
+
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(two_r, r));
+    }
+    return i;
+}
+#else
+static size_t haversineBatchSimd(float, float, float, const float*, const float*, const float*, float*, size_t)
+{
+    return 0;
+}
+#endif
+
+const char* haversineKernelName()
+{
+#if defined(__AVX512F__)
+    return "avx512";
+#elif defined(__AVX2__) && defined(__FMA__)
+    return "avx2";
+#else
+    return "scalar";
+#endif
+}
+
+void haversineBatch(const PreparedPoints& from, size_t index, const PreparedPoints& to, float* out)
+{
+    size_t n = to.size();
+
+    if (to.precision == Precision::Single) {
+        float px = from.xf[index], py = from.yf[index], pz = from.zf[index];
+
+        // simd handles whole vectors, the tail (or everything on a scalar build) is done here
+        size_t done = haversineBatchSimd(px, py, pz, to.xf.data(), to.yf.data(), to.zf.data(), out, n);
+        for (size_t i = done; i < n; ++i) {
+            float dx = to.xf[i] - px, dy = to.yf[i] - py, dz = to.zf[i] - pz;
+            out[i] = chordToKm(std::sqrt(dx * dx + dy * dy + dz * dz));
+        }
+    } else {
+        double px = from.xd[index], py = from.yd[index], pz = from.zd[index];
+
+        // double mode trades speed for libm's asin, the chord part still vectorizes
+        for (size_t i = 0; i < n; ++i) {
+            double dx = to.xd[i] - px, dy = to.yd[i] - py, dz = to.zd[i] - pz;
+            double half_chord = std::min(std::sqrt(dx * dx + dy * dy + dz * dz) * 0.5, 1.0);
+            out[i] = 2.0 * R * std::asin(half_chord);
+        }
+    }
+}
+
+DistanceMatrix buildDistanceMatrix(const std::vector<Employee>& employees, const std::vector<Target>& targets, Precision precision)
+{
+    DistanceMatrix m;
+    m.num_employees = employees.size();
+    m.num_targets = targets.size();
+
+    // lat/lon copied into contiguous arrays once, instead of dragging whole structs through the loop
+    m.emp_lat.reserve(m.num_employees);
+    m.emp_lon.reserve(m.num_employees);
+    for (const auto& emp : employees) {
+        m.emp_lat.push_back(emp.lat);
+        m.emp_lon.push_back(emp.lon);
+    }
+    m.tar_lat.reserve(m.num_targets);
+    m.tar_lon.reserve(m.num_targets);
+    for (const auto& tar : targets) {
+        m.tar_lat.push_back(tar.lat);
+        m.tar_lon.push_back(tar.lon);
+    }
+
+    fillDistanceMatrix(m, precision);
+    return m;
+}
+
+void fillDistanceMatrix(DistanceMatrix& m, Precision precision)
+{
+    TRACE_SCOPE("distance matrix");
+    PreparedPoints emp_points = preparePoints(m.emp_lat, m.emp_lon, precision);
+    PreparedPoints tar_points = preparePoints(m.tar_lat, m.tar_lon, precision);
+
+    // one target against all employees at a time, the rows are contiguous in the matrix
+    m.mapped = nullptr;
+    m.mapping.reset();
+    m.dist.resize((size_t)m.num_targets * m.num_employees);
+    for (int t = 0; t < m.num_targets; ++t) {
+        haversineBatch(tar_points, t, emp_points, &m.dist[(size_t)t * m.num_employees]);
+    }
+}
+
+DistanceMatrix subMatrix(const DistanceMatrix& distances, const std::vector<int>& emp_index, const std::vector<int>& tar_index)
+{
+    DistanceMatrix sub;
+    sub.num_employees = emp_index.size();
+    sub.num_targets = tar_index.size();
+    for (int e : emp_index) {
+        sub.emp_lat.push_back(distances.emp_lat[e]);
+        sub.emp_lon.push_back(distances.emp_lon[e]);
+    }
+    sub.dist.resize((size_t)sub.num_targets * sub.num_employees);
+    for (int j = 0; j < sub.num_targets; ++j) {
+        int t = tar_index[j];
+        sub.tar_lat.push_back(distances.tar_lat[t]);
+        sub.tar_lon.push_back(distances.tar_lon[t]);
+        for (int i = 0; i < sub.num_employees; ++i) {
+            sub.dist[(size_t)j * sub.num_employees + i] = distances.at(emp_index[i], t);
+        }
+    }
+    return sub;
+}
@@ -0,0 +1,50 @@
+#ifndef HAVERSINE_H
+#define HAVERSINE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "assignment.h"
+
+// earth's radius
+const float R = 6371.0;
+
+// precision the batch kernel computes in, the matrix itself always stores floats (km)
+enum class Precision {
+    Single,
+    Double,
+};
+
+// haversine formula, one pair at a time
+// distance = earth's radius * c
+float haversine(float lat1, float lon1, float lat2, float lon2);
+
+// points converted once into unit vectors on the sphere (radians, cos(lat) etc. are all folded in).
+// the distance between two of them is then 2R * asin(|p1 - p2| / 2), which is the haversine formula
+// without any trig per pair. only the arrays of the chosen precision are filled
+struct PreparedPoints {
+    Precision precision = Precision::Single;
+    std::vector<float> xf, yf, zf;
+    std::vector<double> xd, yd, zd;
+
+    size_t size() const { return precision == Precision::Single ? xf.size() : xd.size(); }
+};
+
+PreparedPoints preparePoints(const std::vector<float>& lat, const std::vector<float>& lon, Precision precision);
+
+// distances in km from point `index` of `from` to every point of `to` (same precision), written to out[0..to.size())
+void haversineBatch(const PreparedPoints& from, size_t index, const PreparedPoints& to, float* out);
+
+// "avx512", "avx2" or "scalar", depending on what the kernel was compiled for
+const char* haversineKernelName();
+
+DistanceMatrix buildDistanceMatrix(const std::vector<Employee>& employees, const std::vector<Target>& targets, Precision precision = Precision::Single);
+
+// (re)computes m.dist from the coordinates already in m (num_employees/num_targets and the lat/lon arrays),
+// keeping the buffer when the size didn't grow
+void fillDistanceMatrix(DistanceMatrix& m, Precision precision = Precision::Single);
+
+// the distances between some of the employees and targets (by index), copied into a matrix of their own
+DistanceMatrix subMatrix(const DistanceMatrix& distances, const std::vector<int>& emp_index, const std::vector<int>& tar_index);
+
+#endif
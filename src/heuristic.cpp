@@ -0,0 +1,350 @@
+#include "heuristic.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "candidates.h"
+#include "haversine.h"
+#include "solverlog.h"
+#include "splitmix.h"
+#include "trace.h"
+
+LocalSearch::LocalSearch(const DistanceMatrix& distances, const std::vector<Target>& targets, const RelationGraph& relations,
+    bool use_relations, int extra_neighbours)
+    : distances(distances), targets(targets), relations(relations),
+      use_relations(use_relations && !relations.empty() && !relations.conflict_graph.start.empty()),
+      target_of(distances.num_employees, -1), staff(targets.size())
+{
+    // the nearest employees of every target, a few more than it needs
+    PreparedPoints emp_points = preparePoints(distances.emp_lat, distances.emp_lon, Precision::Single);
+    PreparedPoints tar_points = preparePoints(distances.tar_lat, distances.tar_lon, Precision::Single);
+    KdTree tree(emp_points);
+    near.resize(targets.size());
+    for (size_t j = 0; j < targets.size(); ++j) {
+        int k = std::min<int>(distances.num_employees, 2 * targets[j].req_employees + extra_neighbours);
+        tree.nearest(tar_points.xf[j], tar_points.yf[j], tar_points.zf[j], k, near[j]);
+    }
+}
+
+void LocalSearch::place(int employee, int target)
+{
+    target_of[employee] = target;
+    staff[target].push_back(employee);
+}
+
+void LocalSearch::unplace(int employee)
+{
+    std::vector<int>& s = staff[target_of[employee]];
+    s.erase(std::find(s.begin(), s.end(), employee));
+    target_of[employee] = -1;
+}
+
+void LocalSearch::load(const std::vector<int>& assignment)
+{
+    for (auto& s : staff) {
+        s.clear();
+    }
+    std::fill(target_of.begin(), target_of.end(), -1);
+    for (size_t e = 0; e < assignment.size(); ++e) {
+        if (assignment[e] >= 0) place(e, assignment[e]);
+    }
+}
+
+bool LocalSearch::fill()
+{
+    bool complete = true;
+    for (size_t j = 0; j < targets.size(); ++j) {
+        if ((int)staff[j].size() >= targets[j].req_employees) continue;
+
+        // the nearest free employees first, then anyone free
+        std::vector<int> candidates = near[j];
+        for (int e = 0; e < distances.num_employees; ++e) {
+            if (target_of[e] < 0) candidates.push_back(e);
+        }
+        std::stable_sort(candidates.begin() + near[j].size(), candidates.end(),
+            [&](int a, int b) { return distances.at(a, j) < distances.at(b, j); });
+
+        for (int c : candidates) {
+            if ((int)staff[j].size() >= targets[j].req_employees) break;
+            if (target_of[c] < 0 && !conflictsAt(c, j, -1)) {
+                place(c, j);
+                ++moves;
+            }
+        }
+        if ((int)staff[j].size() < targets[j].req_employees) complete = false;
+    }
+    return complete;
+}
+
+bool LocalSearch::improve()
+{
+    bool improved = false;
+    std::vector<int> candidates;
+    for (size_t t = 0; t < targets.size(); ++t) {
+        // the nearest employees, and friends of the people already there (the friend reward can be worth
+        // more than the km of someone from the other side of the map)
+        candidates = near[t];
+        if (use_relations) {
+            const Adjacency& g = relations.friend_graph;
+            for (int e : staff[t]) {
+                candidates.insert(candidates.end(), g.adj.begin() + g.start[e], g.adj.begin() + g.start[e + 1]);
+            }
+        }
+        for (int c : candidates) {
+            if (target_of[c] == (int)t) continue;
+            int t2 = target_of[c];
+
+            // the employee of t that gains the most from being replaced by / swapped with c
+            int best = -1;
+            double best_delta = -1e-6;
+            for (int e : staff[t]) {
+                double delta = t2 < 0 ? replaceDelta(e, c, t) : swapDelta(e, t, c, t2);
+                if (delta < best_delta) {
+                    best_delta = delta;
+                    best = e;
+                }
+            }
+            if (best < 0) continue;
+
+            unplace(best);
+            if (t2 >= 0) {
+                unplace(c);
+                place(best, t2);
+            }
+            place(c, t);
+            ++moves;
+            improved = true;
+        }
+    }
+    return improved;
+}
+
+bool LocalSearch::conflictsAt(int e, int t, int skip) const
+{
+    if (!use_relations) return false;
+    const Adjacency& g = relations.conflict_graph;
+    for (int k = g.start[e]; k < g.start[e + 1]; ++k) {
+        int other = g.adj[k];
+        if (other != skip && target_of[other] == t) return true;
+    }
+    return false;
+}
+
+int LocalSearch::friendsAt(int e, int t, int skip) const
+{
+    if (!use_relations) return 0;
+    int count = 0;
+    const Adjacency& g = relations.friend_graph;
+    for (int k = g.start[e]; k < g.start[e + 1]; ++k) {
+        int other = g.adj[k];
+        if (other != skip && other != e && target_of[other] == t) ++count;
+    }
+    return count;
+}
+
+double LocalSearch::objective() const
+{
+    double km = 0;
+    int friends = 0;
+    for (int e = 0; e < distances.num_employees; ++e) {
+        if (target_of[e] < 0) continue;
+        km += distances.at(e, target_of[e]);
+        friends += friendsAt(e, target_of[e], -1);
+    }
+    // every pair was counted from both sides
+    return km - FAVOR_COEFFICIENT * friends / 2;
+}
+
+double LocalSearch::replaceDelta(int e, int c, int t) const
+{
+    if (conflictsAt(c, t, e)) return std::numeric_limits<double>::infinity();
+    double km = distances.at(c, t) - distances.at(e, t);
+    int friends = friendsAt(c, t, e) - friendsAt(e, t, -1);
+    return km - FAVOR_COEFFICIENT * friends;
+}
+
+double LocalSearch::swapDelta(int e, int t1, int c, int t2) const
+{
+    if (conflictsAt(e, t2, c) || conflictsAt(c, t1, e)) return std::numeric_limits<double>::infinity();
+    double km = distances.at(e, t2) + distances.at(c, t1) - distances.at(e, t1) - distances.at(c, t2);
+    int friends = friendsAt(e, t2, c) + friendsAt(c, t1, e) - friendsAt(e, t1, -1) - friendsAt(c, t2, -1);
+    return km - FAVOR_COEFFICIENT * friends;
+}
+
+namespace operations_research {
+// the best two free employees of a target, by km minus friend rewards
+struct TargetChoice {
+    int first = -1;
+    int second = -1;
+    double first_cost = 0;
+    double second_cost = 0;
+};
+
+static TargetChoice bestChoices(const LocalSearch& search, const DistanceMatrix& distances, int t)
+{
+    TargetChoice choice;
+    const std::vector<int>& target_of = search.assignment();
+    for (int c : search.neighbours(t)) {
+        if (target_of[c] >= 0 || search.conflictsAt(c, t, -1)) continue;
+        double cost = distances.at(c, t) - FAVOR_COEFFICIENT * search.friendsAt(c, t, -1);
+        if (choice.first < 0 || cost < choice.first_cost) {
+            choice.second = choice.first;
+            choice.second_cost = choice.first_cost;
+            choice.first = c;
+            choice.first_cost = cost;
+        } else if (choice.second < 0 || cost < choice.second_cost) {
+            choice.second = c;
+            choice.second_cost = cost;
+        }
+    }
+    return choice;
+}
+
+// regret construction: every step staffs one place on the target whose best free employee is the most ahead of
+// its second best, so the targets with one obvious candidate get it before someone else takes it. targets that
+// run out of nearby candidates (or aren't reached in time) are left to LocalSearch::fill()
+template <typename OutOfTime>
+static void constructRegret(LocalSearch& search, const DistanceMatrix& distances, const std::vector<Target>& targets, OutOfTime out_of_time)
+{
+    int num_targets = targets.size();
+    std::vector<TargetChoice> choices(num_targets);
+    std::vector<char> open(num_targets, 0);
+    for (int t = 0; t < num_targets; ++t) {
+        if (targets[t].req_employees <= 0) continue;
+        choices[t] = bestChoices(search, distances, t);
+        open[t] = choices[t].first >= 0;
+    }
+
+    // out of time, fill() staffs the rest with the nearest free employees
+    while (!out_of_time()) {
+        int pick = -1;
+        double pick_regret = -1;
+        for (int t = 0; t < num_targets; ++t) {
+            if (!open[t]) continue;
+            // a single candidate left can't wait
+            double regret = choices[t].second < 0 ? std::numeric_limits<double>::infinity()
+                                                  : choices[t].second_cost - choices[t].first_cost;
+            if (regret > pick_regret) {
+                pick_regret = regret;
+                pick = t;
+            }
+        }
+        if (pick < 0) break;
+
+        int employee = choices[pick].first;
+        search.place(employee, pick);
+
+        // the picked target's costs changed (friends/enemies of the employee), the others only if they wanted them
+        for (int t = 0; t < num_targets; ++t) {
+            if (!open[t]) continue;
+            if (t != pick && choices[t].first != employee && choices[t].second != employee) continue;
+            if ((int)search.staffOf(t).size() >= targets[t].req_employees) {
+                open[t] = 0;
+                continue;
+            }
+            choices[t] = bestChoices(search, distances, t);
+            open[t] = choices[t].first >= 0;
+        }
+    }
+}
+
+// local search until nothing gets better (or the time is up)
+template <typename OutOfTime>
+static void descend(LocalSearch& search, OutOfTime out_of_time)
+{
+    for (int pass = 0; pass < 1000 && !out_of_time(); ++pass) {
+        if (!search.improve()) break;
+    }
+}
+
+// a few random moves that don't look at the cost (but keep enemies apart), to get out of a local optimum
+static void perturb(LocalSearch& search, const std::vector<Target>& targets, SplitMix& random)
+{
+    int num_targets = targets.size();
+    int strength = 2 + random.below(4);
+    for (int m = 0; m < strength; ++m) {
+        int t = random.below(num_targets);
+        const std::vector<int>& staff = search.staffOf(t);
+        const std::vector<int>& near = search.neighbours(t);
+        if (staff.empty() || near.empty()) continue;
+
+        int e = staff[random.below(staff.size())];
+        int c = near[random.below(near.size())];
+        int t2 = search.assignment()[c];
+        if (t2 == t) continue;
+
+        if (t2 < 0) {
+            if (search.conflictsAt(c, t, e)) continue;
+            search.unplace(e);
+            search.place(c, t);
+        } else {
+            if (search.conflictsAt(e, t2, c) || search.conflictsAt(c, t, e)) continue;
+            search.unplace(e);
+            search.unplace(c);
+            search.place(e, t2);
+            search.place(c, t);
+        }
+    }
+}
+
+AssignmentResult assignEmployeesHeuristic(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets,
+    const RelationGraph& relations, const HeuristicOptions& heuristic)
+{
+    AssignmentResult result;
+    result.solver = "heuristic";
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    // the optional wall clock cap covers the construction and every descent, not just the rounds
+    auto out_of_time = [&]() { return heuristic.time_limit_seconds > 0 && elapsed() >= heuristic.time_limit_seconds; };
+
+    LocalSearch search(distances, targets, relations, true);
+    bool complete;
+    {
+        TRACE_SCOPE("regret construction");
+        constructRegret(search, distances, targets, out_of_time);
+        complete = search.fill();
+    }
+    if (!complete) {
+        solverLog() << "some targets couldn't be staffed..." << std::endl;
+    }
+
+    std::vector<int> best;
+    double best_objective;
+    double first_objective;
+    int rounds = 0;
+    {
+        TRACE_SCOPE("local search");
+        descend(search, out_of_time);
+        best = search.assignment();
+        best_objective = first_objective = search.objective();
+
+        SplitMix random(heuristic.seed);
+        bool stop = targets.empty();
+        for (; !stop && rounds < heuristic.max_rounds; ++rounds) {
+            if (out_of_time()) break;
+
+            perturb(search, targets, random);
+            descend(search, out_of_time);
+            double objective = search.objective();
+            if (objective < best_objective - 1e-6) {
+                best = search.assignment();
+                best_objective = objective;
+            } else {
+                search.load(best);
+            }
+        }
+    }
+
+    for (int i = 0; i < distances.num_employees; ++i) {
+        if (best[i] >= 0) result.add(i, best[i], distances.at(i, best[i]));
+    }
+    // no bound to compare against, so never proven optimal
+    result.status = complete ? SolveStatus::Feasible : SolveStatus::NotSolved;
+    result.stats.nodes = rounds;
+    result.stats.wall_seconds = elapsed();
+    solverLog() << "heuristic plan after " << rounds << " round(s): objective " << first_objective << " -> " << best_objective
+                << " (" << search.numMoves() << " move(s), " << result.stats.wall_seconds * 1000.0 << " ms)" << std::endl;
+    return result;
+}
+}
@@ -0,0 +1,80 @@
+#ifndef HEURISTIC_H
+#define HEURISTIC_H
+
+#include <cstdint>
+#include <vector>
+
+#include "assignment.h"
+
+struct HeuristicOptions {
+    // drives the perturbations after the first local optimum, the same seed gives the same plan
+    uint64_t seed = 1;
+    // perturb + local search rounds after the first local optimum, what stops the search by default
+    int max_rounds = 200;
+    // optional wall clock cap on the whole heuristic, 0 = none. when it's what stops the search the plan
+    // depends on the speed of the machine, so the seed alone doesn't determine it anymore
+    double time_limit_seconds = 0;
+};
+
+/* An assignment that is improved one move at a time, with the same objective as the enemies and friends model
+(km, minus FAVOR_COEFFICIENT for every pair of friends on the same target, enemies never together) or just km
+when relations aren't used. Every target only looks at its nearest employees: a free one replaces an assigned
+employee when that's cheaper, an employee assigned elsewhere swaps places when the two of them end up with less
+together. Used for the heuristic below and to repair the borders of a decomposed solve (decompose.h). */
+class LocalSearch {
+public:
+    LocalSearch(const DistanceMatrix& distances, const std::vector<Target>& targets, const RelationGraph& relations,
+        bool use_relations, int extra_neighbours = 16);
+
+    void place(int employee, int target);
+    void unplace(int employee);
+    // starts over from target_of (-1 = not assigned)
+    void load(const std::vector<int>& target_of);
+
+    // staffs the targets that are short with the nearest free employees, false if some target couldn't get enough
+    bool fill();
+    // one pass over every target, returns whether anything got better
+    bool improve();
+
+    // an enemy of e on target t (other than skip)
+    bool conflictsAt(int e, int t, int skip) const;
+    // friends of e on target t (other than skip)
+    int friendsAt(int e, int t, int skip) const;
+    // km minus the friend rewards of the current assignment
+    double objective() const;
+
+    // nearest employees of target t, closest first
+    const std::vector<int>& neighbours(int t) const { return near[t]; }
+    const std::vector<int>& staffOf(int t) const { return staff[t]; }
+    const std::vector<int>& assignment() const { return target_of; }
+    int numMoves() const { return moves; }
+
+private:
+    // change of the objective when free employee c takes the place of e on target t,
+    // infinity when c can't work with someone there
+    double replaceDelta(int e, int c, int t) const;
+    // e on t1 and c on t2 trade places
+    double swapDelta(int e, int t1, int c, int t2) const;
+
+    const DistanceMatrix& distances;
+    const std::vector<Target>& targets;
+    const RelationGraph& relations;
+    bool use_relations;
+
+    std::vector<int> target_of;
+    std::vector<std::vector<int>> staff;
+    std::vector<std::vector<int>> near;
+    int moves = 0;
+};
+
+namespace operations_research {
+    /* A plan in milliseconds instead of a MIP solve: a regret greedy (the target that would lose the most by
+    not getting its best free employee now goes first) that keeps enemies apart and pulls friends together,
+    then local search, then heuristic.max_rounds rounds of random perturbation + local search keeping the best
+    plan (cut short by heuristic.time_limit_seconds if set). Relations are only used when given (the friends mode).
+    The result is also a good starting point for the exact models, see SolverOptions::hint. */
+    AssignmentResult assignEmployeesHeuristic(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets,
+        const RelationGraph& relations, const HeuristicOptions& heuristic = HeuristicOptions());
+}
+
+#endif
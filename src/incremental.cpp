@@ -0,0 +1,311 @@
+#include "incremental.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "ortools/linear_solver/linear_solver.h"
+
+namespace operations_research {
+IncrementalAssigner::IncrementalAssigner(const DistanceMatrix& distances, const std::vector<Employee>& employees, const std::vector<Target>& targets,
+    const RelationGraph& relations, const SolverOptions& options, bool use_relations)
+    : solver(new MPSolver("IncrementalAssignment", MPSolver::SCIP_MIXED_INTEGER_PROGRAMMING)), options(options), use_relations(use_relations),
+      employee_list(employees), target_list(targets),
+      employee_active(employees.size(), 1), target_active(targets.size(), 1), assigned(employees.size(), -1)
+{
+    int num_employees = employees.size();
+    int num_targets = targets.size();
+
+    for (int i = 0; i < num_employees; ++i) {
+        id_to_index[employees[i].id] = i;
+    }
+    for (int j = 0; j < num_targets; ++j) {
+        tar_num_to_index[targets[j].target_number] = j;
+    }
+
+    cost.assign(num_employees, std::vector<float>(num_targets));
+    for (int i = 0; i < num_employees; ++i) {
+        for (int j = 0; j < num_targets; ++j) {
+            cost[i][j] = distances.at(i, j);
+        }
+    }
+
+    // constraint: each employee is assigned at most once
+    // constraint: each target has a required number of people that need to be on location
+    // (rows first, the variables add themselves to them)
+    for (int i = 0; i < num_employees; ++i) {
+        employee_rows.push_back(solver->MakeRowConstraint(0, 1));
+    }
+    for (int j = 0; j < num_targets; ++j) {
+        target_rows.push_back(solver->MakeRowConstraint(targets[j].req_employees, targets[j].req_employees));
+    }
+
+    x.assign(num_employees, std::vector<MPVariable*>(num_targets, nullptr));
+    for (int i = 0; i < num_employees; ++i) {
+        for (int j = 0; j < num_targets; ++j) {
+            x[i][j] = makeAssignmentVar(i, j);
+        }
+    }
+
+    if (use_relations) {
+        // constraint: some employees hate one another, don't pair them
+        for (const auto& [first_employee, second_employee] : relations.conflicts) {
+            addConflict(first_employee, second_employee);
+        }
+
+        // friends are rewarded for ending up on the same location
+        for (const auto& [main_character_id, friend_id] : relations.friends) {
+            addFriends(main_character_id, friend_id);
+        }
+    }
+
+    solver->MutableObjective()->SetMinimization();
+}
+
+IncrementalAssigner::~IncrementalAssigner() = default;
+
+MPVariable* IncrementalAssigner::makeAssignmentVar(int employee_index, int target_index)
+{
+    MPVariable* var = solver->MakeIntVar(0, 1, "x_" + std::to_string(employee_index) + "_" + std::to_string(target_index));
+    employee_rows[employee_index]->SetCoefficient(var, 1);
+    target_rows[target_index]->SetCoefficient(var, 1);
+    solver->MutableObjective()->SetCoefficient(var, cost[employee_index][target_index]);
+    return var;
+}
+
+void IncrementalAssigner::addConflictRow(int first_employee, int second_employee, int target_index)
+{
+    MPConstraint* row = solver->MakeRowConstraint(-MPSolver::infinity(), 1);
+    row->SetCoefficient(x[first_employee][target_index], 1);
+    row->SetCoefficient(x[second_employee][target_index], 1);
+}
+
+void IncrementalAssigner::addFriendRows(int first_employee, int second_employee, int target_index)
+{
+    const MPVariable* x1 = x[first_employee][target_index];
+    const MPVariable* x2 = x[second_employee][target_index];
+
+    // y = 1 if both x1 and x2 are assigned to this target
+    MPVariable* y = solver->MakeIntVar(0, 1, "y_" + std::to_string(first_employee) + "_" + std::to_string(second_employee) + "_" + std::to_string(target_index));
+
+    // y <= x1
+    MPConstraint* c1 = solver->MakeRowConstraint(-MPSolver::infinity(), 0);
+    c1->SetCoefficient(y, 1);
+    c1->SetCoefficient(x1, -1);
+
+    // y <= x2
+    MPConstraint* c2 = solver->MakeRowConstraint(-MPSolver::infinity(), 0);
+    c2->SetCoefficient(y, 1);
+    c2->SetCoefficient(x2, -1);
+
+    // y >= x1 + x2 - 1  -->  y - x1 - x2 >= -1
+    MPConstraint* c3 = solver->MakeRowConstraint(-1, MPSolver::infinity());
+    c3->SetCoefficient(y, 1);
+    c3->SetCoefficient(x1, -1);
+    c3->SetCoefficient(x2, -1);
+
+    // reward in objective
+    solver->MutableObjective()->SetCoefficient(y, -FAVOR_COEFFICIENT);
+}
+
+void IncrementalAssigner::addConflict(int first_employee, int second_employee)
+{
+    conflict_pairs.emplace_back(first_employee, second_employee);
+    for (size_t j = 0; j < target_list.size(); ++j) {
+        addConflictRow(first_employee, second_employee, j);
+    }
+}
+
+void IncrementalAssigner::addFriends(int first_employee, int second_employee)
+{
+    friend_pairs.emplace_back(first_employee, second_employee);
+    for (size_t j = 0; j < target_list.size(); ++j) {
+        addFriendRows(first_employee, second_employee, j);
+    }
+}
+
+void IncrementalAssigner::removeEmployee(int employee_index)
+{
+    // nothing gets deleted from the model, fixing the row to 0 keeps all of the employee's x at 0
+    employee_active[employee_index] = 0;
+    employee_rows[employee_index]->SetBounds(0, 0);
+}
+
+int IncrementalAssigner::addEmployee(const Employee& employee, const std::vector<float>& distance_row)
+{
+    int i = employee_list.size();
+    employee_list.push_back(employee);
+    employee_active.push_back(1);
+    id_to_index[employee.id] = i;
+    cost.push_back(distance_row);
+    assigned.push_back(-1);
+
+    employee_rows.push_back(solver->MakeRowConstraint(0, 1));
+    x.emplace_back(target_list.size(), nullptr);
+    for (size_t j = 0; j < target_list.size(); ++j) {
+        // removed targets have their row fixed to 0, which keeps these at 0 as well
+        x[i][j] = makeAssignmentVar(i, j);
+    }
+
+    if (!use_relations) return i;
+
+    // match enemies and friends by name, in either direction and only once per pair (like buildRelations)
+    auto lists = [](const std::vector<std::string>& names, const std::string& name) {
+        return std::find(names.begin(), names.end(), name) != names.end();
+    };
+    for (size_t other = 0; other < employee_list.size() - 1; ++other) {
+        const Employee& other_employee = employee_list[other];
+        if (lists(employee.no_pair, other_employee.name) || lists(other_employee.no_pair, employee.name)) {
+            addConflict(i, other);
+        }
+        if (lists(employee.friends, other_employee.name) || lists(other_employee.friends, employee.name)) {
+            addFriends(i, other);
+        }
+    }
+    return i;
+}
+
+void IncrementalAssigner::removeTarget(int target_index)
+{
+    target_active[target_index] = 0;
+    target_rows[target_index]->SetBounds(0, 0);
+}
+
+int IncrementalAssigner::addTarget(const Target& target, const std::vector<float>& distance_column)
+{
+    int j = target_list.size();
+    target_list.push_back(target);
+    target_active.push_back(1);
+    tar_num_to_index[target.target_number] = j;
+
+    target_rows.push_back(solver->MakeRowConstraint(target.req_employees, target.req_employees));
+    for (size_t i = 0; i < employee_list.size(); ++i) {
+        cost[i].push_back(distance_column[i]);
+        x[i].push_back(makeAssignmentVar(i, j));
+    }
+
+    for (const auto& [first, second] : conflict_pairs) {
+        addConflictRow(first, second, j);
+    }
+    for (const auto& [first, second] : friend_pairs) {
+        addFriendRows(first, second, j);
+    }
+    return j;
+}
+
+void IncrementalAssigner::setRequirement(int target_index, int req_employees)
+{
+    target_list[target_index].req_employees = req_employees;
+    if (target_active[target_index]) {
+        target_rows[target_index]->SetBounds(req_employees, req_employees);
+    }
+}
+
+bool IncrementalAssigner::runSolver()
+{
+    // the limits apply to every solve, warm-started re-solves usually finish well within them
+    if (options.time_limit_seconds > 0) {
+        solver->SetTimeLimit(absl::Milliseconds(static_cast<int64_t>(options.time_limit_seconds * 1000)));
+    }
+    MPSolverParameters parameters;
+    if (options.relative_gap > 0) {
+        parameters.SetDoubleParam(MPSolverParameters::RELATIVE_MIP_GAP, options.relative_gap);
+    }
+
+    MPSolver::ResultStatus result_status = solver->Solve(parameters);
+    if (result_status != MPSolver::OPTIMAL && result_status != MPSolver::FEASIBLE) {
+        return false;
+    }
+    last_optimal = result_status == MPSolver::OPTIMAL;
+
+    solved_employee_active = employee_active;
+    solved_target_active = target_active;
+    solved_requirements.clear();
+    for (const auto& tar : target_list) {
+        solved_requirements.push_back(tar.req_employees);
+    }
+
+    assigned.assign(employee_list.size(), -1);
+    for (size_t i = 0; i < employee_list.size(); ++i) {
+        for (size_t j = 0; j < target_list.size(); ++j) {
+            if (x[i][j]->solution_value() > 0.5) {
+                assigned[i] = j;
+            }
+        }
+    }
+    return true;
+}
+
+bool IncrementalAssigner::solve()
+{
+    return runSolver();
+}
+
+bool IncrementalAssigner::resolve(AssignmentDelta& delta)
+{
+    std::vector<int> previous = assigned;
+    delta.changes.clear();
+    delta.old_km = totalKm();
+
+    // warm start: the previous assignment, minus whatever can't be kept anymore
+    std::vector<std::pair<const MPVariable*, double>> hint;
+    for (size_t i = 0; i < employee_list.size(); ++i) {
+        for (size_t j = 0; j < target_list.size(); ++j) {
+            bool keep = previous[i] == (int)j && employee_active[i] && target_active[j];
+            hint.emplace_back(x[i][j], keep ? 1.0 : 0.0);
+        }
+    }
+    solver->SetHint(hint);
+
+    if (!runSolver()) {
+        assigned = previous;
+        rollback();
+        return false;
+    }
+
+    for (size_t i = 0; i < employee_list.size(); ++i) {
+        if (assigned[i] != previous[i]) {
+            delta.changes.push_back({(int)i, previous[i], assigned[i]});
+        }
+    }
+    delta.new_km = totalKm();
+    return true;
+}
+
+void IncrementalAssigner::rollback()
+{
+    // employees and targets added since then stay in the model, switched off
+    for (size_t i = 0; i < employee_list.size(); ++i) {
+        employee_active[i] = i < solved_employee_active.size() && solved_employee_active[i];
+        employee_rows[i]->SetBounds(0, employee_active[i] ? 1 : 0);
+    }
+    for (size_t j = 0; j < target_list.size(); ++j) {
+        target_active[j] = j < solved_target_active.size() && solved_target_active[j];
+        if (j < solved_requirements.size()) target_list[j].req_employees = solved_requirements[j];
+        int required = target_active[j] ? target_list[j].req_employees : 0;
+        target_rows[j]->SetBounds(required, required);
+    }
+}
+
+float IncrementalAssigner::totalKm() const
+{
+    float km_sum = 0;
+    for (size_t i = 0; i < assigned.size(); ++i) {
+        if (assigned[i] >= 0) {
+            km_sum += cost[i][assigned[i]];
+        }
+    }
+    return km_sum;
+}
+
+int IncrementalAssigner::employeeIndex(int id) const
+{
+    auto it = id_to_index.find(id);
+    return it == id_to_index.end() ? -1 : it->second;
+}
+
+int IncrementalAssigner::targetIndex(int target_number) const
+{
+    auto it = tar_num_to_index.find(target_number);
+    return it == tar_num_to_index.end() ? -1 : it->second;
+}
+}
@@ -0,0 +1,112 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "assignment.h"
+
+namespace operations_research {
+class MPSolver;
+class MPVariable;
+class MPConstraint;
+
+// what changed between two solves, only employees whose target changed are listed
+struct AssignmentDelta {
+    struct Change {
+        int employee_index;
+        // target indices, -1 = not assigned
+        int old_target;
+        int new_target;
+    };
+    std::vector<Change> changes;
+    float old_km = 0;
+    float new_km = 0;
+};
+
+/* Keeps the enemies and friends MIP (the plain model when there are none) alive between solves.
+Roster changes only touch the affected bounds/rows of the existing model, and every re-solve gets the
+previous assignment as a hint to warm-start from. Employee and target indices stay stable: removed ones
+are switched off, added ones are appended. Without use_relations (the shortest mode) there are no conflict
+rows or friend rewards, not even for employees added later. */
+class IncrementalAssigner {
+public:
+    IncrementalAssigner(const DistanceMatrix& distances, const std::vector<Employee>& employees, const std::vector<Target>& targets,
+        const RelationGraph& relations, const SolverOptions& options = SolverOptions(), bool use_relations = true);
+    ~IncrementalAssigner();
+
+    // first (cold) solve, false if no solution was found. with a time limit / gap in the options
+    // a solve can stop early, optimal() tells whether the last one was proven optimal
+    bool solve();
+
+    void removeEmployee(int employee_index);
+    // distance_row[t] = distance to target t (all targets, including removed ones). the no_pair/friends
+    // names of the new employee are matched against the current employees. returns the new index
+    int addEmployee(const Employee& employee, const std::vector<float>& distance_row);
+
+    void removeTarget(int target_index);
+    // distance_column[e] = distance from employee e (all employees, including removed ones)
+    int addTarget(const Target& target, const std::vector<float>& distance_column);
+
+    void setRequirement(int target_index, int req_employees);
+
+    // warm-started re-solve after some edits, delta gets what changed compared to the last solve.
+    // false if there's no solution, then the edits are undone: removed employees/targets are back,
+    // requirements are what they were and added ones are switched off
+    bool resolve(AssignmentDelta& delta);
+
+    // employee index -> target index (-1 = not assigned) of the last successful solve
+    const std::vector<int>& assignment() const { return assigned; }
+    float totalKm() const;
+    float distance(int employee_index, int target_index) const { return cost[employee_index][target_index]; }
+    bool optimal() const { return last_optimal; }
+
+    const std::vector<Employee>& employees() const { return employee_list; }
+    const std::vector<Target>& targets() const { return target_list; }
+    int employeeIndex(int id) const;
+    int targetIndex(int target_number) const;
+
+private:
+    MPVariable* makeAssignmentVar(int employee_index, int target_index);
+    void addConflict(int first_employee, int second_employee);
+    void addFriends(int first_employee, int second_employee);
+    void addConflictRow(int first_employee, int second_employee, int target_index);
+    void addFriendRows(int first_employee, int second_employee, int target_index);
+    bool runSolver();
+    // back to the bounds of the last successful solve
+    void rollback();
+
+    std::unique_ptr<MPSolver> solver;
+    SolverOptions options;
+    bool use_relations;
+    bool last_optimal = false;
+
+    std::vector<Employee> employee_list;
+    std::vector<Target> target_list;
+    std::vector<char> employee_active;
+    std::vector<char> target_active;
+
+    // cost[e][t] in km, x[e][t] = 1 if employee e is assigned to target t
+    std::vector<std::vector<float>> cost;
+    std::vector<std::vector<MPVariable*>> x;
+    std::vector<MPConstraint*> employee_rows;
+    std::vector<MPConstraint*> target_rows;
+
+    // employee index pairs, needed again when a target is added
+    std::vector<std::pair<int, int>> conflict_pairs;
+    std::vector<std::pair<int, int>> friend_pairs;
+
+    std::unordered_map<int, int> id_to_index;
+    std::unordered_map<int, int> tar_num_to_index;
+
+    std::vector<int> assigned;
+    // what was active and required at the last successful solve, for rollback()
+    std::vector<char> solved_employee_active;
+    std::vector<char> solved_target_active;
+    std::vector<int> solved_requirements;
+};
+}
+
+#endif
@@ -1,21 +1,35 @@
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <sstream>
 #include <vector>
 #include <string>
-#include <chrono>
-#include <thread>
-#include <cmath>
 #include <cstdlib>
 
-#include <cpr/cpr.h>
 #include <nlohmann/json.hpp>
+#include "addressindex.h"
 #include "assignment.h"
+#include "decompose.h"
+#include "geocache.h"
+#include "geocoder.h"
+#include "haversine.h"
+#include "heuristic.h"
+#include "incremental.h"
+#include "matrixstore.h"
+#include "relations.h"
+#include "result.h"
+#include "roadgraph.h"
+#include "rosterio.h"
+#include "scenario.h"
+#include "server.h"
+#include "solverlog.h"
+#include "trace.h"
+#include "vrp.h"
 
 using json = nlohmann::json;
 
-// earth's radius
-const float R = 6371.0;
-
 json loadJsonFile(const std::string& path) 
 {
     std::ifstream file(path);
@@ -29,247 +43,656 @@ json loadJsonFile(const std::string& path)
     return j;
 }
 
-cpr::Response forwardGeolocate(std::string query, const char* apiKey)
+// make an Employee object from one entry of the employee json
+Employee parseEmployee(const json& item)
 {
-    // example api req: https://us1.locationiq.com/v1/search?key=YOUR_API_KEY&q=Statue%20of%20Liberty,%20New%20York&format=json
-
-    // TODO: make sure the query isn't ambiguous (can return multiple objects)
-    // consider using country, postal code as well.
-    cpr::Response r = cpr::Get(
-        cpr::Url{"https://eu1.locationiq.com/v1/search"},
-        cpr::Parameters{
-            {"key", apiKey}, 
-            {"q", query},
-            {"format", "json"}
-        });
-    return r;
+    int id = item["id"];
+    std::string name = item["name"];
+    std::string address = item["address"];
+    std::string city = item["city"];
+
+    std::vector<std::string> no_pair;        
+    // get the no-pairs from json if there are any, should be a list in the json file for the biggest freak 
+    if (item.contains("no_pair") && item["no_pair"].is_array()) {
+        no_pair = item["no_pair"].get<std::vector<std::string>>();
+    } else {
+        no_pair = {}; 
+    }
+
+    std::vector<std::string> friends; 
+    // same for friends (or people who'd prefer to work together)
+    if (item.contains("friends") && item["friends"].is_array()) {
+        friends = item["friends"].get<std::vector<std::string>>();
+    } else {
+        friends = {}; 
+    }
+
+    return Employee{id, name, address, city, no_pair, friends};
 }
 
-// haversine formula
-// distance = earth's radius * c
-float haversine(float lat1, float lon1, float lat2, float lon2) 
+Target parseTarget(const json& item)
 {
-    // this does not take actual roads into account
-    // it calculates the distance from point a to b in a direct (albeit CURVED, ASSUMING the earth is round) line
-     
-    // delta lat / lan (converted to radian)
-    float dlat = (lat2 - lat1) * M_PI / 180.0;
-    float dlon = (lon2 - lon1) * M_PI / 180.0;
+    int target_number = item["target_number"];
+    std::string address = item["address"];
+    std::string city = item["city"];
+    std::string country = item["country"];
+    int req_emp = item["req_employees"];
+
+    Target tar{target_number, address, city, country, req_emp};
+    // optional time slot, only used by the roster mode
+    tar.day = item.value("day", "");
+    tar.shift = item.value("shift", "");
+    return tar;
+}
 
-    // lats also converted to radian
-    lat1 = lat1 * M_PI / 180.0;
-    lat2 = lat2 * M_PI / 180.0;
+// local address extract (--address-index), empty unless loaded
+static AddressIndex address_index;
 
-    float a = sin(dlat / 2) * sin(dlat / 2) + cos(lat1) * cos(lat2) * sin(dlon / 2) * sin(dlon / 2);
+// fills in lat/lon of every employee and target, from the geocache or the local address index where possible
+// and through the api otherwise. the index is cheap enough that its results aren't cached.
+// known addresses are read from the cache, only new (or moved) ones go through the api and get saved to it
+void geolocate(std::vector<Employee>& employees, std::vector<Target>& targets, const char* apiKey, GeoCache& geocache)
+{
+    // cache misses of both targets and employees end up in one batch of requests,
+    // pending[i] says where the result of jobs[i] has to go
+    struct PendingLocation {
+        std::string label;
+        std::string owner;
+        std::string cache_key;
+        float* lat;
+        float* lon;
+        // the address index only found it by nearest number or a similar street name, used if the api fails
+        bool approximate = false;
+        float approximate_lat = 0;
+        float approximate_lon = 0;
+    };
+    std::vector<GeocodeJob> jobs;
+    std::vector<PendingLocation> pending;
+
+    // a roster repeats the same target on several days, those only need one request
+    std::unordered_map<std::string, size_t> queued_targets;
+    std::vector<std::pair<Target*, size_t>> repeated_targets;
+
+    int offline_found = 0;
+    int offline_approximate = 0;
+    // an exact match (street or postcode + number) replaces the api, an approximate one is only kept as a fallback
+    auto lookupOffline = [&](const std::string& city, const std::string& address, PendingLocation& loc) {
+        float lat, lon;
+        AddressMatch match = address_index.lookup(city, address, lat, lon);
+        if (match == AddressMatch::Exact || match == AddressMatch::Postcode) {
+            *loc.lat = lat;
+            *loc.lon = lon;
+            ++offline_found;
+            return true;
+        }
+        if (match != AddressMatch::None) {
+            loc.approximate = true;
+            loc.approximate_lat = lat;
+            loc.approximate_lon = lon;
+            ++offline_approximate;
+        }
+        return false;
+    };
 
-    float c = 2 * atan2(sqrt(a), sqrt(1 - a));
+    for (auto& tar : targets) {
+        std::string owner = "tar:" + std::to_string(tar.target_number);
+        std::string cache_key = GeoCache::normalizeKey(tar.city, tar.address, tar.country);
+        if (geocache.lookup(owner, cache_key, tar.lat, tar.lon)) continue;
+        PendingLocation loc{"tar#: " + std::to_string(tar.target_number), owner, cache_key, &tar.lat, &tar.lon};
+        if (queued_targets.count(cache_key)) {
+            repeated_targets.emplace_back(&tar, queued_targets[cache_key]);
+            continue;
+        }
+        if (lookupOffline(tar.city, tar.address, loc)) continue;
+        queued_targets[cache_key] = jobs.size();
 
-    return R * c;
-}
+        GeocodeJob job;
+        job.query = tar.city + ", " + tar.address + ", " + tar.country;
+        jobs.push_back(job);
+        pending.push_back(std::move(loc));
+    }
 
-int main(int argc, char** argv) 
-{
-    // parse the address data from the json file
-    // TODO: gain access to the roster/planning (hopefully as json) on ecologieconnect.nl
-    // this could be a daily json with the roster of available people
+    for (auto& emp : employees) {
+        // TODO: this assumes every employee lives in the netherlands which might not be the case
+        std::string owner = "emp:" + std::to_string(emp.id);
+        std::string cache_key = GeoCache::normalizeKey(emp.city, emp.address, "Netherlands");
+        if (geocache.lookup(owner, cache_key, emp.lat, emp.lon)) continue;
+        PendingLocation loc{"name: " + emp.name, owner, cache_key, &emp.lat, &emp.lon};
+        if (lookupOffline(emp.city, emp.address, loc)) continue;
+
+        GeocodeJob job;
+        job.query = emp.city + ", " + emp.address + ", Netherlands";
+        jobs.push_back(job);
+        pending.push_back(std::move(loc));
+    }
 
-    // I/O employees + targets data
-    json j = loadJsonFile("../addresstest.json");  
-    json jt = loadJsonFile("../targettest.json");    
+    if (!address_index.empty()) {
+        std::cout << "address index: " << offline_found << " found offline, " << offline_approximate
+                  << " more only by nearest number or a similar street name (used if the api can't find them)" << std::endl;
+    }
 
-    // vectors in which addresses/targets/distances will be stored
-    std::vector<Employee> employees;
-    std::vector<Target> targets;
-    std::vector<Distance> distances;
-    std::vector<No_pair> no_pairs;
-    std::vector<std::pair<int, std::vector<int>>> friend_groups;
-
-    // populate employees vector
-    for (const auto& item : j){
-        int id = item["id"];
-        std::string name = item["name"];
-        std::string address = item["address"];
-        std::string city = item["city"];
-
-        std::vector<std::string> no_pair;        
-        // get the no-pairs from json if there are any, should be a list in the json file for the biggest freak 
-        if (item.contains("no_pair") && item["no_pair"].is_array()) {
-            no_pair = item["no_pair"].get<std::vector<std::string>>();
-        } else {
-            no_pair = {}; 
-        }
+    GeocodeConfig geocode_config = geocodeConfigFromEnv(apiKey);
+
+    std::cout << "forward-geolocating " << jobs.size() << " addresses (" << geocode_config.workers << " workers, "
+              << geocode_config.limit.requests_per_second << " req/s)..." << std::endl;
+
+    geocodeAll(jobs, geocode_config);
 
-        std::vector<std::string> friends; 
-        // same for friends (or people who'd prefer to work together)
-        if (item.contains("friends") && item["friends"].is_array()) {
-            friends = item["friends"].get<std::vector<std::string>>();
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const GeocodeJob& job = jobs[i];
+        const PendingLocation& loc = pending[i];
+
+        if (job.found) {
+            *loc.lat = job.lat;
+            *loc.lon = job.lon;
+            geocache.store(loc.owner, loc.cache_key, job.lat, job.lon);
+
+            std::cout << loc.label << ", lat: " << job.lat << ", lon: " << job.lon << std::endl;
         } else {
-            friends = {}; 
+            std::cout << "request failed for " << loc.label << ", code: " << job.status_code << " after " << job.attempts << " attempt(s)";
+            if (loc.approximate) {
+                *loc.lat = loc.approximate_lat;
+                *loc.lon = loc.approximate_lon;
+                std::cout << ", using the closest match of the address index";
+            }
+            std::cout << std::endl;
         }
-
-        // make an Employee object, using employee data and push it into the employees vector
-        employees.push_back(Employee{id, name, address, city, no_pair, friends});
     }
 
-    // names mapped to id
-    std::unordered_map<std::string, int> name_to_id;
-    for (const auto& emp : employees) {
-        name_to_id[emp.name] = emp.id;
+    for (const auto& [tar, job_index] : repeated_targets) {
+        if (jobs[job_index].found || pending[job_index].approximate) {
+            tar->lat = *pending[job_index].lat;
+            tar->lon = *pending[job_index].lon;
+        }
     }
 
-    for (const auto& emp : employees) {
-        if (!emp.friends.empty()) {
-            // print the employees who have enemies and do not wish to work together with said persons
-            // as well as their friends 
-            // std::cout << "employee: " << emp.name << " has the following friends: ";
-            // for (const auto& f : emp.friends) {
-            //     std::cout << f << ", ";
-            // }
-            // std::cout << std::endl;
-
-            std::vector<int> friend_ids;
-            for (const auto& f_name : emp.friends) {
-                // check if "friend" exists in name_to_id map
-                if (name_to_id.find(f_name) != name_to_id.end()) {
-                    friend_ids.push_back(name_to_id[f_name]);
+    geocache.save();
+    std::cout << "geocache: " << geocache.hits() << " hits, " << geocache.misses() << " misses (" << geocache.size() << " addresses cached)" << std::endl;
+}
+
+// the same with the cache file read just for these addresses
+void geolocate(std::vector<Employee>& employees, std::vector<Target>& targets, const char* apiKey)
+{
+    GeoCache geocache("../geocache.json");
+    geocache.load();
+    geolocate(employees, targets, apiKey, geocache);
+}
+
+// applies one batch of roster changes to the live model, e.g.
+// [{"op": "remove_employee", "id": 7}, {"op": "set_requirement", "target_number": 2, "req_employees": 3},
+//  {"op": "add_employee", "id": 51, "name": "...", "address": "...", "city": "..."}, {"op": "remove_target", "target_number": 4},
+//  {"op": "add_target", "target_number": 9, "address": "...", "city": "...", "country": "...", "req_employees": 2}]
+void applyChanges(operations_research::IncrementalAssigner& assigner, const json& changes, const char* apiKey)
+{
+    for (const auto& change : changes) {
+        std::string op = change.value("op", "");
+
+        // a change without one of its fields is skipped, like one with an unknown id
+        auto missing = [&](std::initializer_list<const char*> keys) {
+            for (const char* key : keys) {
+                if (!change.contains(key)) {
+                    std::cerr << op << ": no \"" << key << "\" in " << change.dump() << std::endl;
+                    return true;
                 }
             }
-            friend_groups.emplace_back(emp.id, friend_ids);
-        }
-        if (!emp.no_pair.empty()) {
-            // std::cout << "employee: " << emp.name << " does not like the following people: ";
-            // for (const auto& p : emp.no_pair) {
-            //     std::cout << p << ", ";
-            // }
-            // std::cout << std::endl;
-
-            for (const auto& p_name : emp.no_pair) {
-                for (const auto& other_emp : employees) {
-                    if (p_name == other_emp.name) {
-                        // std::cout << p_name << " found in the shit-list of: " << emp.name << std::endl;
-                        no_pairs.emplace_back(emp.id, other_emp.id);
-                    }
-                }
+            return false;
+        };
+
+        if (op == "remove_employee") {
+            if (missing({"id"})) continue;
+            int index = assigner.employeeIndex(change["id"]);
+            if (index < 0) {
+                std::cerr << "remove_employee: unknown id " << change["id"] << std::endl;
+                continue;
+            }
+            assigner.removeEmployee(index);
+        } else if (op == "add_employee") {
+            if (missing({"id", "name", "address", "city"})) continue;
+            std::vector<Employee> added{parseEmployee(change)};
+            std::vector<Target> no_targets;
+            geolocate(added, no_targets, apiKey);
+
+            std::vector<float> row;
+            for (const auto& tar : assigner.targets()) {
+                row.push_back(haversine(tar.lat, tar.lon, added[0].lat, added[0].lon));
+            }
+            assigner.addEmployee(added[0], row);
+        } else if (op == "remove_target") {
+            if (missing({"target_number"})) continue;
+            int index = assigner.targetIndex(change["target_number"]);
+            if (index < 0) {
+                std::cerr << "remove_target: unknown target_number " << change["target_number"] << std::endl;
+                continue;
+            }
+            assigner.removeTarget(index);
+        } else if (op == "add_target") {
+            if (missing({"target_number", "address", "city", "country", "req_employees"})) continue;
+            std::vector<Employee> no_employees;
+            std::vector<Target> added{parseTarget(change)};
+            geolocate(no_employees, added, apiKey);
+
+            std::vector<float> column;
+            for (const auto& emp : assigner.employees()) {
+                column.push_back(haversine(added[0].lat, added[0].lon, emp.lat, emp.lon));
+            }
+            assigner.addTarget(added[0], column);
+        } else if (op == "set_requirement") {
+            if (missing({"target_number", "req_employees"})) continue;
+            int index = assigner.targetIndex(change["target_number"]);
+            int req_employees = change["req_employees"];
+            if (index < 0) {
+                std::cerr << "set_requirement: unknown target_number " << change["target_number"] << std::endl;
+                continue;
             }
+            if (req_employees < 0) {
+                std::cerr << "set_requirement: negative req_employees " << req_employees << std::endl;
+                continue;
+            }
+            assigner.setRequirement(index, req_employees);
+        } else {
+            std::cerr << "unknown change: " << change.dump() << std::endl;
         }
     }
+}
 
-    // these pairs ought not be at the same location:
-    // for (const auto& np : no_pairs) {
-    //     std::cout << "(" << np.first << ", " << np.second << ")" << std::endl;
-    // }
-
-    // these friends ought to stick together
-    // for (const auto& f_group : friend_groups) {
-    //     std::cout << "employee id: " << f_group.first << " has friends with IDs: ";
-    //     for (int f_id : f_group.second) {
-    //         std::cout << f_id << ", ";
-    //     }
-    //     std::cout << std::endl;
-    // }
+// the current assignment of the incremental model
+AssignmentResult incrementalResult(const operations_research::IncrementalAssigner& assigner)
+{
+    AssignmentResult result;
+    result.solver = "incremental";
+    result.status = assigner.optimal() ? SolveStatus::Optimal : SolveStatus::Feasible;
+    const std::vector<int>& assigned = assigner.assignment();
+    for (size_t i = 0; i < assigned.size(); ++i) {
+        if (assigned[i] >= 0) result.add(i, assigned[i], assigner.distance(i, assigned[i]));
+    }
+    return result;
+}
 
-    // populate target vector
-    for (const auto& item : jt){
-        int target_number = item["target_number"];
-        std::string address = item["address"];
-        std::string city = item["city"];
-        std::string country = item["country"];
-        int req_emp = item["req_employees"];
+// keeps the model around: solve once, then apply every --changes file in order and only report what moved.
+// the employees/targets get the added ones appended, so they match the indices of the returned assignment.
+// without use_relations (the shortest mode) enemies and friends are left out, also those of added employees
+AssignmentResult runIncremental(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets,
+    const RelationGraph& relations, bool use_relations, const std::vector<std::string>& change_files, const char* apiKey,
+    const SolverOptions& solver_options, bool quiet)
+{
+    static const RelationGraph no_relations;
+    operations_research::IncrementalAssigner assigner(distances, employees, targets, use_relations ? relations : no_relations, solver_options, use_relations);
 
-        targets.push_back(Target{target_number, address, city, country, req_emp});
+    if (!assigner.solve()) {
+        std::cout << "no solution found..." << std::endl;
+        return AssignmentResult();
     }
 
-    // get api key from env
-    const char* apiKey = std::getenv("LIQ_API_KEY");
-    // if (apiKey) {
-    //     std::cout << "API_KEY: " << apiKey << std::endl;
-    // }
+    std::cout << (assigner.optimal() ? "Optimal assignment found!" : "Feasible assignment found (stopped early)") << std::endl;
+    printResult(incrementalResult(assigner), assigner.employees(), assigner.targets(), quiet);
 
-    std::cout << "forward-geolocating target addresses..." << std::endl;
+    for (const auto& path : change_files) {
+        std::cout << "applying changes from " << path << "..." << std::endl;
+        applyChanges(assigner, loadJsonFile(path), apiKey);
 
-    for (auto& tar : targets) {
-        // std::cout << "tar: " << tar.target_number << ", address: " << tar.address << ", city: " << tar.city << ", country: " << tar.country << ",lon: " << tar.lon << ",lat: " << tar.lat << std::endl;
-        std::string query = tar.city + ", " + tar.address + ", " + tar.country;
+        operations_research::AssignmentDelta delta;
+        if (!assigner.resolve(delta)) {
+            std::cout << "no solution found after these changes, undoing them and keeping the previous assignment" << std::endl;
+            continue;
+        }
 
-        cpr::Response rt = forwardGeolocate(query, apiKey); 
-        rt.status_code;
-        rt.text;
+        for (const auto& change : delta.changes) {
+            const std::string& name = assigner.employees()[change.employee_index].name;
+            std::string from = change.old_target < 0 ? "-" : std::to_string(assigner.targets()[change.old_target].target_number);
+            std::string to = change.new_target < 0 ? "-" : std::to_string(assigner.targets()[change.new_target].target_number);
+            std::cout << "employee " << name << ": Target:" << from << " -> Target:" << to << std::endl;
+        }
+        std::cout << delta.changes.size() << " change(s), total cost: " << delta.old_km << " -> " << delta.new_km << " km" << std::endl;
+    }
 
-        if (rt.status_code == 200) {            
-            try {
-                json response = json::parse(rt.text);
+    employees = assigner.employees();
+    targets = assigner.targets();
+    return incrementalResult(assigner);
+}
 
-                if (!response.empty()) {
-                    // api returns lon/lat as string, convert to float (maybe useful for later)
-                    tar.lat = std::stof(response[0]["lat"].get<std::string>());
-                    tar.lon = std::stof(response[0]["lon"].get<std::string>());               
+// loads a preprocessed road graph (or makes a synthetic grid over the input with "synthetic").
+// contracting a real graph takes a while, so the hierarchy is cached next to it as <path>.ch
+void loadRoadNetwork(const std::string& path, const std::vector<Employee>& employees, const std::vector<Target>& targets,
+    RoadGraph& graph, ContractionHierarchy& hierarchy)
+{
+    if (path == "synthetic") {
+        float min_lat = 90, min_lon = 180, max_lat = -90, max_lon = -180;
+        auto extend = [&](float lat, float lon) {
+            min_lat = std::min(min_lat, lat);
+            min_lon = std::min(min_lon, lon);
+            max_lat = std::max(max_lat, lat);
+            max_lon = std::max(max_lon, lon);
+        };
+        for (const auto& emp : employees) extend(emp.lat, emp.lon);
+        for (const auto& tar : targets) extend(tar.lat, tar.lon);
+
+        graph = syntheticRoadGraph(min_lat - 0.05f, min_lon - 0.05f, max_lat + 0.05f, max_lon + 0.05f, 60, 60);
+        hierarchy = ContractionHierarchy(graph);
+    } else {
+        if (!loadRoadGraph(path, graph)) {
+            std::cerr << "can't load road graph " << path << "..." << std::endl;
+            exit(1);
+        }
+        if (!hierarchy.load(path + ".ch", graph)) {
+            std::cout << "contracting road graph (" << graph.numNodes() << " junctions, " << graph.edges.size() << " roads)..." << std::endl;
+            hierarchy = ContractionHierarchy(graph);
+            if (!hierarchy.save(path + ".ch")) {
+                std::cerr << "can't write " << path << ".ch" << std::endl;
+            }
+        }
+    }
 
-                    std::cout << "tar#: " << tar.target_number << ", lat: " << tar.lat << ", lon: " << tar.lon << std::endl;
-                }
-            } catch (const std::exception& e) {
-                std::cerr << "JSON parse error: " << e.what() << std::endl;
+    std::cout << "road graph: " << graph.numNodes() << " junctions, " << hierarchy.numUpwardEdges() << " edges in the hierarchy" << std::endl;
+}
+
+int main(int argc, char** argv) 
+{
+    // command line options
+    Precision precision = Precision::Single;
+    SolverOptions solver_options;
+    // shortest, balanced, friends (enemies and friends) or roster (several days/shifts at once)
+    std::string mode = "friends";
+    bool use_flow = true;
+    // greedy + local search plan instead of the exact solve, or as the exact solve's starting point
+    bool use_heuristic = false;
+    bool warm_start = false;
+    HeuristicOptions heuristic_options;
+    // roster changes to re-optimize for after the first solve
+    std::vector<std::string> change_files;
+    // road graph for the distances instead of haversine, "synthetic" for a generated one
+    std::string road_graph;
+    bool use_matrix_store = true;
+    // geocoded roster snapshot to start from / to write after geocoding
+    std::string snapshot_in;
+    std::string snapshot_out;
+    // no per-pair distances and per-employee lines on the console, just the totals
+    bool quiet = false;
+    // where to export the assignment to (.csv or .json)
+    std::string output_path;
+    // per-phase timings: chrome trace file and/or the one-line summary
+    std::string trace_path;
+    bool timings = false;
+    // split big instances into geographic regions (--regions N, 0 = automatic)
+    bool decompose = false;
+    DecomposeOptions decompose_options;
+    // local address extract (csv) to geocode from before asking the api
+    std::string address_index_path;
+    // what-if sweep after the base plan: scenario files, "each-employee" and/or "each-target"
+    std::vector<std::string> scenario_sources;
+    ScenarioOptions scenario_options;
+    std::string scenario_output;
+    // stay resident and answer requests on a unix socket and/or a localhost port instead of solving once
+    ServerOptions server_options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--precision" && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (value != "single" && value != "double") {
+                std::cerr << "unknown precision: " << value << " (single or double)" << std::endl;
+                return 1;
             }
+            precision = value == "double" ? Precision::Double : Precision::Single;
+        } else if (arg == "--mode" && i + 1 < argc) {
+            mode = argv[++i];
+        } else if (arg == "--backend" && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (value != "scip" && value != "cpsat") {
+                std::cerr << "unknown backend: " << value << " (scip or cpsat)" << std::endl;
+                return 1;
+            }
+            solver_options.backend = value == "cpsat" ? Backend::CpSat : Backend::Scip;
+        } else if (arg == "--workers" && i + 1 < argc) {
+            solver_options.num_workers = std::atoi(argv[++i]);
+        } else if (arg == "--changes" && i + 1 < argc) {
+            change_files.push_back(argv[++i]);
+        } else if (arg == "--time-limit" && i + 1 < argc) {
+            solver_options.time_limit_seconds = std::atof(argv[++i]);
+        } else if (arg == "--gap" && i + 1 < argc) {
+            solver_options.relative_gap = std::atof(argv[++i]);
+        } else if (arg == "--max-shifts" && i + 1 < argc) {
+            solver_options.max_shifts_per_day = std::atoi(argv[++i]);
+        } else if (arg == "--road-graph" && i + 1 < argc) {
+            road_graph = argv[++i];
+        } else if (arg == "--snapshot" && i + 1 < argc) {
+            snapshot_in = argv[++i];
+        } else if (arg == "--save-snapshot" && i + 1 < argc) {
+            snapshot_out = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--timings") {
+            timings = true;
+        } else if (arg == "--regions" && i + 1 < argc) {
+            decompose = true;
+            decompose_options.num_regions = std::atoi(argv[++i]);
+        } else if (arg == "--compare-full") {
+            decompose_options.compare_full = true;
+        } else if (arg == "--address-index" && i + 1 < argc) {
+            address_index_path = argv[++i];
+        } else if (arg == "--serve" && i + 1 < argc) {
+            server_options.socket_path = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            server_options.port = std::atoi(argv[++i]);
+        } else if (arg == "--server-workers" && i + 1 < argc) {
+            server_options.workers = std::atoi(argv[++i]);
+        } else if (arg == "--scenarios" && i + 1 < argc) {
+            scenario_sources.push_back(argv[++i]);
+        } else if (arg == "--scenario-workers" && i + 1 < argc) {
+            scenario_options.workers = std::atoi(argv[++i]);
+        } else if (arg == "--scenario-output" && i + 1 < argc) {
+            scenario_output = argv[++i];
+        } else if (arg == "--quiet") {
+            quiet = true;
+        } else if (arg == "--output" && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (arg == "--no-matrix-store") {
+            use_matrix_store = false;
+        } else if (arg == "--no-aggregate") {
+            solver_options.aggregate = false;
+        } else if (arg == "--aggregate-km" && i + 1 < argc) {
+            solver_options.aggregate_km = std::atof(argv[++i]);
+        } else if (arg == "--no-flow") {
+            use_flow = false;
+        } else if (arg == "--heuristic") {
+            use_heuristic = true;
+        } else if (arg == "--warm-start") {
+            warm_start = true;
+        } else if (arg == "--seed" && i + 1 < argc) {
+            heuristic_options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--heuristic-rounds" && i + 1 < argc) {
+            heuristic_options.max_rounds = std::atoi(argv[++i]);
+        } else if (arg == "--heuristic-ms" && i + 1 < argc) {
+            heuristic_options.time_limit_seconds = std::atof(argv[++i]) / 1000.0;
+        } else if (arg == "--k-nearest" && i + 1 < argc) {
+            solver_options.pruning.k_nearest = std::atoi(argv[++i]);
+        } else if (arg == "--radius-km" && i + 1 < argc) {
+            solver_options.pruning.radius_km = std::atof(argv[++i]);
         } else {
-            std::cout << "request failed, code: " << rt.status_code << std::endl;
+            std::cerr << "unknown argument: " << arg << std::endl;
+            return 1;
         }
+    }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(501));
+    // with a time limit the solver may stop before proving optimality, show how the solution improved meanwhile
+    if (solver_options.time_limit_seconds > 0 || solver_options.relative_gap > 0) {
+        solver_options.on_incumbent = [](const Incumbent& incumbent) {
+            std::cout << "incumbent after " << incumbent.seconds << " s: " << incumbent.km << " km (" << incumbent.pairs.size() << " assignments)" << std::endl;
+        };
     }
 
-    std::cout << "forward-geolocating employees' addresses..." << std::endl;
+    if (timings || !trace_path.empty()) {
+        enableTracing();
+    }
 
-    for (auto& emp : employees) {
-        // std::cout << "sending request for: " << emp.name << ", " << emp.address << ", " << emp.city << std::endl;            
-        // TODO: this assumes every employee lives in the netherlands which might not be the case
-        std::string query = emp.city + ", " + emp.address + ", Netherlands";
-
-        cpr::Response r = forwardGeolocate(query, apiKey);
-        r.status_code;
-        r.text;
-        
-        // parse the response and set emp.lon/lat
-        if (r.status_code == 200) {            
-            try {
-                json response = json::parse(r.text);
-
-                if (!response.empty()) {
-                    emp.lat = std::stof(response[0]["lat"].get<std::string>());
-                    emp.lon = std::stof(response[0]["lon"].get<std::string>());               
-
-                    std::cout << "name: " << emp.name << ", lat: " << emp.lat << ", lon: " << emp.lon << std::endl;
-                }
-            } catch (const std::exception& e) {
-                std::cerr << "JSON parse error: " << e.what() << std::endl;
-            }
-        } else {
-            std::cout << "request failed, code: " << r.status_code << std::endl;
+    // parse the address data from the json file
+    // TODO: gain access to the roster/planning (hopefully as json) on ecologieconnect.nl
+    // this could be a daily json with the roster of available people
+
+    vrp::Options vrp_options;
+    if (!vrp::parseMode(mode, vrp_options.mode)) {
+        std::cerr << "unknown mode: " << mode << " (shortest, balanced, friends or roster)" << std::endl;
+        return 1;
+    }
+    vrp_options.use_flow = use_flow;
+    vrp_options.use_heuristic = use_heuristic;
+    vrp_options.warm_start = warm_start;
+    vrp_options.heuristic = heuristic_options;
+    vrp_options.solver = solver_options;
+
+    // vectors in which addresses/targets/distances will be stored
+    std::vector<Employee> employees;
+    std::vector<Target> targets;
+
+    // I/O employees + targets data, streamed straight into the vectors (or from a geocoded snapshot)
+    ScopedTimer load_phase("load", "phase");
+    if (!snapshot_in.empty()) {
+        if (!loadSnapshot(snapshot_in, employees, targets)) {
+            return 1;
         }
+    } else if (!loadEmployees("../addresstest.json", employees) || !loadTargets("../targettest.json", targets)) {
+        return 1;
+    }
+    load_phase.stop();
+
+    // enemies and friends resolved from names to employee indices once, shared by every solver
+    ScopedTimer relations_phase("relations", "phase");
+    RelationGraph relations = buildRelations(employees);
+    relations_phase.stop();
+    for (const auto& name : relations.unknown_names) {
+        std::cerr << "unknown name in no_pair/friends: " << name << std::endl;
+    }
+    std::cout << relations.conflicts.size() << " conflict pair(s), " << relations.friends.size() << " friend pair(s)" << std::endl;
+
+    // get api key from env
+    const char* apiKey = std::getenv("LIQ_API_KEY");
+    // if (apiKey) {
+    //     std::cout << "API_KEY: " << apiKey << std::endl;
+    // }
+
+    if (!address_index_path.empty() && !address_index.load(address_index_path)) {
+        return 1;
+    }
 
-        // TODO:
-        // save result to file or csv.
-        // in the future, check file beforehand and only 
-        // make this request if lon/lat isn't known
-        // (so in the case of a new employee. be mindful of employee moving)
-
-        // sleep to obey api rate limit (2/s)
-        std::this_thread::sleep_for(std::chrono::milliseconds(501));        
-    } 
-
-    // calc the distance using haversine helper func and populate distances vector
-    for (const auto& tar : targets) {
-        for (const auto& emp : employees) {
-            Distance distance;
-            distance.target = tar;
-            distance.employee = emp;
-            distance.distance = haversine(tar.lat, tar.lon, emp.lat, emp.lon);
-
-            distances.push_back(distance);
+    // a snapshot already has its coordinates
+    if (snapshot_in.empty()) {
+        TRACE_PHASE("geocode");
+        geolocate(employees, targets, apiKey);
+    }
+    if (!snapshot_out.empty() && !saveSnapshot(snapshot_out, employees, targets)) {
+        std::cerr << "can't write snapshot " << snapshot_out << std::endl;
+    }
+
+    // calc the distance using the batched haversine kernel (or over the roads) and fill the distance matrix.
+    // the road graph is only loaded once some distances actually have to be computed
+    RoadGraph graph;
+    ContractionHierarchy hierarchy;
+    MatrixStore::ComputeFn computeDistances = [&](const std::vector<Employee>& emps, const std::vector<Target>& tars) {
+        if (road_graph.empty()) {
+            return buildDistanceMatrix(emps, tars, precision);
+        }
+        if (graph.numNodes() == 0) {
+            loadRoadNetwork(road_graph, employees, targets, graph, hierarchy);
         }
+        return buildRoadDistanceMatrix(graph, hierarchy, emps, tars);
+    };
+
+    // known distances come from the store, only new/moved employees and targets get computed.
+    // a synthetic graph depends on the input itself, so there's nothing to keep there
+    ScopedTimer distances_phase("distances", "phase");
+    DistanceMatrix distances;
+    if (use_matrix_store && road_graph != "synthetic") {
+        std::string provider = road_graph.empty() ? (precision == Precision::Double ? "haversine-double" : "haversine-float") : "road:" + road_graph;
+        MatrixStore store("../distances.bin", provider);
+        distances = store.sync(employees, targets, computeDistances);
+        std::cout << "distance store: computed " << store.computedEmployees() << " employees and " << store.computedTargets()
+                  << " targets, reused " << store.reusedEmployees() << " employees and " << store.reusedTargets() << " targets" << std::endl;
+    } else {
+        distances = computeDistances(employees, targets);
+    }
+    distances_phase.stop();
+
+    if (!server_options.socket_path.empty() || server_options.port > 0) {
+        ServerContext context;
+        context.employees = employees;
+        context.targets = targets;
+        context.relations = relations;
+        context.distances = distances;
+        context.defaults = solver_options;
+        context.default_mode = mode;
+        context.solve = [&](const std::string& request_mode, const DistanceMatrix& d, std::vector<Employee>& emps, std::vector<Target>& tars,
+                            const RelationGraph& rels, const SolverOptions& opts) {
+            vrp::Options request_options = vrp_options;
+            vrp::parseMode(request_mode, request_options.mode);
+            request_options.solver = opts;
+            return vrp::solve(d, emps, tars, rels, request_options);
+        };
+        // the road graph is only read while serving, load it now if the distance store had everything
+        if (!road_graph.empty() && graph.numNodes() == 0) {
+            loadRoadNetwork(road_graph, employees, targets, graph, hierarchy);
+        }
+        // one geocache for the whole run, it isn't shared between threads so new targets are geocoded one request
+        // at a time (their distances are computed in parallel)
+        GeoCache server_geocache("../geocache.json");
+        server_geocache.load();
+        std::mutex locate_mutex;
+        context.load_targets = [&](const json& items, std::vector<Target>& tars, DistanceMatrix& d, std::string& error) {
+            for (const auto& item : items) {
+                bool complete = item.is_object();
+                for (const char* field : {"target_number", "address", "city", "country", "req_employees"}) {
+                    complete = complete && item.contains(field);
+                }
+                if (!complete) {
+                    error = "a target needs target_number, address, city, country and req_employees";
+                    return false;
+                }
+                Target tar = parseTarget(item);
+                tar.lat = item.value("lat", 0.0f);
+                tar.lon = item.value("lon", 0.0f);
+                tars.push_back(tar);
+            }
+            // targets without lat/lon go through the geocache/api
+            std::vector<Target*> missing;
+            std::vector<Target> unlocated;
+            for (auto& tar : tars) {
+                if (tar.lat == 0 && tar.lon == 0) {
+                    missing.push_back(&tar);
+                    unlocated.push_back(tar);
+                }
+            }
+            if (!unlocated.empty()) {
+                std::vector<Employee> no_employees;
+                {
+                    std::lock_guard<std::mutex> lock(locate_mutex);
+                    geolocate(no_employees, unlocated, apiKey, server_geocache);
+                }
+                for (size_t i = 0; i < missing.size(); ++i) {
+                    if (unlocated[i].lat == 0 && unlocated[i].lon == 0) {
+                        error = "can't locate target " + std::to_string(unlocated[i].target_number);
+                        return false;
+                    }
+                    missing[i]->lat = unlocated[i].lat;
+                    missing[i]->lon = unlocated[i].lon;
+                }
+            }
+            d = computeDistances(employees, tars);
+            return true;
+        };
+        return runServer(server_options, context);
     }
 
-    // log distance for every combination (can be ommitted for perf)
-    for (const auto& d : distances) {
-        std::cout << "distance between: " << "(target_number: " << d.target.target_number << "- req." << d.target.req_employees << ") " << d.target.address << " and " << "(" << d.employee.name << ":" << d.employee.id << ") " << d.employee.address << ": " << d.distance << "km" << std::endl;
+    // log distance for every combination (skipped with --quiet), written per target instead of flushing every line
+    if (!quiet) {
+        TRACE_PHASE("distance log");
+        std::ostringstream log;
+        for (int t = 0; t < distances.num_targets; ++t) {
+            const Target& tar = targets[t];
+            for (int e = 0; e < distances.num_employees; ++e) {
+                const Employee& emp = employees[e];
+                log << "distance between: " << "(target_number: " << tar.target_number << "- req." << tar.req_employees << ") " << tar.address << " and " << "(" << emp.name << ":" << emp.id << ") " << emp.address << ": " << distances.at(e, t) << "km\n";
+            }
+            std::cout << log.str();
+            log.str("");
+        }
+        std::cout << std::flush;
     }
 
     // before bothering with the assignment, check if there are enough employees available to hit every target requirement
@@ -280,21 +703,100 @@ int main(int argc, char** argv)
         sum += t.req_employees; 
     }
 
-    if (sum > num_employees) {
+    // one (sub)instance with the chosen mode and flags, for the regions and the scenarios
+    AssignFn solve = [&](const DistanceMatrix& d, std::vector<Employee>& emps, std::vector<Target>& tars, const RelationGraph& rels, const SolverOptions& opts) {
+        vrp::Options sub_options = vrp_options;
+        sub_options.solver = opts;
+        return vrp::solve(d, emps, tars, rels, sub_options);
+    };
+
+    AssignmentResult result;
+    ScopedTimer solve_phase("solve", "phase");
+
+    if (mode == "roster") {
+        // a roster only needs enough people per shift, that is checked per day
+        result = vrp::solve(distances, employees, targets, relations, vrp_options);
+    } else if (sum > num_employees) {
         std::cout << "Not enough resources! The total employee requirement for the targets is: " << sum << " and the total available employees is: " << num_employees << std::endl;
+    } else if (!change_files.empty()) {
+        // same-day changes: keep the MIP model and warm start from the previous assignment
+        if (mode == "balanced" || solver_options.backend != Backend::Scip) {
+            std::cout << "--changes works with the scip model only (shortest/friends mode), ignoring --mode/--backend" << std::endl;
+        }
+        result = runIncremental(distances, employees, targets, relations, mode != "shortest", change_files, apiKey, solver_options, quiet);
+    } else if (decompose && mode != "balanced") {
+        // regions solved on their own with the same solver, then repaired along the borders
+        decompose_options.use_relations = mode == "friends";
+        result = operations_research::assignDecomposed(distances, employees, targets, relations, solver_options, decompose_options, solve);
     } else {
         // use google OR tools for assignment optimization
-        // TODO: based on command line input, run different function?
-             
-        // closer distribution of distances:
-        // operations_research::assignEmployeesBalanced(distances, employees, targets);   
-        
-        // shortest amount of distance 
-        // operations_research::assignEmployees(distances, employees, targets);       
-
-        /// takes into account enemies / people who always want to be on the same location
-        operations_research::assignEmployeesEnemiesAndFriends(distances, employees, targets, no_pairs, friend_groups);
+        if (decompose) {
+            std::cout << "--regions works with the shortest/friends mode only, solving the balanced assignment in one go" << std::endl;
+        }
+        result = vrp::solve(distances, employees, targets, relations, vrp_options);
+    }
+
+    solve_phase.stop();
+
+    traceInstant("solver", {
+        {"variables", result.stats.num_variables},
+        {"constraints", result.stats.num_constraints},
+        {"nodes", static_cast<double>(result.stats.nodes)},
+        {"wall_s", result.stats.wall_seconds},
+        {"gap", result.gap},
+    });
+
+    ScopedTimer output_phase("output", "phase");
+    // the incremental run already printed its assignment (and the changes after that)
+    if (change_files.empty() || mode == "roster") {
+        printResult(result, employees, targets, quiet);
+    }
+    bool written = output_path.empty() || writeResult(output_path, result, employees, targets);
+    output_phase.stop();
+
+    if (!scenario_sources.empty() && (!result.solved() || !change_files.empty())) {
+        std::cout << "--scenarios needs a solved base plan (and no --changes), skipping the scenarios" << std::endl;
+    } else if (!scenario_sources.empty()) {
+        ScopedTimer scenario_phase("scenarios", "phase");
+        std::vector<Scenario> scenarios;
+        for (const auto& source : scenario_sources) {
+            if (source == "each-employee") {
+                std::vector<Scenario> generated = employeeScenarios(result, employees);
+                scenarios.insert(scenarios.end(), generated.begin(), generated.end());
+            } else if (source == "each-target") {
+                std::vector<Scenario> generated = targetScenarios(targets);
+                scenarios.insert(scenarios.end(), generated.begin(), generated.end());
+            } else {
+                std::string error;
+                if (!parseScenarios(loadJsonFile(source), employees, targets, scenarios, error)) {
+                    std::cerr << source << ": " << error << std::endl;
+                    return 1;
+                }
+            }
+        }
+
+        // hundreds of "Optimal assignment found!" from the workers would bury the table
+        std::cout << "solving " << scenarios.size() << " scenario(s)..." << std::endl;
+        auto sweep_start = std::chrono::steady_clock::now();
+        setSolverLog(nullptr);
+        std::vector<ScenarioOutcome> outcomes = operations_research::runScenarios(distances, employees, targets, relations, result,
+            scenarios, solver_options, scenario_options, solve);
+        setSolverLog(&std::cout);
+        scenario_phase.stop();
+
+        printScenarioTable(result, scenarios, outcomes);
+        std::cout << scenarios.size() << " scenario(s) in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - sweep_start).count() << " s" << std::endl;
+        if (!scenario_output.empty()) {
+            written = writeScenarioTable(scenario_output, result, scenarios, outcomes) && written;
+        }
+    }
+
+    if (timings || !trace_path.empty()) {
+        std::cout << "timings: " << traceSummary() << std::endl;
+    }
+    if (!trace_path.empty()) {
+        writeChromeTrace(trace_path);
     }
 
-    return 0;
+    return written ? 0 : 1;
 }
\ No newline at end of file
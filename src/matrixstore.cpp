@@ -0,0 +1,376 @@
+#include "matrixstore.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+static const char MATRIX_STORE_MAGIC[8] = {'V', 'R', 'P', 'M', 'T', 'X', '0', '1'};
+
+// key of a slot that doesn't belong to anyone (never used, or a one-off duplicate)
+static const int64_t NO_KEY = std::numeric_limits<int64_t>::min();
+// slot of an entry that hasn't got one yet
+static const uint32_t NO_SLOT = std::numeric_limits<uint32_t>::max();
+
+struct MatrixStoreHeader {
+    char magic[8];
+    char provider[56];
+    uint32_t emp_capacity;
+    uint32_t tar_capacity;
+    uint32_t emp_used;
+    uint32_t tar_used;
+    char reserved[48];
+};
+static_assert(sizeof(MatrixStoreHeader) == 128, "the header is part of the file format");
+
+struct MatrixStore::Slot {
+    int64_t key;
+    float lat;
+    float lon;
+};
+
+static size_t storeSize(uint32_t emp_capacity, uint32_t tar_capacity)
+{
+    return sizeof(MatrixStoreHeader) + sizeof(MatrixStore::Slot) * ((size_t)emp_capacity + tar_capacity)
+        + sizeof(float) * (size_t)emp_capacity * tar_capacity;
+}
+
+// one mmap of the store file, unmapped when the last DistanceMatrix reading from it is gone
+struct MatrixStore::Mapping {
+    void* base = nullptr;
+    size_t size = 0;
+
+    ~Mapping()
+    {
+        if (base) munmap(base, size);
+    }
+
+    MatrixStoreHeader* header() const { return static_cast<MatrixStoreHeader*>(base); }
+    Slot* empSlots() const { return reinterpret_cast<Slot*>(static_cast<char*>(base) + sizeof(MatrixStoreHeader)); }
+    Slot* tarSlots() const { return empSlots() + header()->emp_capacity; }
+    float* distances() const { return reinterpret_cast<float*>(tarSlots() + header()->tar_capacity); }
+};
+
+// maps the whole file read/write, nullptr if that fails
+static std::shared_ptr<MatrixStore::Mapping> mapFile(const std::string& path, size_t size, bool create)
+{
+    int fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (create ? ftruncate(fd, size) != 0 : fstat(fd, &st) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    if (!create) {
+        size = st.st_size;
+    }
+    if (size < sizeof(MatrixStoreHeader)) {
+        close(fd);
+        return nullptr;
+    }
+
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // the mapping keeps the file alive by itself
+    close(fd);
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+
+    auto mapping = std::make_shared<MatrixStore::Mapping>();
+    mapping->base = base;
+    mapping->size = size;
+    return mapping;
+}
+
+// room to grow, so a few new employees don't rewrite the whole file every run
+static uint32_t grownCapacity(size_t needed, uint32_t minimum)
+{
+    return std::max<uint32_t>(minimum, needed * 2);
+}
+
+MatrixStore::MatrixStore(std::string path, std::string provider) : path(std::move(path)), provider(std::move(provider)) {}
+
+MatrixStore::~MatrixStore() = default;
+
+bool MatrixStore::open()
+{
+    std::shared_ptr<Mapping> m = mapFile(path, 0, false);
+    if (!m) {
+        return false;
+    }
+
+    const MatrixStoreHeader* h = m->header();
+    bool valid = std::memcmp(h->magic, MATRIX_STORE_MAGIC, sizeof(h->magic)) == 0
+        && std::strncmp(h->provider, provider.c_str(), sizeof(h->provider) - 1) == 0
+        && m->size == storeSize(h->emp_capacity, h->tar_capacity)
+        && h->emp_used <= h->emp_capacity && h->tar_used <= h->tar_capacity;
+    if (!valid) {
+        std::cerr << "ignoring distance store " << path << " (made for other distances, or damaged)" << std::endl;
+        return false;
+    }
+
+    mapping = m;
+    return true;
+}
+
+// writes a new file with the given capacities, carrying over the slots (and their distances) listed in
+// keep_emp/keep_tar from the current one in that order, then swaps it in. this is also the compaction
+bool MatrixStore::create(uint32_t emp_capacity, uint32_t tar_capacity, const std::vector<uint32_t>& keep_emp, const std::vector<uint32_t>& keep_tar)
+{
+    std::string tmp_path = path + ".tmp";
+    std::shared_ptr<Mapping> m = mapFile(tmp_path, storeSize(emp_capacity, tar_capacity), true);
+    if (!m) {
+        return false;
+    }
+
+    MatrixStoreHeader* h = m->header();
+    std::memset(h, 0, sizeof(MatrixStoreHeader));
+    std::memcpy(h->magic, MATRIX_STORE_MAGIC, sizeof(h->magic));
+    std::strncpy(h->provider, provider.c_str(), sizeof(h->provider) - 1);
+    h->emp_capacity = emp_capacity;
+    h->tar_capacity = tar_capacity;
+    h->emp_used = keep_emp.size();
+    h->tar_used = keep_tar.size();
+
+    for (uint32_t s = 0; s < emp_capacity; ++s) m->empSlots()[s] = Slot{NO_KEY, 0, 0};
+    for (uint32_t s = 0; s < tar_capacity; ++s) m->tarSlots()[s] = Slot{NO_KEY, 0, 0};
+
+    if (mapping) {
+        const float* old_dist = mapping->distances();
+        size_t old_stride = mapping->header()->emp_capacity;
+        float* dist = m->distances();
+
+        for (size_t e = 0; e < keep_emp.size(); ++e) m->empSlots()[e] = mapping->empSlots()[keep_emp[e]];
+        for (size_t t = 0; t < keep_tar.size(); ++t) {
+            m->tarSlots()[t] = mapping->tarSlots()[keep_tar[t]];
+            const float* old_row = old_dist + keep_tar[t] * old_stride;
+            float* row = dist + t * (size_t)emp_capacity;
+            for (size_t e = 0; e < keep_emp.size(); ++e) {
+                row[e] = old_row[keep_emp[e]];
+            }
+        }
+    }
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        return false;
+    }
+    // matrices handed out earlier keep the old (now unlinked) file mapped until they're gone
+    mapping = m;
+    return true;
+}
+
+// which slot every entry (employee or target) of this run goes into. fresh[i] is set when its distances
+// have to be computed (new, or moved since they were stored), keys that aren't in the store yet get
+// NO_SLOT and are handed out later. an entry with the same key and place as an earlier one (a roster lists
+// the same target once per day) shares its slot: first[i] is that earlier entry, i itself otherwise
+struct SlotPlan {
+    std::vector<uint32_t> slot;
+    std::vector<char> fresh;
+    std::vector<size_t> first;
+    // false for a key showing up again at another place, its slot is a one-off nobody can find later
+    std::vector<char> owns_key;
+    // used slot -> live in this run
+    std::vector<char> live;
+    size_t missing = 0;
+
+    bool representative(size_t i) const { return first[i] == i; }
+};
+
+static SlotPlan planSlots(const MatrixStore::Slot* slots, uint32_t used, const std::vector<int64_t>& keys,
+    const std::vector<float>& lat, const std::vector<float>& lon)
+{
+    SlotPlan plan;
+    plan.slot.assign(keys.size(), NO_SLOT);
+    plan.fresh.assign(keys.size(), 0);
+    plan.first.resize(keys.size());
+    plan.owns_key.assign(keys.size(), 0);
+    plan.live.assign(used, 0);
+
+    std::unordered_map<int64_t, uint32_t> by_key;
+    for (uint32_t s = 0; s < used; ++s) {
+        if (slots[s].key != NO_KEY) by_key[slots[s].key] = s;
+    }
+
+    std::unordered_map<int64_t, size_t> first_of_key;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        plan.first[i] = i;
+
+        auto seen = first_of_key.find(keys[i]);
+        if (seen != first_of_key.end()) {
+            size_t first = seen->second;
+            if (lat[first] == lat[i] && lon[first] == lon[i]) {
+                plan.first[i] = first;
+            } else {
+                plan.fresh[i] = 1;
+                ++plan.missing;
+            }
+            continue;
+        }
+        first_of_key[keys[i]] = i;
+        plan.owns_key[i] = 1;
+
+        auto it = by_key.find(keys[i]);
+        if (it == by_key.end()) {
+            plan.fresh[i] = 1;
+            ++plan.missing;
+            continue;
+        }
+        plan.slot[i] = it->second;
+        plan.live[it->second] = 1;
+        plan.fresh[i] = slots[it->second].lat != lat[i] || slots[it->second].lon != lon[i];
+    }
+    return plan;
+}
+
+// gives every entry its slot, new keys get the next free one, and records the key/place of the fresh ones
+static void assignSlots(SlotPlan& plan, MatrixStore::Slot* slots, uint32_t& used, const std::vector<int64_t>& keys,
+    const std::vector<float>& lat, const std::vector<float>& lon)
+{
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (!plan.representative(i)) {
+            plan.slot[i] = plan.slot[plan.first[i]];
+            continue;
+        }
+        if (plan.slot[i] == NO_SLOT) {
+            plan.slot[i] = used++;
+        }
+        if (plan.fresh[i]) {
+            slots[plan.slot[i]] = MatrixStore::Slot{plan.owns_key[i] ? keys[i] : NO_KEY, lat[i], lon[i]};
+        }
+    }
+}
+
+// slots that are still needed, in order, and where each of them ends up after a compaction
+static std::vector<uint32_t> liveSlots(const SlotPlan& plan, std::vector<uint32_t>& moved_to)
+{
+    std::vector<uint32_t> keep;
+    moved_to.assign(plan.live.size(), NO_SLOT);
+    for (uint32_t s = 0; s < plan.live.size(); ++s) {
+        if (plan.live[s]) {
+            moved_to[s] = keep.size();
+            keep.push_back(s);
+        }
+    }
+    return keep;
+}
+
+DistanceMatrix MatrixStore::sync(const std::vector<Employee>& employees, const std::vector<Target>& targets, const ComputeFn& compute)
+{
+    TRACE_SCOPE("matrix store sync");
+    DistanceMatrix m;
+    m.num_employees = employees.size();
+    m.num_targets = targets.size();
+    for (const auto& emp : employees) {
+        m.emp_lat.push_back(emp.lat);
+        m.emp_lon.push_back(emp.lon);
+    }
+    for (const auto& tar : targets) {
+        m.tar_lat.push_back(tar.lat);
+        m.tar_lon.push_back(tar.lon);
+    }
+
+    if (!mapping && !open() && !create(grownCapacity(employees.size(), 64), grownCapacity(targets.size(), 16), {}, {})) {
+        std::cerr << "can't write distance store " << path << ", computing everything" << std::endl;
+        return compute(employees, targets);
+    }
+
+    std::vector<int64_t> emp_keys, tar_keys;
+    for (const auto& emp : employees) emp_keys.push_back(emp.id);
+    for (const auto& tar : targets) tar_keys.push_back(tar.target_number);
+
+    MatrixStoreHeader* h = mapping->header();
+    SlotPlan emp_plan = planSlots(mapping->empSlots(), h->emp_used, emp_keys, m.emp_lat, m.emp_lon);
+    SlotPlan tar_plan = planSlots(mapping->tarSlots(), h->tar_used, tar_keys, m.tar_lat, m.tar_lon);
+
+    // rewrite the file when the new slots don't fit, or when most of it is stale
+    size_t live_emp = std::count(emp_plan.live.begin(), emp_plan.live.end(), 1);
+    size_t live_tar = std::count(tar_plan.live.begin(), tar_plan.live.end(), 1);
+    bool grow = h->emp_used + emp_plan.missing > h->emp_capacity || h->tar_used + tar_plan.missing > h->tar_capacity;
+    bool compact = (h->emp_used - live_emp) * 2 > h->emp_used || (h->tar_used - live_tar) * 2 > h->tar_used;
+    if (grow || compact) {
+        std::vector<uint32_t> emp_moved_to, tar_moved_to;
+        std::vector<uint32_t> keep_emp = liveSlots(emp_plan, emp_moved_to);
+        std::vector<uint32_t> keep_tar = liveSlots(tar_plan, tar_moved_to);
+
+        uint32_t emp_capacity = std::max<uint32_t>(h->emp_capacity, grownCapacity(live_emp + emp_plan.missing, 64));
+        uint32_t tar_capacity = std::max<uint32_t>(h->tar_capacity, grownCapacity(live_tar + tar_plan.missing, 16));
+        if (!grow) {
+            // only compacting, no need to keep a huge file around either
+            emp_capacity = grownCapacity(live_emp + emp_plan.missing, 64);
+            tar_capacity = grownCapacity(live_tar + tar_plan.missing, 16);
+        }
+
+        std::cout << "rewriting distance store (" << live_emp << "/" << h->emp_used << " employees, " << live_tar << "/" << h->tar_used << " targets still in use)" << std::endl;
+        if (!create(emp_capacity, tar_capacity, keep_emp, keep_tar)) {
+            std::cerr << "can't write distance store " << path << ", computing everything" << std::endl;
+            return compute(employees, targets);
+        }
+        for (auto& s : emp_plan.slot) if (s != NO_SLOT) s = emp_moved_to[s];
+        for (auto& s : tar_plan.slot) if (s != NO_SLOT) s = tar_moved_to[s];
+        h = mapping->header();
+    }
+
+    assignSlots(emp_plan, mapping->empSlots(), h->emp_used, emp_keys, m.emp_lat, m.emp_lon);
+    assignSlots(tar_plan, mapping->tarSlots(), h->tar_used, tar_keys, m.tar_lat, m.tar_lon);
+
+    // fresh employees x the targets that were already there, then every employee x the fresh targets
+    std::vector<Employee> fresh_emps, all_emps;
+    std::vector<uint32_t> fresh_emp_slots, all_emp_slots;
+    for (size_t i = 0; i < employees.size(); ++i) {
+        if (!emp_plan.representative(i)) continue;
+        all_emps.push_back(employees[i]);
+        all_emp_slots.push_back(emp_plan.slot[i]);
+        if (emp_plan.fresh[i]) {
+            fresh_emps.push_back(employees[i]);
+            fresh_emp_slots.push_back(emp_plan.slot[i]);
+        }
+    }
+    std::vector<Target> fresh_tars, old_tars;
+    std::vector<uint32_t> fresh_tar_slots, old_tar_slots;
+    for (size_t j = 0; j < targets.size(); ++j) {
+        if (!tar_plan.representative(j)) continue;
+        (tar_plan.fresh[j] ? fresh_tars : old_tars).push_back(targets[j]);
+        (tar_plan.fresh[j] ? fresh_tar_slots : old_tar_slots).push_back(tar_plan.slot[j]);
+    }
+
+    float* dist = mapping->distances();
+    size_t stride = h->emp_capacity;
+    auto fill = [&](const std::vector<Employee>& emps, const std::vector<uint32_t>& emp_slot_of,
+                    const std::vector<Target>& tars, const std::vector<uint32_t>& tar_slot_of) {
+        if (emps.empty() || tars.empty()) return;
+        DistanceMatrix block = compute(emps, tars);
+        for (size_t t = 0; t < tars.size(); ++t) {
+            float* row = dist + tar_slot_of[t] * stride;
+            for (size_t e = 0; e < emps.size(); ++e) {
+                row[emp_slot_of[e]] = block.at(e, t);
+            }
+        }
+    };
+    fill(fresh_emps, fresh_emp_slots, old_tars, old_tar_slots);
+    fill(all_emps, all_emp_slots, fresh_tars, fresh_tar_slots);
+    msync(mapping->base, mapping->size, MS_ASYNC);
+
+    computed_employees = fresh_emps.size();
+    computed_targets = fresh_tars.size();
+    reused_employees = all_emps.size() - fresh_emps.size();
+    reused_targets = old_tars.size();
+
+    m.mapped = dist;
+    m.mapped_stride = stride;
+    m.emp_slot = emp_plan.slot;
+    m.tar_slot = tar_plan.slot;
+    m.mapping = mapping;
+    return m;
+}
@@ -0,0 +1,56 @@
+#ifndef MATRIXSTORE_H
+#define MATRIXSTORE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "assignment.h"
+
+/* Persistent employee x target distance matrix, memory-mapped so loading it copies nothing.
+Employees are keyed by id and targets by target_number, each gets a slot (a column/row in the file) that
+remembers the lat/lon it was computed for. sync() only computes the distances of new or moved employees
+and new or moved targets, and hands out a DistanceMatrix that reads straight from the mapping.
+Slots nobody uses anymore are dropped once they make up more than half of the file (or when it has to grow).
+
+layout: header, employee slots[emp_capacity], target slots[tar_capacity], then the distances (km) as
+float[tar_capacity][emp_capacity] */
+class MatrixStore {
+public:
+    // what the distances are computed with, e.g. "haversine-float" or "road:graph.bin". a file written with
+    // another provider is thrown away
+    MatrixStore(std::string path, std::string provider);
+    ~MatrixStore();
+
+    // computes the distances between the given employees and targets (a regular, owning matrix)
+    using ComputeFn = std::function<DistanceMatrix(const std::vector<Employee>&, const std::vector<Target>&)>;
+
+    // brings the file up to date for this roster and returns a view into it.
+    // the view stays valid after the store is gone
+    DistanceMatrix sync(const std::vector<Employee>& employees, const std::vector<Target>& targets, const ComputeFn& compute);
+
+    int reusedEmployees() const { return reused_employees; }
+    int reusedTargets() const { return reused_targets; }
+    int computedEmployees() const { return computed_employees; }
+    int computedTargets() const { return computed_targets; }
+
+    struct Mapping;
+    struct Slot;
+
+private:
+    bool open();
+    bool create(uint32_t emp_capacity, uint32_t tar_capacity, const std::vector<uint32_t>& keep_emp, const std::vector<uint32_t>& keep_tar);
+
+    std::string path;
+    std::string provider;
+    std::shared_ptr<Mapping> mapping;
+
+    int reused_employees = 0;
+    int reused_targets = 0;
+    int computed_employees = 0;
+    int computed_targets = 0;
+};
+
+#endif
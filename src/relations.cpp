@@ -0,0 +1,115 @@
+#include "relations.h"
+
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+// sorted, deduplicated pairs -> CSR adjacency with both directions. reuses the buffers graph already has
+static void makeAdjacency(const std::vector<std::pair<int, int>>& pairs, int num_employees, Adjacency& graph)
+{
+    graph.start.assign(num_employees + 1, 0);
+    for (const auto& [a, b] : pairs) {
+        ++graph.start[a + 1];
+        ++graph.start[b + 1];
+    }
+    for (int e = 0; e < num_employees; ++e) {
+        graph.start[e + 1] += graph.start[e];
+    }
+
+    // start[e] is used as the fill position of e, which leaves it at start[e + 1]; shifted back afterwards
+    graph.adj.resize(graph.start[num_employees]);
+    for (const auto& [a, b] : pairs) {
+        graph.adj[graph.start[a]++] = b;
+        graph.adj[graph.start[b]++] = a;
+    }
+    for (int e = num_employees; e > 0; --e) {
+        graph.start[e] = graph.start[e - 1];
+    }
+    graph.start[0] = 0;
+}
+
+static void sortUnique(std::vector<std::pair<int, int>>& pairs)
+{
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+}
+
+RelationGraph buildRelations(const std::vector<Employee>& employees)
+{
+    int num_employees = employees.size();
+
+    // interned names: name -> the employees that have it (nearly always one)
+    std::unordered_map<std::string_view, int> name_ids;
+    std::vector<std::vector<int>> employees_of_name;
+    for (int e = 0; e < num_employees; ++e) {
+        auto [it, inserted] = name_ids.emplace(employees[e].name, employees_of_name.size());
+        if (inserted) employees_of_name.emplace_back();
+        employees_of_name[it->second].push_back(e);
+    }
+
+    RelationGraph relations;
+    std::unordered_map<std::string_view, char> reported;
+    auto resolve = [&](int e, const std::vector<std::string>& names, std::vector<std::pair<int, int>>& pairs) {
+        for (const auto& name : names) {
+            auto it = name_ids.find(name);
+            if (it == name_ids.end()) {
+                if (!reported[name]) {
+                    relations.unknown_names.push_back(name);
+                    reported[name] = 1;
+                }
+                continue;
+            }
+            for (int other : employees_of_name[it->second]) {
+                if (other != e) pairs.emplace_back(std::min(e, other), std::max(e, other));
+            }
+        }
+    };
+
+    for (int e = 0; e < num_employees; ++e) {
+        resolve(e, employees[e].no_pair, relations.conflicts);
+        resolve(e, employees[e].friends, relations.friends);
+    }
+
+    sortUnique(relations.conflicts);
+    sortUnique(relations.friends);
+    makeAdjacency(relations.conflicts, num_employees, relations.conflict_graph);
+    makeAdjacency(relations.friends, num_employees, relations.friend_graph);
+    return relations;
+}
+
+RelationGraph subRelations(const RelationGraph& relations, const std::vector<int>& to_local, int num_local)
+{
+    RelationGraph sub;
+    auto keep = [&](const std::vector<std::pair<int, int>>& pairs, std::vector<std::pair<int, int>>& out) {
+        for (const auto& [a, b] : pairs) {
+            int la = to_local[a];
+            int lb = to_local[b];
+            if (la >= 0 && lb >= 0) out.emplace_back(std::min(la, lb), std::max(la, lb));
+        }
+        sortUnique(out);
+    };
+    keep(relations.conflicts, sub.conflicts);
+    keep(relations.friends, sub.friends);
+    makeAdjacency(sub.conflicts, num_local, sub.conflict_graph);
+    makeAdjacency(sub.friends, num_local, sub.friend_graph);
+    return sub;
+}
+
+void setRelations(RelationGraph& relations, const std::pair<int, int>* conflicts, size_t num_conflicts,
+    const std::pair<int, int>* friends, size_t num_friends, int num_employees)
+{
+    auto normalize = [&](const std::pair<int, int>* pairs, size_t count, std::vector<std::pair<int, int>>& out) {
+        out.clear();
+        for (size_t p = 0; p < count; ++p) {
+            auto [a, b] = pairs[p];
+            if (a == b || a < 0 || b < 0 || a >= num_employees || b >= num_employees) continue;
+            out.emplace_back(std::min(a, b), std::max(a, b));
+        }
+        sortUnique(out);
+    };
+    normalize(conflicts, num_conflicts, relations.conflicts);
+    normalize(friends, num_friends, relations.friends);
+    makeAdjacency(relations.conflicts, num_employees, relations.conflict_graph);
+    makeAdjacency(relations.friends, num_employees, relations.friend_graph);
+    relations.unknown_names.clear();
+}
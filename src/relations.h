@@ -0,0 +1,24 @@
+#ifndef RELATIONS_H
+#define RELATIONS_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "assignment.h"
+
+// resolves everyone's no_pair/friends names to employee indices. every name is looked up once in a table
+// of interned names instead of being compared against all employees. "A hates B" and "B hates A" end up as
+// one conflict, same for friends. a name shared by several employees relates to all of them
+RelationGraph buildRelations(const std::vector<Employee>& employees);
+
+// the relations among a subset of the employees, renumbered: to_local[e] is the new index of employee e
+// or -1 when it's not part of the subset
+RelationGraph subRelations(const RelationGraph& relations, const std::vector<int>& to_local, int num_local);
+
+// relations straight from index pairs (see vrp.h): either order, duplicates, self pairs and out of range indices
+// are fine. fills relations in place, so a graph that is reused keeps its buffers
+void setRelations(RelationGraph& relations, const std::pair<int, int>* conflicts, size_t num_conflicts,
+    const std::pair<int, int>* friends, size_t num_friends, int num_employees);
+
+#endif
@@ -0,0 +1,151 @@
+#include "result.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+const char* statusName(SolveStatus status)
+{
+    switch (status) {
+    case SolveStatus::Optimal:
+        return "optimal";
+    case SolveStatus::Feasible:
+        return "feasible";
+    default:
+        return "not solved";
+    }
+}
+
+// " (mon evening)" for roster targets, nothing otherwise
+static std::string slotSuffix(const Target& tar)
+{
+    std::string slot = tar.day;
+    if (!tar.shift.empty()) {
+        slot += slot.empty() ? tar.shift : " " + tar.shift;
+    }
+    return slot.empty() ? "" : " (" + slot + ")";
+}
+
+void printResult(const AssignmentResult& result, const std::vector<Employee>& employees, const std::vector<Target>& targets, bool quiet)
+{
+    std::ostringstream out;
+    if (!quiet) {
+        for (const auto& pair : result.pairs) {
+            const Target& tar = targets[pair.target];
+            out << "employee " << employees[pair.employee].name << " assigned to Target:" << tar.target_number << slotSuffix(tar)
+                << " - " << tar.address << " (distance = " << pair.km << " km)\n";
+        }
+    }
+    if (!result.pairs.empty()) {
+        out << "longest distance: " << result.longest_km << " km\n";
+        out << "total cost: " << result.total_km << " km\n";
+    }
+    std::cout << out.str() << std::flush;
+}
+
+void writeCsvField(std::ostream& out, const std::string& field)
+{
+    if (field.find_first_of(",\"\n\r") == std::string::npos) {
+        out << field;
+        return;
+    }
+    out << '"';
+    for (char c : field) {
+        if (c == '"') out << '"';
+        out << c;
+    }
+    out << '"';
+}
+
+static std::string formatCsv(const AssignmentResult& result, const std::vector<Employee>& employees, const std::vector<Target>& targets)
+{
+    std::ostringstream out;
+    // the totals of the whole plan are repeated on every row, so the header stays the first line
+    std::ostringstream totals;
+    totals << ',' << result.solver << ',' << statusName(result.status) << ',' << result.gap << ',' << result.total_km << ',' << result.longest_km;
+    out << "employee_id,employee_name,target_number,target_address,target_city,day,shift,distance_km,solver,status,gap,total_km,longest_km\n";
+
+    // every employee gets a row, one per assignment (several in a roster) or one with an empty target.
+    // so an unsolved plan still has the status
+    std::vector<std::vector<const AssignedPair*>> pairs_of(employees.size());
+    for (const auto& pair : result.pairs) {
+        pairs_of[pair.employee].push_back(&pair);
+    }
+    for (size_t e = 0; e < employees.size(); ++e) {
+        const Employee& emp = employees[e];
+        if (pairs_of[e].empty()) {
+            out << emp.id << ',';
+            writeCsvField(out, emp.name);
+            out << ",,,,,," << totals.str() << '\n';
+        }
+        for (const AssignedPair* pair : pairs_of[e]) {
+            const Target& tar = targets[pair->target];
+            out << emp.id << ',';
+            writeCsvField(out, emp.name);
+            out << ',' << tar.target_number << ',';
+            writeCsvField(out, tar.address);
+            out << ',';
+            writeCsvField(out, tar.city);
+            out << ',';
+            writeCsvField(out, tar.day);
+            out << ',';
+            writeCsvField(out, tar.shift);
+            out << ',' << pair->km << totals.str() << '\n';
+        }
+    }
+    return out.str();
+}
+
+json resultJson(const AssignmentResult& result, const std::vector<Employee>& employees, const std::vector<Target>& targets)
+{
+    json assignments = json::array();
+    for (const auto& pair : result.pairs) {
+        const Employee& emp = employees[pair.employee];
+        const Target& tar = targets[pair.target];
+        json entry = {
+            {"employee_id", emp.id},
+            {"employee_name", emp.name},
+            {"target_number", tar.target_number},
+            {"target_address", tar.address},
+            {"target_city", tar.city},
+            {"distance_km", pair.km},
+        };
+        if (!tar.day.empty()) entry["day"] = tar.day;
+        if (!tar.shift.empty()) entry["shift"] = tar.shift;
+        assignments.push_back(std::move(entry));
+    }
+
+    json j = {
+        {"solver", result.solver},
+        {"status", statusName(result.status)},
+        {"gap", result.gap},
+        {"total_km", result.total_km},
+        {"longest_km", result.longest_km},
+        {"stats", {
+            {"variables", result.stats.num_variables},
+            {"constraints", result.stats.num_constraints},
+            {"nodes", result.stats.nodes},
+            {"wall_seconds", result.stats.wall_seconds},
+        }},
+        {"assignments", std::move(assignments)},
+    };
+    return j;
+}
+
+bool writeResult(const std::string& path, const AssignmentResult& result, const std::vector<Employee>& employees, const std::vector<Target>& targets)
+{
+    bool as_json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    std::string document = as_json ? resultJson(result, employees, targets).dump(1) : formatCsv(result, employees, targets);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "can't write " << path << std::endl;
+        return false;
+    }
+    file.write(document.data(), document.size());
+    return file.good();
+}
@@ -0,0 +1,32 @@
+#ifndef RESULT_H
+#define RESULT_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "assignment.h"
+
+/* Output of a finished assignment. Everything is formatted into one buffer and written in one go,
+instead of a flush (std::endl) per line. */
+
+// the assignment on stdout: one line per employee (unless quiet) and the totals
+void printResult(const AssignmentResult& result, const std::vector<Employee>& employees, const std::vector<Target>& targets, bool quiet);
+
+// the assignment as a document, csv or json depending on the extension of path.
+// csv: a header and a row per employee (per assignment in a roster), the target columns empty when it isn't
+// assigned, with the solver, status, gap and totals in the last columns.
+// json: {"solver", "status", "gap", "total_km", "longest_km", "stats", "assignments": [...]}
+bool writeResult(const std::string& path, const AssignmentResult& result, const std::vector<Employee>& employees, const std::vector<Target>& targets);
+
+// the json document writeResult writes, e.g. for the server's responses
+nlohmann::json resultJson(const AssignmentResult& result, const std::vector<Employee>& employees, const std::vector<Target>& targets);
+
+const char* statusName(SolveStatus status);
+
+// quotes a field when it has a separator, quote or newline in it
+void writeCsvField(std::ostream& out, const std::string& field);
+
+#endif
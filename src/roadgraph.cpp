@@ -0,0 +1,528 @@
+#include "roadgraph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <random>
+#include <thread>
+
+#include "candidates.h"
+#include "haversine.h"
+#include "trace.h"
+
+static const char ROAD_GRAPH_MAGIC[8] = {'V', 'R', 'P', 'R', 'O', 'A', 'D', '1'};
+// version 2 added the road count and checksum of the graph to the header
+static const char HIERARCHY_MAGIC[8] = {'V', 'R', 'P', 'C', 'H', '0', '0', '2'};
+
+static const uint32_t UNREACHABLE = std::numeric_limits<uint32_t>::max();
+
+// settled nodes after which a witness search gives up. estimating a node's priority only needs a rough
+// shortcut count, the actual contraction looks harder so it doesn't add shortcuts it doesn't need
+static const int WITNESS_LIMIT_ESTIMATE = 20;
+static const int WITNESS_LIMIT_CONTRACT = 500;
+
+template <typename T>
+static bool readArray(std::ifstream& file, std::vector<T>& out, size_t n)
+{
+    out.resize(n);
+    return n == 0 || file.read(reinterpret_cast<char*>(out.data()), n * sizeof(T)).good();
+}
+
+template <typename T>
+static void writeArray(std::ofstream& file, const std::vector<T>& v)
+{
+    file.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+}
+
+bool loadRoadGraph(const std::string& path, RoadGraph& graph)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    char magic[8];
+    uint32_t num_nodes = 0;
+    uint32_t num_edges = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&num_nodes), sizeof(num_nodes));
+    file.read(reinterpret_cast<char*>(&num_edges), sizeof(num_edges));
+    if (!file || std::memcmp(magic, ROAD_GRAPH_MAGIC, sizeof(magic)) != 0) {
+        std::cerr << path << " is not a road graph" << std::endl;
+        return false;
+    }
+
+    if (!readArray(file, graph.lat, num_nodes) || !readArray(file, graph.lon, num_nodes) || !readArray(file, graph.edges, num_edges)) {
+        std::cerr << path << " is truncated" << std::endl;
+        return false;
+    }
+
+    for (const auto& e : graph.edges) {
+        if (e.from >= num_nodes || e.to >= num_nodes) {
+            std::cerr << path << " has an edge to a node that doesn't exist" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t roadGraphChecksum(const RoadGraph& graph)
+{
+    // fnv-1a over the raw values, a moved junction or a changed road length changes it
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&](uint32_t value) { hash = (hash ^ value) * 1099511628211ull; };
+    mix(graph.numNodes());
+    mix(graph.edges.size());
+    for (size_t v = 0; v < graph.numNodes(); ++v) {
+        uint32_t bits[2];
+        std::memcpy(&bits[0], &graph.lat[v], sizeof(float));
+        std::memcpy(&bits[1], &graph.lon[v], sizeof(float));
+        mix(bits[0]);
+        mix(bits[1]);
+    }
+    for (const auto& e : graph.edges) {
+        mix(e.from);
+        mix(e.to);
+        mix(e.metres);
+    }
+    return hash;
+}
+
+bool saveRoadGraph(const std::string& path, const RoadGraph& graph)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    uint32_t num_nodes = graph.numNodes();
+    uint32_t num_edges = graph.edges.size();
+    file.write(ROAD_GRAPH_MAGIC, sizeof(ROAD_GRAPH_MAGIC));
+    file.write(reinterpret_cast<const char*>(&num_nodes), sizeof(num_nodes));
+    file.write(reinterpret_cast<const char*>(&num_edges), sizeof(num_edges));
+    writeArray(file, graph.lat);
+    writeArray(file, graph.lon);
+    writeArray(file, graph.edges);
+    return file.good();
+}
+
+RoadGraph syntheticRoadGraph(float min_lat, float min_lon, float max_lat, float max_lon, int rows, int cols, unsigned seed)
+{
+    RoadGraph graph;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+    // roads aren't straight, every segment is 0-30% longer than the straight line
+    std::uniform_real_distribution<float> detour(1.0f, 1.3f);
+
+    rows = std::max(rows, 2);
+    cols = std::max(cols, 2);
+    float dlat = (max_lat - min_lat) / (rows - 1);
+    float dlon = (max_lon - min_lon) / (cols - 1);
+
+    // the lake: an ellipse in the middle third of the box without any junctions
+    auto inLake = [&](int r, int c) {
+        float y = (r - (rows - 1) / 2.0f) / (rows / 6.0f);
+        float x = (c - (cols - 1) / 2.0f) / (cols / 6.0f);
+        return x * x + y * y < 1.0f;
+    };
+
+    std::vector<int> node_of((size_t)rows * cols, -1);
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            if (inLake(r, c)) continue;
+            // the border stays put so the box is covered exactly
+            bool border = r == 0 || c == 0 || r == rows - 1 || c == cols - 1;
+            node_of[(size_t)r * cols + c] = graph.lat.size();
+            graph.lat.push_back(min_lat + (r + (border ? 0 : jitter(rng))) * dlat);
+            graph.lon.push_back(min_lon + (c + (border ? 0 : jitter(rng))) * dlon);
+        }
+    }
+
+    auto connect = [&](int a, int b) {
+        if (a < 0 || b < 0) return;
+        float km = haversine(graph.lat[a], graph.lon[a], graph.lat[b], graph.lon[b]);
+        graph.edges.push_back(RoadGraph::Edge{(uint32_t)a, (uint32_t)b, (uint32_t)std::lround(km * 1000.0f * detour(rng))});
+    };
+
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            int v = node_of[(size_t)r * cols + c];
+            if (c + 1 < cols) connect(v, node_of[(size_t)r * cols + c + 1]);
+            if (r + 1 < rows) connect(v, node_of[(size_t)(r + 1) * cols + c]);
+            // the odd diagonal road
+            if (r + 1 < rows && c + 1 < cols && rng() % 4 == 0) connect(v, node_of[(size_t)(r + 1) * cols + c + 1]);
+        }
+    }
+    return graph;
+}
+
+// graph that shrinks while contracting, adjacency only holds the nodes that aren't contracted yet
+struct ContractionGraph {
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> adjacency;
+
+    void addEdge(uint32_t a, uint32_t b, uint32_t metres)
+    {
+        addHalf(a, b, metres);
+        addHalf(b, a, metres);
+    }
+
+    void addHalf(uint32_t from, uint32_t to, uint32_t metres)
+    {
+        for (auto& [other, w] : adjacency[from]) {
+            if (other == to) {
+                w = std::min(w, metres);
+                return;
+            }
+        }
+        adjacency[from].emplace_back(to, metres);
+    }
+
+    void removeHalf(uint32_t from, uint32_t to)
+    {
+        auto& edges = adjacency[from];
+        edges.erase(std::remove_if(edges.begin(), edges.end(), [&](const auto& e) { return e.first == to; }), edges.end());
+    }
+};
+
+// bounded dijkstra that looks for a path around the node being contracted. giving up early at worst
+// adds a shortcut that wasn't needed
+struct WitnessSearch {
+    std::vector<uint32_t> dist;
+    std::vector<uint32_t> touched;
+
+    explicit WitnessSearch(size_t num_nodes) : dist(num_nodes, UNREACHABLE) {}
+
+    void run(const ContractionGraph& graph, uint32_t source, uint32_t skip, uint32_t max_dist, int max_settled)
+    {
+        for (uint32_t v : touched) dist[v] = UNREACHABLE;
+        touched.clear();
+
+        using Item = std::pair<uint32_t, uint32_t>;
+        std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+        dist[source] = 0;
+        touched.push_back(source);
+        queue.emplace(0, source);
+
+        int settled = 0;
+        while (!queue.empty() && settled < max_settled) {
+            auto [d, v] = queue.top();
+            queue.pop();
+            if (d > dist[v]) continue;
+            if (d > max_dist) break;
+            ++settled;
+
+            for (const auto& [w, metres] : graph.adjacency[v]) {
+                if (w == skip) continue;
+                uint32_t nd = d + metres;
+                if (nd < dist[w]) {
+                    if (dist[w] == UNREACHABLE) touched.push_back(w);
+                    dist[w] = nd;
+                    queue.emplace(nd, w);
+                }
+            }
+        }
+    }
+};
+
+// shortcuts contracting v would need, added to the graph if apply is set. returns how many
+static int contractNode(ContractionGraph& graph, WitnessSearch& witness, uint32_t v, bool apply)
+{
+    // copy, adding shortcuts below may touch the neighbours' lists
+    std::vector<std::pair<uint32_t, uint32_t>> neighbours = graph.adjacency[v];
+    uint32_t max_out = 0;
+    for (const auto& n : neighbours) max_out = std::max(max_out, n.second);
+
+    int shortcuts = 0;
+    for (size_t a = 0; a < neighbours.size(); ++a) {
+        auto [u, du] = neighbours[a];
+        witness.run(graph, u, v, du + max_out, apply ? WITNESS_LIMIT_CONTRACT : WITNESS_LIMIT_ESTIMATE);
+
+        for (size_t b = a + 1; b < neighbours.size(); ++b) {
+            auto [w, dw] = neighbours[b];
+            uint32_t via = du + dw;
+            if (witness.dist[w] <= via) continue;
+
+            ++shortcuts;
+            if (apply) graph.addEdge(u, w, via);
+        }
+    }
+    return shortcuts;
+}
+
+ContractionHierarchy::ContractionHierarchy(const RoadGraph& graph)
+    : graph_edges(graph.edges.size()), graph_checksum(roadGraphChecksum(graph))
+{
+    uint32_t num_nodes = graph.numNodes();
+
+    ContractionGraph g;
+    g.adjacency.resize(num_nodes);
+    for (const auto& e : graph.edges) {
+        if (e.from != e.to) g.addEdge(e.from, e.to, e.metres);
+    }
+
+    WitnessSearch witness(num_nodes);
+    std::vector<int> deleted_neighbours(num_nodes, 0);
+    std::vector<int> level(num_nodes, 0);
+    auto priority = [&](uint32_t v) {
+        // edge difference, plus deleted neighbours and level so the contraction spreads evenly over the
+        // map instead of eating one area first (that keeps the searches small)
+        int edge_difference = contractNode(g, witness, v, false) - (int)g.adjacency[v].size();
+        return 2 * edge_difference + deleted_neighbours[v] + level[v];
+    };
+
+    using Item = std::pair<int, uint32_t>;
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+    for (uint32_t v = 0; v < num_nodes; ++v) {
+        queue.emplace(priority(v), v);
+    }
+
+    // upward edges per node, collected while contracting: everything still in the graph ranks higher
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> upward(num_nodes);
+    std::vector<char> contracted(num_nodes, 0);
+
+    while (!queue.empty()) {
+        auto [prio, v] = queue.top();
+        queue.pop();
+        if (contracted[v]) continue;
+
+        // lazy update: the priority may be stale, put it back if it isn't the cheapest anymore
+        int current = priority(v);
+        if (!queue.empty() && current > queue.top().first) {
+            queue.emplace(current, v);
+            continue;
+        }
+
+        contractNode(g, witness, v, true);
+        upward[v] = g.adjacency[v];
+        for (const auto& [u, metres] : g.adjacency[v]) {
+            g.removeHalf(u, v);
+            ++deleted_neighbours[u];
+            level[u] = std::max(level[u], level[v] + 1);
+        }
+        g.adjacency[v].clear();
+        g.adjacency[v].shrink_to_fit();
+        contracted[v] = 1;
+    }
+
+    first_out.assign(num_nodes + 1, 0);
+    for (uint32_t v = 0; v < num_nodes; ++v) {
+        first_out[v + 1] = first_out[v] + upward[v].size();
+    }
+    head.reserve(first_out[num_nodes]);
+    weight.reserve(first_out[num_nodes]);
+    for (uint32_t v = 0; v < num_nodes; ++v) {
+        for (const auto& [w, metres] : upward[v]) {
+            head.push_back(w);
+            weight.push_back(metres);
+        }
+    }
+}
+
+bool ContractionHierarchy::builtFor(const RoadGraph& graph) const
+{
+    return numNodes() == graph.numNodes() && graph_edges == graph.edges.size() && graph_checksum == roadGraphChecksum(graph);
+}
+
+bool ContractionHierarchy::load(const std::string& path, const RoadGraph& graph)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    char magic[8];
+    uint32_t num_nodes = 0;
+    uint32_t num_edges = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&num_nodes), sizeof(num_nodes));
+    file.read(reinterpret_cast<char*>(&num_edges), sizeof(num_edges));
+    file.read(reinterpret_cast<char*>(&graph_edges), sizeof(graph_edges));
+    file.read(reinterpret_cast<char*>(&graph_checksum), sizeof(graph_checksum));
+    if (!file || std::memcmp(magic, HIERARCHY_MAGIC, sizeof(magic)) != 0) {
+        return false;
+    }
+
+    bool complete = readArray(file, first_out, num_nodes + 1) && readArray(file, head, num_edges) && readArray(file, weight, num_edges)
+        && first_out.back() == num_edges;
+    if (complete && !builtFor(graph)) {
+        std::cerr << path << " was built for another version of the road graph" << std::endl;
+        return false;
+    }
+    return complete;
+}
+
+bool ContractionHierarchy::save(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    uint32_t num_nodes = numNodes();
+    uint32_t num_edges = head.size();
+    file.write(HIERARCHY_MAGIC, sizeof(HIERARCHY_MAGIC));
+    file.write(reinterpret_cast<const char*>(&num_nodes), sizeof(num_nodes));
+    file.write(reinterpret_cast<const char*>(&num_edges), sizeof(num_edges));
+    file.write(reinterpret_cast<const char*>(&graph_edges), sizeof(graph_edges));
+    file.write(reinterpret_cast<const char*>(&graph_checksum), sizeof(graph_checksum));
+    writeArray(file, first_out);
+    writeArray(file, head);
+    writeArray(file, weight);
+    return file.good();
+}
+
+void ContractionHierarchy::upwardSearch(uint32_t source, SearchBuffers& buffers, std::vector<std::pair<uint32_t, uint32_t>>& settled) const
+{
+    if (buffers.dist.size() != numNodes()) {
+        buffers.dist.assign(numNodes(), UNREACHABLE);
+    }
+    for (uint32_t v : buffers.touched) buffers.dist[v] = UNREACHABLE;
+    buffers.touched.clear();
+    settled.clear();
+
+    using Item = std::pair<uint32_t, uint32_t>;
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+    buffers.dist[source] = 0;
+    buffers.touched.push_back(source);
+    queue.emplace(0, source);
+
+    while (!queue.empty()) {
+        auto [d, v] = queue.top();
+        queue.pop();
+        if (d > buffers.dist[v]) continue;
+
+        // stall on demand: if a higher ranked neighbour already offers a shorter way to v, d isn't v's real
+        // distance and nothing found from here can be part of a shortest path
+        bool stalled = false;
+        for (uint32_t e = first_out[v]; e < first_out[v + 1] && !stalled; ++e) {
+            uint32_t w = head[e];
+            stalled = buffers.dist[w] != UNREACHABLE && buffers.dist[w] + weight[e] < d;
+        }
+        if (stalled) continue;
+        settled.emplace_back(v, d);
+
+        for (uint32_t e = first_out[v]; e < first_out[v + 1]; ++e) {
+            uint32_t w = head[e];
+            uint32_t nd = d + weight[e];
+            if (nd < buffers.dist[w]) {
+                if (buffers.dist[w] == UNREACHABLE) buffers.touched.push_back(w);
+                buffers.dist[w] = nd;
+                queue.emplace(nd, w);
+            }
+        }
+    }
+}
+
+void ContractionHierarchy::manyToMany(const std::vector<uint32_t>& sources, const std::vector<uint32_t>& targets, std::vector<uint32_t>& out) const
+{
+    size_t num_sources = sources.size();
+    size_t num_targets = targets.size();
+    out.assign(num_sources * num_targets, UNREACHABLE);
+
+    // buckets: for every node, which targets its upward search reached and how far away they are.
+    // roads are undirected, so the "backward" search from a target is an upward search as well
+    struct BucketEntry {
+        uint32_t node;
+        uint32_t target;
+        uint32_t metres;
+    };
+    std::vector<BucketEntry> entries;
+    SearchBuffers buffers;
+    std::vector<std::pair<uint32_t, uint32_t>> settled;
+    for (size_t t = 0; t < num_targets; ++t) {
+        upwardSearch(targets[t], buffers, settled);
+        for (const auto& [v, d] : settled) {
+            entries.push_back(BucketEntry{v, (uint32_t)t, d});
+        }
+    }
+
+    // CSR by node so a forward search can scan the bucket of every node it settles
+    std::vector<uint32_t> bucket_start(numNodes() + 1, 0);
+    for (const auto& entry : entries) ++bucket_start[entry.node + 1];
+    for (size_t v = 0; v < numNodes(); ++v) bucket_start[v + 1] += bucket_start[v];
+    std::vector<std::pair<uint32_t, uint32_t>> buckets(entries.size());
+    {
+        std::vector<uint32_t> fill(bucket_start.begin(), bucket_start.end() - 1);
+        for (const auto& entry : entries) buckets[fill[entry.node]++] = {entry.target, entry.metres};
+    }
+
+    // the forward searches only read the buckets, so they're spread over all cores
+    std::atomic<size_t> next_source{0};
+    auto worker = [&]() {
+        SearchBuffers worker_buffers;
+        std::vector<std::pair<uint32_t, uint32_t>> worker_settled;
+        for (size_t s = next_source++; s < num_sources; s = next_source++) {
+            upwardSearch(sources[s], worker_buffers, worker_settled);
+            for (const auto& [v, d] : worker_settled) {
+                for (uint32_t b = bucket_start[v]; b < bucket_start[v + 1]; ++b) {
+                    const auto& [t, dt] = buckets[b];
+                    uint32_t& best = out[(size_t)t * num_sources + s];
+                    best = std::min(best, d + dt);
+                }
+            }
+        }
+    };
+
+    int num_threads = std::max(1, std::min<int>(std::thread::hardware_concurrency(), num_sources / 64 + 1));
+    std::vector<std::thread> threads;
+    for (int w = 0; w < num_threads; ++w) {
+        threads.emplace_back(worker);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+DistanceMatrix buildRoadDistanceMatrix(const RoadGraph& graph, const ContractionHierarchy& hierarchy,
+    const std::vector<Employee>& employees, const std::vector<Target>& targets)
+{
+    TRACE_SCOPE("road distances");
+    // the haversine matrix fills in the coordinates and is the fallback for pairs without a route
+    DistanceMatrix m = buildDistanceMatrix(employees, targets);
+    if (graph.numNodes() == 0 || !hierarchy.builtFor(graph)) {
+        std::cerr << "road graph and hierarchy don't match, using haversine distances" << std::endl;
+        return m;
+    }
+
+    // snap every location to its nearest junction
+    PreparedPoints nodes = preparePoints(graph.lat, graph.lon, Precision::Single);
+    KdTree tree(nodes);
+    std::vector<int> found;
+    auto snap = [&](const std::vector<float>& lat, const std::vector<float>& lon, std::vector<uint32_t>& node, std::vector<float>& snap_km) {
+        PreparedPoints points = preparePoints(lat, lon, Precision::Single);
+        for (size_t i = 0; i < points.size(); ++i) {
+            tree.nearest(points.xf[i], points.yf[i], points.zf[i], 1, found);
+            node.push_back(found[0]);
+            snap_km.push_back(haversine(lat[i], lon[i], graph.lat[found[0]], graph.lon[found[0]]));
+        }
+    };
+
+    std::vector<uint32_t> emp_nodes, tar_nodes;
+    std::vector<float> emp_snap, tar_snap;
+    snap(m.emp_lat, m.emp_lon, emp_nodes, emp_snap);
+    snap(m.tar_lat, m.tar_lon, tar_nodes, tar_snap);
+
+    std::vector<uint32_t> metres;
+    hierarchy.manyToMany(emp_nodes, tar_nodes, metres);
+
+    size_t unreachable = 0;
+    for (int t = 0; t < m.num_targets; ++t) {
+        for (int e = 0; e < m.num_employees; ++e) {
+            uint32_t route = metres[(size_t)t * m.num_employees + e];
+            if (route == UNREACHABLE) {
+                ++unreachable;
+                continue;
+            }
+            m.dist[(size_t)t * m.num_employees + e] = emp_snap[e] + route / 1000.0f + tar_snap[t];
+        }
+    }
+    if (unreachable > 0) {
+        std::cerr << unreachable << " employee-target pairs aren't connected by the road graph, using haversine for those" << std::endl;
+    }
+    return m;
+}
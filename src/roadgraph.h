@@ -0,0 +1,88 @@
+#ifndef ROADGRAPH_H
+#define ROADGRAPH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "assignment.h"
+
+// road network, undirected. edge lengths in metres.
+// on disk (little endian): "VRPROAD1", uint32 num_nodes, uint32 num_edges, float lat[num_nodes],
+// float lon[num_nodes], then num_edges * {uint32 from, uint32 to, uint32 metres}.
+// an OSM extract has to be converted into this format beforehand (nodes = junctions, edges = road segments)
+struct RoadGraph {
+    struct Edge {
+        uint32_t from;
+        uint32_t to;
+        uint32_t metres;
+    };
+
+    std::vector<float> lat;
+    std::vector<float> lon;
+    std::vector<Edge> edges;
+
+    size_t numNodes() const { return lat.size(); }
+};
+
+bool loadRoadGraph(const std::string& path, RoadGraph& graph);
+bool saveRoadGraph(const std::string& path, const RoadGraph& graph);
+
+// fingerprint of the junctions and roads, a hierarchy remembers the one of the graph it was built for
+uint64_t roadGraphChecksum(const RoadGraph& graph);
+
+// grid of roads over the given box (rows x cols junctions) with a lake in the middle that has to be driven
+// around, for testing without an OSM extract. same seed = same graph
+RoadGraph syntheticRoadGraph(float min_lat, float min_lon, float max_lat, float max_lon, int rows, int cols, unsigned seed = 42);
+
+/* Contraction hierarchy over a RoadGraph. Nodes are contracted one by one (cheapest first, by edge difference),
+adding a shortcut between two neighbours whenever the route through the contracted node is the only shortest
+one. What's left is an "upward" graph where every shortest path goes up in rank and then down again, so a
+search only has to explore a few hundred nodes instead of the whole network.
+Contracting is slow for big graphs, so the result can be saved next to the graph and loaded next time.
+The saved file carries the road count and checksum of its graph, so an edited graph gets a new hierarchy. */
+class ContractionHierarchy {
+public:
+    ContractionHierarchy() = default;
+    explicit ContractionHierarchy(const RoadGraph& graph);
+
+    // false if the file is missing or damaged, or was built for another version of the graph
+    bool load(const std::string& path, const RoadGraph& graph);
+    bool save(const std::string& path) const;
+
+    // whether this hierarchy was contracted from (exactly) this graph
+    bool builtFor(const RoadGraph& graph) const;
+
+    size_t numNodes() const { return first_out.empty() ? 0 : first_out.size() - 1; }
+    size_t numUpwardEdges() const { return head.size(); }
+
+    // many-to-many shortest paths with buckets: one upward search per target fills the buckets of the nodes it
+    // reaches, then one upward search per source scans the buckets it meets.
+    // out[t * sources.size() + s] = metres from sources[s] to targets[t], UINT32_MAX if unreachable
+    void manyToMany(const std::vector<uint32_t>& sources, const std::vector<uint32_t>& targets, std::vector<uint32_t>& out) const;
+
+private:
+    struct SearchBuffers {
+        std::vector<uint32_t> dist;
+        std::vector<uint32_t> touched;
+    };
+
+    // dijkstra over the upward edges only, settled gets (node, metres) of every node reached
+    void upwardSearch(uint32_t source, SearchBuffers& buffers, std::vector<std::pair<uint32_t, uint32_t>>& settled) const;
+
+    // upward graph in CSR form: edges of node v are head/weight[first_out[v] .. first_out[v + 1])
+    std::vector<uint32_t> first_out;
+    std::vector<uint32_t> head;
+    std::vector<uint32_t> weight;
+
+    // of the graph it was built for (see roadGraphChecksum)
+    uint32_t graph_edges = 0;
+    uint64_t graph_checksum = 0;
+};
+
+// distance matrix over the roads: every employee/target is snapped to its nearest junction and the
+// snapping distance is added on both ends. pairs the graph can't connect keep their haversine distance
+DistanceMatrix buildRoadDistanceMatrix(const RoadGraph& graph, const ContractionHierarchy& hierarchy,
+    const std::vector<Employee>& employees, const std::vector<Target>& targets);
+
+#endif
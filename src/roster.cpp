@@ -0,0 +1,241 @@
+#include "roster.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+
+#include "solverlog.h"
+#include "trace.h"
+#include "ortools/linear_solver/linear_solver.h"
+
+std::vector<RosterDay> groupRoster(const std::vector<Target>& targets)
+{
+    std::vector<RosterDay> days;
+    std::unordered_map<std::string, int> day_index;
+
+    for (int j = 0; j < (int)targets.size(); ++j) {
+        const Target& tar = targets[j];
+        if (!day_index.count(tar.day)) {
+            day_index[tar.day] = days.size();
+            days.push_back(RosterDay{tar.day, {}, {}});
+        }
+        RosterDay& day = days[day_index[tar.day]];
+
+        auto shift = std::find(day.shifts.begin(), day.shifts.end(), tar.shift);
+        if (shift == day.shifts.end()) {
+            day.shifts.push_back(tar.shift);
+            day.slots.emplace_back();
+            shift = day.shifts.end() - 1;
+        }
+        day.slots[shift - day.shifts.begin()].push_back(j);
+    }
+    return days;
+}
+
+namespace operations_research {
+// outcome of one day, printed once every day is done so the output doesn't interleave
+struct RosterDayResult {
+    MPSolver::ResultStatus status = MPSolver::NOT_SOLVED;
+    // (employee index, target index) pairs
+    std::vector<std::pair<int, int>> assigned;
+    float km_sum = 0;
+    // relative gap to the best bound when the day stopped early on the time limit or gap
+    double gap = 0;
+    SolverStats stats;
+};
+
+static RosterDayResult solveRosterDay(const RosterDay& day, const DistanceMatrix& distances, const std::vector<Target>& targets,
+    const std::vector<std::pair<int, int>>& conflict_pairs, const std::vector<std::pair<int, int>>& friend_pairs, const SolverOptions& options)
+{
+    int num_employees = distances.num_employees;
+    RosterDayResult result;
+    ScopedTimer timer("roster day");
+    timer.arg("day", day.day);
+
+    // a shift can't need more people than there are
+    for (const auto& slot : day.slots) {
+        int sum = 0;
+        for (int j : slot) sum += targets[j].req_employees;
+        if (sum > num_employees) {
+            result.status = MPSolver::INFEASIBLE;
+            return result;
+        }
+    }
+
+    MPSolver solver("RosterDay", MPSolver::SCIP_MIXED_INTEGER_PROGRAMMING);
+    MPObjective* objective = solver.MutableObjective();
+
+    // x[i][j] = 1 if employee i is assigned to target j (only the targets of this day get variables)
+    std::unordered_map<int, std::vector<const MPVariable*>> x;
+    for (const auto& slot : day.slots) {
+        for (int j : slot) {
+            std::vector<const MPVariable*>& column = x[j];
+            column.resize(num_employees);
+            for (int i = 0; i < num_employees; ++i) {
+                column[i] = solver.MakeIntVar(0, 1, "x_" + std::to_string(i) + "_" + std::to_string(j));
+                objective->SetCoefficient(column[i], distances.at(i, j));
+            }
+        }
+    }
+
+    for (int i = 0; i < num_employees; ++i) {
+        // constraint: each employee is assigned at most once per shift
+        LinearExpr day_expr;
+        for (const auto& slot : day.slots) {
+            LinearExpr expr;
+            for (int j : slot) expr += x[j][i];
+            solver.MakeRowConstraint(expr <= 1);
+            day_expr += expr;
+        }
+        // constraint: and works at most max_shifts_per_day shifts on this day
+        if (options.max_shifts_per_day < (int)day.slots.size()) {
+            solver.MakeRowConstraint(day_expr <= options.max_shifts_per_day);
+        }
+    }
+
+    for (const auto& slot : day.slots) {
+        for (int j : slot) {
+            // constraint: each target has a required number of people that need to be on location
+            LinearExpr expr;
+            for (int i = 0; i < num_employees; ++i) expr += x[j][i];
+            solver.MakeRowConstraint(expr == targets[j].req_employees);
+
+            // constraint: some employees hate one another, don't pair them
+            for (const auto& [first, second] : conflict_pairs) {
+                LinearExpr pair;
+                pair += x[j][first];
+                pair += x[j][second];
+                solver.MakeRowConstraint(pair <= 1);
+            }
+
+            // friends are rewarded for ending up on the same location (y = x1 AND x2)
+            for (const auto& [first, second] : friend_pairs) {
+                const MPVariable* x1 = x[j][first];
+                const MPVariable* x2 = x[j][second];
+                MPVariable* y = solver.MakeIntVar(0, 1, "y_" + std::to_string(first) + "_" + std::to_string(second) + "_" + std::to_string(j));
+
+                // y <= x1, y <= x2
+                MPConstraint* c1 = solver.MakeRowConstraint(-MPSolver::infinity(), 0);
+                c1->SetCoefficient(y, 1);
+                c1->SetCoefficient(x1, -1);
+                MPConstraint* c2 = solver.MakeRowConstraint(-MPSolver::infinity(), 0);
+                c2->SetCoefficient(y, 1);
+                c2->SetCoefficient(x2, -1);
+
+                // y >= x1 + x2 - 1
+                MPConstraint* c3 = solver.MakeRowConstraint(-1, MPSolver::infinity());
+                c3->SetCoefficient(y, 1);
+                c3->SetCoefficient(x1, -1);
+                c3->SetCoefficient(x2, -1);
+
+                objective->SetCoefficient(y, -FAVOR_COEFFICIENT);
+            }
+        }
+    }
+
+    objective->SetMinimization();
+
+    if (options.time_limit_seconds > 0) {
+        solver.SetTimeLimit(absl::Milliseconds(static_cast<int64_t>(options.time_limit_seconds * 1000)));
+    }
+    MPSolverParameters parameters;
+    if (options.relative_gap > 0) {
+        parameters.SetDoubleParam(MPSolverParameters::RELATIVE_MIP_GAP, options.relative_gap);
+    }
+
+    result.status = solver.Solve(parameters);
+    result.stats.num_variables = solver.NumVariables();
+    result.stats.num_constraints = solver.NumConstraints();
+    result.stats.nodes = solver.nodes();
+    result.stats.wall_seconds = solver.wall_time() / 1000.0;
+    if (result.status == MPSolver::FEASIBLE) {
+        double value = objective->Value();
+        result.gap = std::abs(value - objective->BestBound()) / std::max(std::abs(value), 1e-9);
+    }
+    if (result.status == MPSolver::OPTIMAL || result.status == MPSolver::FEASIBLE) {
+        for (const auto& slot : day.slots) {
+            for (int j : slot) {
+                for (int i = 0; i < num_employees; ++i) {
+                    if (x[j][i]->solution_value() > 0.5) {
+                        result.assigned.emplace_back(i, j);
+                        result.km_sum += distances.at(i, j);
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+AssignmentResult assignRoster(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets,
+    const RelationGraph& relations, const SolverOptions& options)
+{
+    std::vector<RosterDay> days = groupRoster(targets);
+    if (options.backend != Backend::Scip || options.pruning.k_nearest > 0 || options.pruning.radius_km > 0) {
+        solverLog() << "the roster is always solved with scip on every employee-target pair, ignoring the backend and pruning options" << std::endl;
+    }
+
+    // every day is an independent model, hand them out to the threads one at a time
+    std::vector<RosterDayResult> results(days.size());
+    std::atomic<size_t> next_day{0};
+    auto worker = [&]() {
+        for (size_t d = next_day++; d < days.size(); d = next_day++) {
+            results[d] = solveRosterDay(days[d], distances, targets, relations.conflicts, relations.friends, options);
+        }
+    };
+
+    int num_threads = options.num_workers > 0 ? options.num_workers : std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::max(1, std::min<int>(num_threads, days.size()));
+    solverLog() << "solving " << days.size() << " day(s) on " << num_threads << " thread(s)..." << std::endl;
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < num_threads; ++w) {
+        threads.emplace_back(worker);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    // optimal only if every day is, a day without a solution leaves the week unsolved (the other days are kept)
+    AssignmentResult week;
+    week.solver = "roster";
+    week.status = SolveStatus::Optimal;
+    for (size_t d = 0; d < days.size(); ++d) {
+        const RosterDayResult& result = results[d];
+        std::string day_name = days[d].day.empty() ? "-" : days[d].day;
+
+        if (result.status != MPSolver::OPTIMAL && result.status != MPSolver::FEASIBLE) {
+            solverLog() << "day " << day_name << ": no solution found..." << std::endl;
+            week.status = SolveStatus::NotSolved;
+            continue;
+        }
+        if (result.status == MPSolver::FEASIBLE && week.status == SolveStatus::Optimal) {
+            week.status = SolveStatus::Feasible;
+        }
+
+        // the week is as far from proven optimal as its worst day
+        week.gap = std::max(week.gap, result.gap);
+
+        solverLog() << "day " << day_name << ": ";
+        if (result.status == MPSolver::OPTIMAL) {
+            solverLog() << "optimal";
+        } else {
+            solverLog() << "feasible (stopped early, gap: " << result.gap * 100.0 << "%)";
+        }
+        solverLog() << ", " << result.assigned.size() << " assignments, " << result.km_sum << " km" << std::endl;
+        for (const auto& [i, j] : result.assigned) {
+            week.add(i, j, distances.at(i, j));
+        }
+
+        // the days ran concurrently, the wall time is that of the slowest one
+        week.stats.num_variables += result.stats.num_variables;
+        week.stats.num_constraints += result.stats.num_constraints;
+        week.stats.nodes += result.stats.nodes;
+        week.stats.wall_seconds = std::max(week.stats.wall_seconds, result.stats.wall_seconds);
+    }
+    return week;
+}
+}
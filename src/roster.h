@@ -0,0 +1,32 @@
+#ifndef ROSTER_H
+#define ROSTER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "assignment.h"
+
+// the targets of one day, split up per shift. indices point into the targets vector (and distance matrix)
+struct RosterDay {
+    std::string day;
+    std::vector<std::string> shifts;
+    // slots[s] = target indices of shifts[s]
+    std::vector<std::vector<int>> slots;
+};
+
+// groups the targets by Target::day and Target::shift, days and shifts in order of first appearance
+std::vector<RosterDay> groupRoster(const std::vector<Target>& targets);
+
+namespace operations_research {
+    /* Plans a whole roster (e.g. a week of evening and night shifts) in one go. All days share the employees
+    and one distance matrix over every target of the week. The shifts of a day are coupled, so each day is
+    one enemies and friends model with an "at most once" row per employee per shift and at most
+    options.max_shifts_per_day shifts per employee. Days don't depend on each other and are solved
+    concurrently (options.num_workers threads, 0 = all cores). The gap of the result is that of the worst day.
+    Always SCIP on every pair: options.backend and options.pruning are ignored (with a notice). */
+    AssignmentResult assignRoster(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets,
+        const RelationGraph& relations, const SolverOptions& options = SolverOptions());
+}
+
+#endif
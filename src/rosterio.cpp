@@ -0,0 +1,440 @@
+#include "rosterio.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#include <nlohmann/json.hpp>
+
+#include "trace.h"
+
+using json = nlohmann::json;
+
+// walks a json list of flat objects ([{...}, {...}]) and hands every field of a record to the subclass.
+// depth 1 is the list, 2 a record, 3 a list inside a record (no_pair/friends), anything deeper is skipped
+class RecordSax : public nlohmann::json_sax<json> {
+public:
+    explicit RecordSax(const std::string& path) : path(path) {}
+
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+    bool number_integer(number_integer_t value) override { return number(value); }
+    bool number_unsigned(number_unsigned_t value) override { return number(value); }
+    bool number_float(number_float_t value, const string_t&) override { return number(std::llround(value)); }
+    bool binary(binary_t&) override { return true; }
+
+    bool string(string_t& value) override
+    {
+        if (depth == 2) {
+            stringField(field, std::move(value));
+        } else if (depth == 3 && in_list) {
+            listItem(field, std::move(value));
+        }
+        return true;
+    }
+
+    bool key(string_t& name) override
+    {
+        if (depth == 2) field = name;
+        return true;
+    }
+
+    bool start_object(std::size_t) override
+    {
+        if (depth == 0) return fail("expected a list of records");
+        if (++depth == 2) {
+            beginRecord();
+        }
+        return true;
+    }
+
+    bool end_object() override
+    {
+        if (depth-- == 2) {
+            std::string missing = endRecord();
+            if (!missing.empty()) {
+                return fail("record " + std::to_string(record) + " misses \"" + missing + "\"");
+            }
+            ++record;
+        }
+        return true;
+    }
+
+    bool start_array(std::size_t) override
+    {
+        in_list = depth == 2;
+        ++depth;
+        return true;
+    }
+
+    bool end_array() override
+    {
+        if (--depth == 2) in_list = false;
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override { return fail(ex.what()); }
+
+    const std::string& error() const { return message; }
+
+protected:
+    virtual void beginRecord() = 0;
+    virtual void integerField(const std::string& name, int64_t value) = 0;
+    virtual void stringField(const std::string& name, std::string&& value) = 0;
+    virtual void listItem(const std::string&, std::string&&) {}
+    // name of the first required field the record doesn't have, empty if it's complete
+    virtual std::string endRecord() = 0;
+
+private:
+    bool number(int64_t value)
+    {
+        if (depth == 2) integerField(field, value);
+        return true;
+    }
+
+    bool fail(const std::string& what)
+    {
+        if (message.empty()) message = path + ": " + what;
+        return false;
+    }
+
+    std::string path;
+    std::string message;
+    std::string field;
+    int depth = 0;
+    bool in_list = false;
+    size_t record = 0;
+};
+
+class EmployeeSax : public RecordSax {
+public:
+    EmployeeSax(const std::string& path, std::vector<Employee>& employees) : RecordSax(path), employees(employees) {}
+
+protected:
+    void beginRecord() override
+    {
+        current = Employee{0, "", "", "", {}, {}, 0, 0};
+        has_id = has_name = has_address = has_city = false;
+    }
+
+    void integerField(const std::string& name, int64_t value) override
+    {
+        if (name == "id") {
+            current.id = value;
+            has_id = true;
+        }
+    }
+
+    void stringField(const std::string& name, std::string&& value) override
+    {
+        if (name == "name") {
+            current.name = std::move(value);
+            has_name = true;
+        } else if (name == "address") {
+            current.address = std::move(value);
+            has_address = true;
+        } else if (name == "city") {
+            current.city = std::move(value);
+            has_city = true;
+        }
+    }
+
+    void listItem(const std::string& name, std::string&& value) override
+    {
+        if (name == "no_pair") {
+            current.no_pair.push_back(std::move(value));
+        } else if (name == "friends") {
+            current.friends.push_back(std::move(value));
+        }
+    }
+
+    std::string endRecord() override
+    {
+        if (!has_id) return "id";
+        if (!has_name) return "name";
+        if (!has_address) return "address";
+        if (!has_city) return "city";
+        employees.push_back(std::move(current));
+        return "";
+    }
+
+private:
+    std::vector<Employee>& employees;
+    Employee current;
+    bool has_id, has_name, has_address, has_city;
+};
+
+class TargetSax : public RecordSax {
+public:
+    TargetSax(const std::string& path, std::vector<Target>& targets) : RecordSax(path), targets(targets) {}
+
+protected:
+    void beginRecord() override
+    {
+        current = Target{0, "", "", "", 0, 0, 0};
+        has_number = has_address = has_city = has_country = has_req = false;
+    }
+
+    void integerField(const std::string& name, int64_t value) override
+    {
+        if (name == "target_number") {
+            current.target_number = value;
+            has_number = true;
+        } else if (name == "req_employees") {
+            current.req_employees = value;
+            has_req = true;
+        }
+    }
+
+    void stringField(const std::string& name, std::string&& value) override
+    {
+        if (name == "address") {
+            current.address = std::move(value);
+            has_address = true;
+        } else if (name == "city") {
+            current.city = std::move(value);
+            has_city = true;
+        } else if (name == "country") {
+            current.country = std::move(value);
+            has_country = true;
+        } else if (name == "day") {
+            current.day = std::move(value);
+        } else if (name == "shift") {
+            current.shift = std::move(value);
+        }
+    }
+
+    std::string endRecord() override
+    {
+        if (!has_number) return "target_number";
+        if (!has_address) return "address";
+        if (!has_city) return "city";
+        if (!has_country) return "country";
+        if (!has_req) return "req_employees";
+        targets.push_back(std::move(current));
+        return "";
+    }
+
+private:
+    std::vector<Target>& targets;
+    Target current;
+    bool has_number, has_address, has_city, has_country, has_req;
+};
+
+static bool parseRecords(const std::string& path, RecordSax& sax)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "can't open " << path << "..." << std::endl;
+        return false;
+    }
+
+    if (!json::sax_parse(file, &sax)) {
+        std::cerr << sax.error() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool loadEmployees(const std::string& path, std::vector<Employee>& employees)
+{
+    TRACE_SCOPE("parse employees");
+    EmployeeSax sax(path, employees);
+    return parseRecords(path, sax);
+}
+
+bool loadTargets(const std::string& path, std::vector<Target>& targets)
+{
+    TRACE_SCOPE("parse targets");
+    TargetSax sax(path, targets);
+    return parseRecords(path, sax);
+}
+
+static const char SNAPSHOT_MAGIC[8] = {'V', 'R', 'P', 'S', 'N', 'A', 'P', 1};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t num_employees;
+    uint32_t num_targets;
+    uint32_t num_refs;
+    uint32_t blob_size;
+};
+
+// strings are offsets into the blob
+struct SnapshotEmployee {
+    int32_t id;
+    float lat;
+    float lon;
+    uint32_t name;
+    uint32_t address;
+    uint32_t city;
+    // no_pair/friends names are refs[begin .. begin + count)
+    uint32_t no_pair_begin;
+    uint32_t no_pair_count;
+    uint32_t friends_begin;
+    uint32_t friends_count;
+};
+
+struct SnapshotTarget {
+    int32_t target_number;
+    int32_t req_employees;
+    float lat;
+    float lon;
+    uint32_t address;
+    uint32_t city;
+    uint32_t country;
+    uint32_t day;
+    uint32_t shift;
+};
+
+// every distinct string is stored once (names show up again in everyone's friends lists)
+class StringBlob {
+public:
+    uint32_t add(const std::string& s)
+    {
+        auto it = offsets.find(s);
+        if (it != offsets.end()) return it->second;
+
+        uint32_t offset = blob.size();
+        blob.insert(blob.end(), s.begin(), s.end());
+        blob.push_back('\0');
+        offsets.emplace(s, offset);
+        return offset;
+    }
+
+    const std::vector<char>& data() const { return blob; }
+
+private:
+    std::vector<char> blob;
+    std::unordered_map<std::string, uint32_t> offsets;
+};
+
+bool saveSnapshot(const std::string& path, const std::vector<Employee>& employees, const std::vector<Target>& targets)
+{
+    StringBlob blob;
+    std::vector<uint32_t> refs;
+    std::vector<SnapshotEmployee> emp_records;
+    std::vector<SnapshotTarget> tar_records;
+
+    for (const auto& emp : employees) {
+        SnapshotEmployee r{emp.id, emp.lat, emp.lon, blob.add(emp.name), blob.add(emp.address), blob.add(emp.city), 0, 0, 0, 0};
+        r.no_pair_begin = refs.size();
+        r.no_pair_count = emp.no_pair.size();
+        for (const auto& name : emp.no_pair) refs.push_back(blob.add(name));
+        r.friends_begin = refs.size();
+        r.friends_count = emp.friends.size();
+        for (const auto& name : emp.friends) refs.push_back(blob.add(name));
+        emp_records.push_back(r);
+    }
+    for (const auto& tar : targets) {
+        tar_records.push_back(SnapshotTarget{tar.target_number, tar.req_employees, tar.lat, tar.lon,
+            blob.add(tar.address), blob.add(tar.city), blob.add(tar.country), blob.add(tar.day), blob.add(tar.shift)});
+    }
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.num_employees = emp_records.size();
+    header.num_targets = tar_records.size();
+    header.num_refs = refs.size();
+    header.blob_size = blob.data().size();
+
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(emp_records.data()), emp_records.size() * sizeof(SnapshotEmployee));
+        file.write(reinterpret_cast<const char*>(tar_records.data()), tar_records.size() * sizeof(SnapshotTarget));
+        file.write(reinterpret_cast<const char*>(refs.data()), refs.size() * sizeof(uint32_t));
+        file.write(blob.data().data(), blob.data().size());
+        if (!file.good()) {
+            return false;
+        }
+    }
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+bool loadSnapshot(const std::string& path, std::vector<Employee>& employees, std::vector<Target>& targets)
+{
+    TRACE_SCOPE("load snapshot");
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cerr << "can't open " << path << "..." << std::endl;
+        return false;
+    }
+
+    // one read for the whole file
+    std::vector<char> data(file.tellg());
+    file.seekg(0);
+    if (!file.read(data.data(), data.size()) || data.size() < sizeof(SnapshotHeader)) {
+        std::cerr << path << " is truncated" << std::endl;
+        return false;
+    }
+
+    SnapshotHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        std::cerr << path << " is not a roster snapshot (or one of another version)" << std::endl;
+        return false;
+    }
+
+    size_t emp_offset = sizeof(SnapshotHeader);
+    size_t tar_offset = emp_offset + (size_t)header.num_employees * sizeof(SnapshotEmployee);
+    size_t refs_offset = tar_offset + (size_t)header.num_targets * sizeof(SnapshotTarget);
+    size_t blob_offset = refs_offset + (size_t)header.num_refs * sizeof(uint32_t);
+    if (blob_offset + header.blob_size != data.size() || (header.blob_size > 0 && data.back() != '\0')) {
+        std::cerr << path << " is damaged" << std::endl;
+        return false;
+    }
+
+    const char* blob = data.data() + blob_offset;
+    std::vector<uint32_t> refs(header.num_refs);
+    std::memcpy(refs.data(), data.data() + refs_offset, refs.size() * sizeof(uint32_t));
+
+    bool valid = true;
+    auto str = [&](uint32_t offset) {
+        if (offset >= header.blob_size) {
+            valid = false;
+            return std::string();
+        }
+        return std::string(blob + offset);
+    };
+    auto names = [&](uint32_t begin, uint32_t count) {
+        std::vector<std::string> out;
+        if ((size_t)begin + count > refs.size()) {
+            valid = false;
+            return out;
+        }
+        for (uint32_t k = 0; k < count; ++k) out.push_back(str(refs[begin + k]));
+        return out;
+    };
+
+    employees.clear();
+    employees.reserve(header.num_employees);
+    for (uint32_t i = 0; i < header.num_employees; ++i) {
+        SnapshotEmployee r;
+        std::memcpy(&r, data.data() + emp_offset + i * sizeof(SnapshotEmployee), sizeof(r));
+        employees.push_back(Employee{r.id, str(r.name), str(r.address), str(r.city),
+            names(r.no_pair_begin, r.no_pair_count), names(r.friends_begin, r.friends_count), r.lon, r.lat});
+    }
+
+    targets.clear();
+    targets.reserve(header.num_targets);
+    for (uint32_t j = 0; j < header.num_targets; ++j) {
+        SnapshotTarget r;
+        std::memcpy(&r, data.data() + tar_offset + j * sizeof(SnapshotTarget), sizeof(r));
+        Target tar{r.target_number, str(r.address), str(r.city), str(r.country), r.req_employees, r.lon, r.lat};
+        tar.day = str(r.day);
+        tar.shift = str(r.shift);
+        targets.push_back(std::move(tar));
+    }
+
+    if (!valid) {
+        std::cerr << path << " is damaged" << std::endl;
+    }
+    return valid;
+}
@@ -0,0 +1,22 @@
+#ifndef ROSTERIO_H
+#define ROSTERIO_H
+
+#include <string>
+#include <vector>
+
+#include "assignment.h"
+
+// streaming (SAX) loaders for the employee/target json files: the records go straight into the structs
+// without building a json document first. false (and a message on stderr) if the file can't be read,
+// isn't valid json or a record misses a required field
+bool loadEmployees(const std::string& path, std::vector<Employee>& employees);
+bool loadTargets(const std::string& path, std::vector<Target>& targets);
+
+/* Binary snapshot of a geocoded roster (employees + targets, coordinates included), so a big roster
+doesn't have to be parsed and looked up again. The whole file is read in one go.
+layout: "VRPSNAP" + version byte, uint32 num_employees, num_targets, num_refs, blob_size, then the
+employee and target records, the no_pair/friends name references and a blob of NUL-terminated strings */
+bool saveSnapshot(const std::string& path, const std::vector<Employee>& employees, const std::vector<Target>& targets);
+bool loadSnapshot(const std::string& path, std::vector<Employee>& employees, std::vector<Target>& targets);
+
+#endif
@@ -0,0 +1,336 @@
+#include "scenario.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include "haversine.h"
+#include "relations.h"
+#include "result.h"
+#include "solverlog.h"
+#include "trace.h"
+
+using json = nlohmann::json;
+
+bool parseScenarios(const json& items, const std::vector<Employee>& employees, const std::vector<Target>& targets,
+    std::vector<Scenario>& scenarios, std::string& error)
+{
+    std::unordered_map<int, int> employee_index;
+    for (size_t e = 0; e < employees.size(); ++e) {
+        employee_index[employees[e].id] = e;
+    }
+    std::unordered_map<int, int> target_index;
+    for (size_t t = 0; t < targets.size(); ++t) {
+        target_index[targets[t].target_number] = t;
+    }
+    auto findEmployee = [&](const json& id, int& index) {
+        auto it = id.is_number_integer() ? employee_index.find(id.get<int>()) : employee_index.end();
+        if (it == employee_index.end()) {
+            error = "unknown employee id " + id.dump();
+            return false;
+        }
+        index = it->second;
+        return true;
+    };
+
+    if (!items.is_array()) {
+        error = "scenarios should be a json array";
+        return false;
+    }
+    for (const auto& item : items) {
+        Scenario scenario;
+        scenario.name = item.value("name", "scenario " + std::to_string(scenarios.size() + 1));
+
+        for (const auto& change : item.value("changes", json::array())) {
+            std::string op = change.value("op", "");
+            if (op == "remove_employee") {
+                int index;
+                if (!findEmployee(change.value("id", json()), index)) return false;
+                scenario.removed.push_back(index);
+            } else if (op == "set_requirement") {
+                auto it = target_index.find(change.value("target_number", -1));
+                if (it == target_index.end()) {
+                    error = "unknown target_number " + change.value("target_number", json()).dump();
+                    return false;
+                }
+                json req = change.value("req_employees", json());
+                if (!req.is_number_integer() || req.get<int>() < 0) {
+                    error = "invalid req_employees " + req.dump() + " for target_number " + change.value("target_number", json()).dump();
+                    return false;
+                }
+                scenario.requirements.emplace_back(it->second, req.get<int>());
+            } else if (op == "add_conflict") {
+                json ids = change.value("ids", json());
+                int first, second;
+                if (!ids.is_array() || ids.size() != 2) {
+                    error = "add_conflict needs two ids";
+                    return false;
+                }
+                if (!findEmployee(ids[0], first) || !findEmployee(ids[1], second)) return false;
+                scenario.conflicts.emplace_back(first, second);
+            } else {
+                error = "unknown op \"" + op + "\" in scenario \"" + scenario.name + "\"";
+                return false;
+            }
+        }
+        scenarios.push_back(std::move(scenario));
+    }
+    return true;
+}
+
+std::vector<Scenario> employeeScenarios(const AssignmentResult& base, const std::vector<Employee>& employees)
+{
+    std::vector<Scenario> scenarios;
+    for (const auto& pair : base.pairs) {
+        const Employee& emp = employees[pair.employee];
+        Scenario scenario;
+        scenario.name = "without " + emp.name + " (" + std::to_string(emp.id) + ")";
+        scenario.removed.push_back(pair.employee);
+        scenarios.push_back(std::move(scenario));
+    }
+    return scenarios;
+}
+
+std::vector<Scenario> targetScenarios(const std::vector<Target>& targets)
+{
+    std::vector<Scenario> scenarios;
+    for (size_t t = 0; t < targets.size(); ++t) {
+        Scenario scenario;
+        scenario.name = "target " + std::to_string(targets[t].target_number) + " +1";
+        scenario.requirements.emplace_back(t, targets[t].req_employees + 1);
+        scenarios.push_back(std::move(scenario));
+    }
+    return scenarios;
+}
+
+namespace operations_research {
+// false when some day/shift needs more people than are left (a one-off plan is a single slot)
+static bool enoughEmployees(const std::vector<Target>& targets, int available, std::string& error)
+{
+    std::map<std::pair<std::string, std::string>, int> required;
+    for (const auto& tar : targets) {
+        required[{tar.day, tar.shift}] += tar.req_employees;
+    }
+    for (const auto& [slot, count] : required) {
+        if (count > available) {
+            error = "not enough employees: " + std::to_string(count) + " required, " + std::to_string(available) + " available";
+            return false;
+        }
+    }
+    return true;
+}
+
+static ScenarioOutcome solveScenario(const Scenario& scenario, const DistanceMatrix& distances, const std::vector<Employee>& employees,
+    const std::vector<Target>& targets, const RelationGraph& relations, const std::vector<int>& base_target_of,
+    const SolverOptions& options, const ScenarioOptions& scenario_options, const AssignFn& solve)
+{
+    TRACE_SCOPE("scenario");
+    auto started = std::chrono::steady_clock::now();
+    ScenarioOutcome outcome;
+    int num_employees = employees.size();
+
+    std::vector<Target> scenario_targets = targets;
+    for (const auto& [t, req] : scenario.requirements) {
+        scenario_targets[t].req_employees = req;
+    }
+
+    std::vector<char> off(num_employees, 0);
+    for (int e : scenario.removed) {
+        off[e] = 1;
+    }
+    std::vector<int> emp_index;
+    std::vector<int> to_local(num_employees, -1);
+    std::vector<Employee> available;
+    for (int e = 0; e < num_employees; ++e) {
+        if (off[e]) continue;
+        to_local[e] = emp_index.size();
+        emp_index.push_back(e);
+        available.push_back(employees[e]);
+    }
+
+    // the base matrix and relations as long as nobody is missing / no enemies were added
+    DistanceMatrix sub;
+    const DistanceMatrix* scenario_distances = &distances;
+    if (!scenario.removed.empty()) {
+        std::vector<int> all_targets(targets.size());
+        std::iota(all_targets.begin(), all_targets.end(), 0);
+        sub = subMatrix(distances, emp_index, all_targets);
+        scenario_distances = &sub;
+    }
+    RelationGraph sub_relations;
+    const RelationGraph* scenario_relations = &relations;
+    if (!scenario.removed.empty() || !scenario.conflicts.empty()) {
+        sub_relations = subRelations(relations, to_local, emp_index.size());
+        std::vector<std::pair<int, int>> conflicts = sub_relations.conflicts;
+        std::vector<std::pair<int, int>> friends = sub_relations.friends;
+        for (const auto& [a, b] : scenario.conflicts) {
+            if (to_local[a] >= 0 && to_local[b] >= 0) conflicts.emplace_back(to_local[a], to_local[b]);
+        }
+        setRelations(sub_relations, conflicts.data(), conflicts.size(), friends.data(), friends.size(), emp_index.size());
+        scenario_relations = &sub_relations;
+    }
+
+    if (enoughEmployees(scenario_targets, emp_index.size(), outcome.error)) {
+        SolverOptions scenario_solver = options;
+        scenario_solver.hint.clear();
+        if (scenario_options.warm_start) {
+            // the base plan for whoever is still there, no more per target than it needs now
+            std::vector<int> staffed(targets.size(), 0);
+            for (int e = 0; e < num_employees; ++e) {
+                int t = base_target_of[e];
+                if (t < 0 || to_local[e] < 0 || staffed[t] >= scenario_targets[t].req_employees) continue;
+                ++staffed[t];
+                scenario_solver.hint.emplace_back(to_local[e], t);
+            }
+        }
+
+        AssignmentResult local = solve(*scenario_distances, available, scenario_targets, *scenario_relations, scenario_solver);
+        outcome.result = local;
+        outcome.result.pairs.clear();
+        for (const auto& pair : local.pairs) {
+            outcome.result.pairs.push_back({emp_index[pair.employee], pair.target, pair.km});
+        }
+        if (!outcome.result.solved()) {
+            outcome.error = "no solution found";
+        }
+    }
+
+    if (outcome.result.solved()) {
+        std::vector<int> target_of(num_employees, -1);
+        for (const auto& pair : outcome.result.pairs) {
+            target_of[pair.employee] = pair.target;
+        }
+        for (int e = 0; e < num_employees; ++e) {
+            if (target_of[e] != base_target_of[e]) ++outcome.moved;
+        }
+    }
+    outcome.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return outcome;
+}
+
+std::vector<ScenarioOutcome> runScenarios(const DistanceMatrix& distances, const std::vector<Employee>& employees,
+    const std::vector<Target>& targets, const RelationGraph& relations, const AssignmentResult& base,
+    const std::vector<Scenario>& scenarios, const SolverOptions& options, const ScenarioOptions& scenario_options, const AssignFn& solve)
+{
+    std::vector<ScenarioOutcome> outcomes(scenarios.size());
+    if (scenarios.empty()) return outcomes;
+
+    std::vector<int> base_target_of(employees.size(), -1);
+    for (const auto& pair : base.pairs) {
+        base_target_of[pair.employee] = pair.target;
+    }
+
+    // the scenarios run side by side, so each one gets a single solver thread and nobody streams incumbents
+    SolverOptions scenario_solver = options;
+    scenario_solver.num_workers = 1;
+    scenario_solver.on_incumbent = nullptr;
+
+    // every worker takes the next scenario nobody has started yet
+    std::atomic<size_t> next_scenario{0};
+    auto worker = [&]() {
+        for (size_t s = next_scenario++; s < scenarios.size(); s = next_scenario++) {
+            outcomes[s] = solveScenario(scenarios[s], distances, employees, targets, relations, base_target_of, scenario_solver, scenario_options, solve);
+        }
+    };
+
+    int num_threads = scenario_options.workers > 0 ? scenario_options.workers : std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::max(1, std::min<int>(num_threads, scenarios.size()));
+    solverLog() << "solving " << scenarios.size() << " scenario(s) on " << num_threads << " thread(s)..." << std::endl;
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < num_threads; ++w) {
+        threads.emplace_back(worker);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return outcomes;
+}
+}
+
+// the scenarios by impact: the ones without a solution first, then the biggest increase in km
+static std::vector<size_t> byImpact(const std::vector<ScenarioOutcome>& outcomes)
+{
+    std::vector<size_t> order(outcomes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        bool solved_a = outcomes[a].result.solved();
+        bool solved_b = outcomes[b].result.solved();
+        if (solved_a != solved_b) return !solved_a;
+        return outcomes[a].result.total_km > outcomes[b].result.total_km;
+    });
+    return order;
+}
+
+void printScenarioTable(const AssignmentResult& base, const std::vector<Scenario>& scenarios, const std::vector<ScenarioOutcome>& outcomes)
+{
+    size_t name_width = 8;
+    for (const auto& scenario : scenarios) {
+        name_width = std::max(name_width, scenario.name.size());
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    out << std::left << std::setw(name_width) << "scenario" << std::right << std::setw(12) << "status" << std::setw(12) << "total km"
+        << std::setw(11) << "delta km" << std::setw(10) << "delta %" << std::setw(12) << "longest km" << std::setw(7) << "moved"
+        << std::setw(10) << "seconds" << "\n";
+    out << std::left << std::setw(name_width) << "base" << std::right << std::setw(12) << statusName(base.status) << std::setw(12)
+        << base.total_km << std::setw(11) << "" << std::setw(10) << "" << std::setw(12) << base.longest_km << "\n";
+
+    for (size_t s : byImpact(outcomes)) {
+        const ScenarioOutcome& outcome = outcomes[s];
+        out << std::left << std::setw(name_width) << scenarios[s].name << std::right << std::setw(12) << statusName(outcome.result.status);
+        if (!outcome.result.solved()) {
+            out << "  " << outcome.error << "\n";
+            continue;
+        }
+        double delta = outcome.result.total_km - base.total_km;
+        std::ostringstream delta_km, delta_pct;
+        delta_km << std::fixed << std::setprecision(2) << std::showpos << delta;
+        delta_pct << std::fixed << std::setprecision(2) << std::showpos << 100.0 * delta / std::max(base.total_km, 1e-9) << "%";
+        out << std::setw(12) << outcome.result.total_km << std::setw(11) << delta_km.str() << std::setw(10) << delta_pct.str()
+            << std::setw(12) << outcome.result.longest_km << std::setw(7) << outcome.moved << std::setw(10) << outcome.seconds << "\n";
+    }
+    std::cout << out.str() << std::flush;
+}
+
+bool writeScenarioTable(const std::string& path, const AssignmentResult& base, const std::vector<Scenario>& scenarios,
+    const std::vector<ScenarioOutcome>& outcomes)
+{
+    std::ostringstream out;
+    out << "scenario,status,total_km,delta_km,delta_pct,longest_km,moved,seconds,error\n";
+    // the plan the deltas are against, as the first row
+    out << "base," << statusName(base.status) << ',' << base.total_km << ",0,0," << base.longest_km << ",0,,\n";
+    for (size_t s : byImpact(outcomes)) {
+        const ScenarioOutcome& outcome = outcomes[s];
+        writeCsvField(out, scenarios[s].name);
+        out << ',' << statusName(outcome.result.status) << ',';
+        if (outcome.result.solved()) {
+            double delta = outcome.result.total_km - base.total_km;
+            out << outcome.result.total_km << ',' << delta << ',' << 100.0 * delta / std::max(base.total_km, 1e-9) << ','
+                << outcome.result.longest_km << ',' << outcome.moved;
+        } else {
+            out << ",,,,";
+        }
+        out << ',' << outcome.seconds << ',';
+        writeCsvField(out, outcome.error);
+        out << '\n';
+    }
+
+    std::string document = out.str();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "can't write " << path << std::endl;
+        return false;
+    }
+    file.write(document.data(), document.size());
+    return file.good();
+}
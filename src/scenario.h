@@ -0,0 +1,71 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "assignment.h"
+#include "decompose.h"
+
+// one what-if on top of the base instance, everything by index into the base employees/targets
+struct Scenario {
+    std::string name;
+    // employees that aren't available
+    std::vector<int> removed;
+    // (target, req_employees) for targets that need a different number of people
+    std::vector<std::pair<int, int>> requirements;
+    // pairs of employees that can't work on the same target anymore
+    std::vector<std::pair<int, int>> conflicts;
+};
+
+// how a scenario came out, next to the base plan
+struct ScenarioOutcome {
+    AssignmentResult result;
+    // employees that are on another target than in the base plan (or weren't / aren't assigned anymore)
+    int moved = 0;
+    double seconds = 0;
+    // why it wasn't solved, e.g. not enough employees left
+    std::string error;
+};
+
+struct ScenarioOptions {
+    // scenarios solved at the same time, one solver thread each. 0 = all cores
+    int workers = 0;
+    // start every model from the base plan minus what the scenario changed (SolverOptions::hint)
+    bool warm_start = true;
+};
+
+// scenarios from json with the ops remove_employee and set_requirement (as in the --changes files) and
+// add_conflict (only here, adding or removing targets isn't supported), e.g.
+// [{"name": "Jan off", "changes": [{"op": "remove_employee", "id": 7}]},
+//  {"name": "3 needs one more", "changes": [{"op": "set_requirement", "target_number": 3, "req_employees": 4}]},
+//  {"changes": [{"op": "add_conflict", "ids": [7, 12]}]}]
+// false (with the reason in error) for unknown ops, ids or target numbers and negative requirements
+bool parseScenarios(const nlohmann::json& items, const std::vector<Employee>& employees, const std::vector<Target>& targets,
+    std::vector<Scenario>& scenarios, std::string& error);
+
+// "what if this one is off" for every employee the base plan uses (the others wouldn't change anything)
+std::vector<Scenario> employeeScenarios(const AssignmentResult& base, const std::vector<Employee>& employees);
+// "what if this target needs one more" for every target
+std::vector<Scenario> targetScenarios(const std::vector<Target>& targets);
+
+namespace operations_research {
+    /* Solves every scenario as its own instance on a pool of workers that take the next unsolved scenario
+    as soon as they're done with one, so a few slow scenarios don't hold up the rest. The base distances,
+    employees and relations are only read; a scenario without removals solves straight on the base matrix,
+    one with removals on a copy of the remaining rows. Outcomes are in the order of the scenarios. */
+    std::vector<ScenarioOutcome> runScenarios(const DistanceMatrix& distances, const std::vector<Employee>& employees,
+        const std::vector<Target>& targets, const RelationGraph& relations, const AssignmentResult& base,
+        const std::vector<Scenario>& scenarios, const SolverOptions& options, const ScenarioOptions& scenario_options, const AssignFn& solve);
+}
+
+// the cost-delta table on stdout: status, total km and the change against the base plan per scenario
+void printScenarioTable(const AssignmentResult& base, const std::vector<Scenario>& scenarios, const std::vector<ScenarioOutcome>& outcomes);
+// the same table as csv, header first and the base plan as the first row
+bool writeScenarioTable(const std::string& path, const AssignmentResult& base, const std::vector<Scenario>& scenarios,
+    const std::vector<ScenarioOutcome>& outcomes);
+
+#endif
@@ -0,0 +1,638 @@
+#include "server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "haversine.h"
+#include "relations.h"
+#include "result.h"
+
+using json = nlohmann::json;
+
+// biggest request body we take, a week of targets is far below this
+static const size_t MAX_REQUEST_BYTES = 64 << 20;
+
+static std::atomic<bool> stop_requested{false};
+
+static void requestStop(int)
+{
+    stop_requested = true;
+}
+
+static int listenUnix(const std::string& path)
+{
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "socket path too long: " << path << std::endl;
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    // a socket file left behind by a previous run would make bind fail
+    unlink(path.c_str());
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 64) < 0) {
+        std::cerr << "can't listen on " << path << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// only on 127.0.0.1, there's no authentication whatsoever
+static int listenTcp(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 64) < 0) {
+        std::cerr << "can't listen on 127.0.0.1:" << port << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static json errorResponse(const json& id, const std::string& message)
+{
+    return {{"id", id}, {"error", message}};
+}
+
+// the subset of the employees that is available, with the matrix and relations to match
+struct Availability {
+    std::vector<int> emp_index;
+    std::vector<Employee> employees;
+    DistanceMatrix distances;
+    RelationGraph relations;
+};
+
+static json handleAssign(const json& request, const ServerContext& context)
+{
+    auto started = std::chrono::steady_clock::now();
+    json id = request.value("id", json());
+
+    std::string mode = request.value("mode", context.default_mode);
+    if (mode != "shortest" && mode != "balanced" && mode != "friends" && mode != "roster") {
+        return errorResponse(id, "unknown mode: " + mode);
+    }
+
+    SolverOptions options = context.defaults;
+    // the incumbents of concurrent requests would only end up mixed on the console
+    options.on_incumbent = nullptr;
+    if (request.contains("backend")) {
+        std::string backend = request["backend"].get<std::string>();
+        if (backend != "scip" && backend != "cpsat") {
+            return errorResponse(id, "unknown backend: " + backend);
+        }
+        options.backend = backend == "cpsat" ? Backend::CpSat : Backend::Scip;
+    }
+    options.time_limit_seconds = request.value("time_limit", options.time_limit_seconds);
+    options.relative_gap = request.value("gap", options.relative_gap);
+    options.pruning.k_nearest = request.value("k_nearest", options.pruning.k_nearest);
+    options.pruning.radius_km = request.value("radius_km", options.pruning.radius_km);
+
+    // the request's own targets (e.g. tonight's locations) or the ones loaded at startup
+    std::vector<Target> targets;
+    DistanceMatrix loaded_distances;
+    const DistanceMatrix* distances = &context.distances;
+    if (request.contains("targets")) {
+        std::string error;
+        if (!context.load_targets(request["targets"], targets, loaded_distances, error)) {
+            return errorResponse(id, error);
+        }
+        distances = &loaded_distances;
+    } else {
+        targets = context.targets;
+    }
+
+    std::unordered_set<int> unavailable;
+    if (request.contains("unavailable")) {
+        for (const auto& emp_id : request["unavailable"]) unavailable.insert(emp_id.get<int>());
+    }
+
+    // only copied when someone is missing, otherwise the resident matrix is used as is
+    Availability available;
+    std::vector<int> to_local(context.employees.size(), -1);
+    for (size_t e = 0; e < context.employees.size(); ++e) {
+        if (unavailable.count(context.employees[e].id)) continue;
+        to_local[e] = available.emp_index.size();
+        available.emp_index.push_back(e);
+        available.employees.push_back(context.employees[e]);
+    }
+    const RelationGraph* relations = &context.relations;
+    if (!unavailable.empty()) {
+        std::vector<int> all_targets(targets.size());
+        for (size_t t = 0; t < targets.size(); ++t) all_targets[t] = t;
+        available.distances = subMatrix(*distances, available.emp_index, all_targets);
+        available.relations = subRelations(context.relations, to_local, available.emp_index.size());
+        distances = &available.distances;
+        relations = &available.relations;
+    }
+
+    // a roster only needs enough people per shift, the solver checks that per day
+    int required = 0;
+    for (const auto& tar : targets) required += tar.req_employees;
+    if (mode != "roster" && required > (int)available.employees.size()) {
+        return errorResponse(id, "not enough employees: " + std::to_string(required) + " required, " +
+            std::to_string(available.employees.size()) + " available");
+    }
+
+    AssignmentResult result = context.solve(mode, *distances, available.employees, targets, *relations, options);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "request " << id.dump() << ": " << mode << ", " << targets.size() << " targets, " << statusName(result.status)
+              << ", " << result.total_km << " km in " << seconds << " s" << std::endl;
+    if (!result.solved()) {
+        return errorResponse(id, "no solution found");
+    }
+
+    json response = resultJson(result, available.employees, targets);
+    response["id"] = id;
+    response["seconds"] = seconds;
+    return response;
+}
+
+static json handleRequest(const json& request, const ServerContext& context)
+{
+    if (!request.is_object()) {
+        return errorResponse(json(), "a request has to be a json object");
+    }
+    std::string op = request.value("op", "assign");
+    try {
+        if (op == "status") {
+            return {
+                {"id", request.value("id", json())},
+                {"employees", context.employees.size()},
+                {"targets", context.targets.size()},
+                {"conflicts", context.relations.conflicts.size()},
+                {"friends", context.relations.friends.size()},
+            };
+        }
+        if (op == "assign") {
+            return handleAssign(request, context);
+        }
+        return errorResponse(request.value("id", json()), "unknown op: " + op);
+    } catch (const json::exception& e) {
+        // a field of the wrong type
+        return errorResponse(request.value("id", json()), e.what());
+    } catch (const std::exception& e) {
+        // e.g. out of memory in the solver, that request fails but the server keeps running
+        return errorResponse(request.value("id", json()), std::string("request failed: ") + e.what());
+    }
+}
+
+static std::string httpResponse(const std::string& status, const json& body, const std::string& extra_headers = "")
+{
+    std::string text = body.dump();
+    return "HTTP/1.1 " + status + "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(text.size()) +
+        "\r\n" + extra_headers + "Connection: close\r\n\r\n" + text;
+}
+
+// a parsed request on its way to a worker, and its answer on the way back
+struct Job {
+    uint64_t client;
+    json request;
+    bool http;
+};
+struct Answer {
+    uint64_t client;
+    std::string data;
+};
+
+// parsed requests waiting for a worker
+class RequestQueue {
+public:
+    explicit RequestQueue(size_t limit) : limit(limit) {}
+
+    // false when it's full
+    bool push(Job job)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (queue.size() >= limit) return false;
+        queue.push_back(std::move(job));
+        ready.notify_one();
+        return true;
+    }
+
+    // false once closed
+    bool pop(Job& job)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [&] { return closed || !queue.empty(); });
+        if (queue.empty()) return false;
+        job = std::move(queue.front());
+        queue.pop_front();
+        return true;
+    }
+
+    // wakes up the workers, requests that are still waiting are dropped
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        queue.clear();
+        ready.notify_all();
+    }
+
+private:
+    size_t limit;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Job> queue;
+    bool closed = false;
+};
+
+// one client as seen by the poll loop. it only ever has one request at a worker, so a line client gets its
+// answers in order and can't take more than one worker however many lines it sends
+struct Client {
+    enum class Protocol { Unknown, Lines, Http };
+
+    int fd;
+    Protocol protocol = Protocol::Unknown;
+    std::string in;
+    std::string out;
+    // complete lines that wait for the previous one to be answered
+    std::deque<std::string> pending;
+    bool in_flight = false;
+    // the client is done sending (or an http request was read), close once everything is answered
+    bool done_reading = false;
+    std::chrono::steady_clock::time_point last_active;
+};
+
+// a client that doesn't send, read or wait for an answer for this long is dropped
+static const auto IDLE_TIMEOUT = std::chrono::seconds(60);
+// request line + headers of an http request
+static const size_t MAX_HEADER_BYTES = 64 << 10;
+
+class EventLoop {
+public:
+    EventLoop(const ServerContext& context, RequestQueue& queue) : context(context), queue(queue) {}
+
+    void add(int fd)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        Client client;
+        client.fd = fd;
+        client.last_active = std::chrono::steady_clock::now();
+        clients.emplace(next_id++, std::move(client));
+    }
+
+    // the sockets to wait for, matching ids
+    void pollSet(std::vector<pollfd>& fds, std::vector<uint64_t>& ids) const
+    {
+        for (const auto& [id, client] : clients) {
+            short events = 0;
+            if (!client.done_reading) events |= POLLIN;
+            if (!client.out.empty()) events |= POLLOUT;
+            fds.push_back({client.fd, events, 0});
+            ids.push_back(id);
+        }
+    }
+
+    void handle(uint64_t id, short revents)
+    {
+        auto it = clients.find(id);
+        if (it == clients.end()) return;
+        Client& client = it->second;
+        if ((revents & (POLLIN | POLLHUP | POLLERR)) && !client.done_reading) receive(id, client);
+        if ((revents & POLLOUT) || !client.out.empty()) send(client);
+        closeIfFinished(it);
+    }
+
+    // answers the workers finished since last time
+    void deliver(std::vector<Answer>& answers)
+    {
+        for (auto& answer : answers) {
+            auto it = clients.find(answer.client);
+            // the client was dropped meanwhile
+            if (it == clients.end()) continue;
+            Client& client = it->second;
+            client.out += answer.data;
+            client.in_flight = false;
+            client.last_active = std::chrono::steady_clock::now();
+            dispatch(answer.client, client);
+            send(client);
+            closeIfFinished(it);
+        }
+        answers.clear();
+    }
+
+    void dropIdle()
+    {
+        auto now = std::chrono::steady_clock::now();
+        for (auto it = clients.begin(); it != clients.end();) {
+            if (!it->second.in_flight && now - it->second.last_active > IDLE_TIMEOUT) {
+                ::close(it->second.fd);
+                it = clients.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // writes what's left (blocking) and closes everything, after the workers are done
+    void shutdown()
+    {
+        for (auto& [id, client] : clients) {
+            fcntl(client.fd, F_SETFL, fcntl(client.fd, F_GETFL) & ~O_NONBLOCK);
+            ::send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+            ::close(client.fd);
+        }
+        clients.clear();
+    }
+
+private:
+    void receive(uint64_t id, Client& client)
+    {
+        char chunk[65536];
+        while (true) {
+            ssize_t n = recv(client.fd, chunk, sizeof(chunk), 0);
+            if (n > 0) {
+                client.in.append(chunk, n);
+                client.last_active = std::chrono::steady_clock::now();
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (n < 0 && errno == EINTR) continue;
+            // hung up (or half closed): what was sent so far still gets answered
+            client.done_reading = true;
+            break;
+        }
+
+        if (client.protocol == Client::Protocol::Unknown) {
+            bool decided = client.in.size() >= 4 || client.in.find('\n') != std::string::npos || client.done_reading;
+            if (!decided) return;
+            bool http = client.in.compare(0, 4, "GET ") == 0 || client.in.compare(0, 4, "POST") == 0;
+            client.protocol = http ? Client::Protocol::Http : Client::Protocol::Lines;
+        }
+        if (client.protocol == Client::Protocol::Http) {
+            readHttp(id, client);
+        } else {
+            readLines(id, client);
+        }
+    }
+
+    void readLines(uint64_t id, Client& client)
+    {
+        size_t start = 0;
+        for (size_t end; (end = client.in.find('\n', start)) != std::string::npos; start = end + 1) {
+            std::string line = client.in.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) client.pending.push_back(std::move(line));
+        }
+        client.in.erase(0, start);
+        if (client.in.size() > MAX_REQUEST_BYTES) {
+            // a line that never ends, nothing more is read from this client
+            client.in.clear();
+            client.done_reading = true;
+        }
+        dispatch(id, client);
+    }
+
+    // hands the next waiting line to a worker, unless one is still being solved
+    void dispatch(uint64_t id, Client& client)
+    {
+        while (!client.in_flight && !client.pending.empty()) {
+            json request = json::parse(client.pending.front(), nullptr, false);
+            client.pending.pop_front();
+            if (request.is_discarded()) {
+                client.out += errorResponse(json(), "invalid json").dump() + "\n";
+            } else if (!queue.push({id, std::move(request), false})) {
+                client.out += errorResponse(json(), "busy, try again later").dump() + "\n";
+            } else {
+                client.in_flight = true;
+            }
+        }
+    }
+
+    // one request per connection: request line, headers and a content-length body
+    void readHttp(uint64_t id, Client& client)
+    {
+        size_t header_end = client.in.find("\r\n\r\n");
+        size_t separator = 4;
+        if (header_end == std::string::npos) {
+            header_end = client.in.find("\n\n");
+            separator = 2;
+        }
+        if (header_end == std::string::npos) {
+            if (client.in.size() > MAX_HEADER_BYTES || client.done_reading) finishHttp(client, "400 Bad Request", errorResponse(json(), "incomplete request"));
+            return;
+        }
+
+        std::istringstream headers(client.in.substr(0, header_end));
+        std::string request_line, header;
+        std::getline(headers, request_line);
+        size_t content_length = 0;
+        while (std::getline(headers, header)) {
+            std::string name = header.substr(0, header.find(':'));
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            if (name == "content-length") content_length = std::strtoull(header.c_str() + name.size() + 1, nullptr, 10);
+        }
+
+        if (request_line.rfind("GET /health", 0) == 0) {
+            // answered right here, so a health check works even when every worker is busy
+            finishHttp(client, "200 OK", handleRequest(json{{"op", "status"}}, context));
+            return;
+        }
+        if (request_line.rfind("POST", 0) != 0) {
+            finishHttp(client, "404 Not Found", errorResponse(json(), "POST a request or GET /health"));
+            return;
+        }
+        if (content_length > MAX_REQUEST_BYTES) {
+            finishHttp(client, "413 Payload Too Large", errorResponse(json(), "request too big"));
+            return;
+        }
+        size_t body_start = header_end + separator;
+        if (client.in.size() < body_start + content_length) {
+            if (client.done_reading) finishHttp(client, "400 Bad Request", errorResponse(json(), "incomplete request"));
+            return;
+        }
+
+        json request = json::parse(client.in.substr(body_start, content_length), nullptr, false);
+        client.in.clear();
+        client.done_reading = true;
+        if (request.is_discarded()) {
+            finishHttp(client, "400 Bad Request", errorResponse(json(), "invalid json"));
+        } else if (!queue.push({id, std::move(request), true})) {
+            finishHttp(client, "503 Service Unavailable", errorResponse(json(), "busy, try again later"), "Retry-After: 1\r\n");
+        } else {
+            client.in_flight = true;
+        }
+    }
+
+    void finishHttp(Client& client, const std::string& status, const json& body, const std::string& extra_headers = "")
+    {
+        client.in.clear();
+        client.done_reading = true;
+        client.out += httpResponse(status, body, extra_headers);
+    }
+
+    void send(Client& client)
+    {
+        while (!client.out.empty()) {
+            ssize_t n = ::send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+            if (n > 0) {
+                client.out.erase(0, n);
+                client.last_active = std::chrono::steady_clock::now();
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return;
+            } else {
+                // the client is gone, nobody to answer anymore
+                client.out.clear();
+                client.pending.clear();
+                client.done_reading = true;
+                return;
+            }
+        }
+    }
+
+    void closeIfFinished(std::unordered_map<uint64_t, Client>::iterator it)
+    {
+        const Client& client = it->second;
+        if (client.done_reading && !client.in_flight && client.pending.empty() && client.out.empty()) {
+            ::close(client.fd);
+            clients.erase(it);
+        }
+    }
+
+    const ServerContext& context;
+    RequestQueue& queue;
+    std::unordered_map<uint64_t, Client> clients;
+    uint64_t next_id = 0;
+};
+
+int runServer(const ServerOptions& options, const ServerContext& context)
+{
+    std::vector<pollfd> listeners;
+    if (!options.socket_path.empty()) {
+        int fd = listenUnix(options.socket_path);
+        if (fd < 0) return 1;
+        listeners.push_back({fd, POLLIN, 0});
+    }
+    if (options.port > 0) {
+        int fd = listenTcp(options.port);
+        if (fd < 0) return 1;
+        listeners.push_back({fd, POLLIN, 0});
+    }
+    if (listeners.empty()) {
+        std::cerr << "nothing to listen on" << std::endl;
+        return 1;
+    }
+
+    // the workers wake up the poll loop through this pipe when they have an answer
+    int wake[2];
+    if (pipe(wake) < 0) {
+        std::cerr << "can't create a pipe: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    fcntl(wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake[1], F_SETFL, O_NONBLOCK);
+
+    stop_requested = false;
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int num_workers = options.workers > 0 ? options.workers : std::max(1u, std::thread::hardware_concurrency() / 2);
+    RequestQueue queue(std::max(1, options.queue_limit));
+    std::mutex answers_mutex;
+    std::vector<Answer> answers;
+    std::vector<std::thread> workers;
+    for (int w = 0; w < num_workers; ++w) {
+        workers.emplace_back([&] {
+            for (Job job; queue.pop(job);) {
+                json response = handleRequest(job.request, context);
+                std::string data = job.http ? httpResponse("200 OK", response) : response.dump() + "\n";
+                {
+                    std::lock_guard<std::mutex> lock(answers_mutex);
+                    answers.push_back({job.client, std::move(data)});
+                }
+                char byte = 0;
+                ssize_t ignored = write(wake[1], &byte, 1);
+                (void)ignored;
+            }
+        });
+    }
+
+    std::cout << "serving " << context.employees.size() << " employees and " << context.targets.size() << " targets";
+    if (!options.socket_path.empty()) std::cout << " on " << options.socket_path;
+    if (options.port > 0) std::cout << " on 127.0.0.1:" << options.port;
+    std::cout << " (" << num_workers << " workers)" << std::endl;
+
+    EventLoop loop(context, queue);
+    std::vector<pollfd> fds;
+    std::vector<uint64_t> ids;
+    std::vector<Answer> finished;
+    while (!stop_requested) {
+        // wake pipe, listeners, then the clients
+        fds.assign(1, {wake[0], POLLIN, 0});
+        fds.insert(fds.end(), listeners.begin(), listeners.end());
+        ids.clear();
+        loop.pollSet(fds, ids);
+
+        // wakes up now and then to notice a stop and drop idle clients
+        int ready = poll(fds.data(), fds.size(), 250);
+        loop.dropIdle();
+        if (ready <= 0) continue;
+
+        if (fds[0].revents & POLLIN) {
+            char drain[256];
+            while (read(wake[0], drain, sizeof(drain)) > 0) {
+            }
+            {
+                std::lock_guard<std::mutex> lock(answers_mutex);
+                finished.swap(answers);
+            }
+            loop.deliver(finished);
+        }
+        for (size_t l = 0; l < listeners.size(); ++l) {
+            if (!(fds[1 + l].revents & POLLIN)) continue;
+            int fd = accept(listeners[l].fd, nullptr, nullptr);
+            if (fd >= 0) loop.add(fd);
+        }
+        size_t first_client = 1 + listeners.size();
+        for (size_t c = 0; c < ids.size(); ++c) {
+            if (fds[first_client + c].revents) loop.handle(ids[c], fds[first_client + c].revents);
+        }
+    }
+
+    std::cout << "shutting down, finishing the running requests..." << std::endl;
+    for (const auto& listener : listeners) close(listener.fd);
+    if (!options.socket_path.empty()) unlink(options.socket_path.c_str());
+    queue.close();
+    for (auto& worker : workers) worker.join();
+    loop.deliver(answers);
+    loop.shutdown();
+    close(wake[0]);
+    close(wake[1]);
+    return 0;
+}
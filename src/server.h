@@ -0,0 +1,57 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "assignment.h"
+
+// solves one request: mode is "shortest", "balanced", "friends" or "roster"
+using SolveFn = std::function<AssignmentResult(const std::string& mode, const DistanceMatrix&, std::vector<Employee>&, std::vector<Target>&,
+    const RelationGraph&, const SolverOptions&)>;
+
+// parses the "targets" of a request, locates them and computes their distances to all resident employees.
+// false with a message in error if that didn't work out
+using TargetLoader = std::function<bool(const nlohmann::json& items, std::vector<Target>& targets, DistanceMatrix& distances, std::string& error)>;
+
+// everything that stays loaded between requests
+struct ServerContext {
+    std::vector<Employee> employees;
+    std::vector<Target> targets;
+    RelationGraph relations;
+    DistanceMatrix distances;
+    // what a request doesn't override
+    SolverOptions defaults;
+    std::string default_mode = "friends";
+
+    SolveFn solve;
+    TargetLoader load_targets;
+};
+
+struct ServerOptions {
+    // unix socket to listen on, empty = none
+    std::string socket_path;
+    // localhost tcp port (http or the line protocol), 0 = none
+    int port = 0;
+    // requests solved at the same time, 0 = half the cores
+    int workers = 0;
+    // requests waiting for a worker, any more are turned away with a "busy" error (503 over http)
+    int queue_limit = 16;
+};
+
+/* Keeps the roster, coordinates, relations and distance matrix loaded and answers assignment requests until
+SIGINT/SIGTERM, so a request only pays for its own model and solve.
+A request is a json object, either one per line (any number per connection, answered in order) or the body
+of an http POST (on the tcp port, "GET /health" for a status check):
+{"id": ..., "mode": "friends", "backend": "scip"|"cpsat", "time_limit": s, "gap": g, "k_nearest": n, "radius_km": r,
+ "unavailable": [employee ids], "targets": [target objects, "lat"/"lon" optional]}
+everything optional, without "targets" the loaded targets are planned. The answer is the --output json of the
+result plus "id" and "seconds", or {"id": ..., "error": "..."}. {"op": "status"} reports what's loaded.
+One poll loop reads every connection and only hands complete requests to the workers, one at a time per
+connection, so an idle or slow client never holds a worker; clients that stay quiet for a minute are dropped. */
+int runServer(const ServerOptions& options, const ServerContext& context);
+
+#endif
@@ -0,0 +1,19 @@
+#include "solverlog.h"
+
+#include <atomic>
+#include <iostream>
+
+static std::atomic<std::ostream*> log_stream{&std::cout};
+
+void setSolverLog(std::ostream* stream)
+{
+    log_stream = stream;
+}
+
+std::ostream& solverLog()
+{
+    // without a buffer every write is a no-op. one per thread, a failed write still sets its state
+    thread_local std::ostream discard(nullptr);
+    std::ostream* stream = log_stream.load(std::memory_order_relaxed);
+    return stream ? *stream : discard;
+}
@@ -0,0 +1,11 @@
+#ifndef SOLVERLOG_H
+#define SOLVERLOG_H
+
+#include <ostream>
+
+// where the solvers report their progress ("Optimal assignment found!", retries, days solved, ...).
+// stdout by default, nullptr switches it off, e.g. when the solvers are called as a library
+void setSolverLog(std::ostream* stream);
+std::ostream& solverLog();
+
+#endif
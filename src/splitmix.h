@@ -0,0 +1,29 @@
+#ifndef SPLITMIX_H
+#define SPLITMIX_H
+
+#include <cstdint>
+
+// splitmix64: unlike the <random> distributions its output is the same with every standard library,
+// so a seed gives the same roster (synthetic.h) or heuristic plan (heuristic.h) everywhere
+class SplitMix {
+public:
+    explicit SplitMix(uint64_t seed) : state(seed) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // [0, 1)
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+    // [0, n)
+    int below(int n) { return static_cast<int>(uniform() * n); }
+
+private:
+    uint64_t state;
+};
+
+#endif
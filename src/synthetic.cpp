@@ -0,0 +1,88 @@
+#include "synthetic.h"
+
+#include <cmath>
+#include <string>
+
+#include "splitmix.h"
+
+// a point at most radius_km from the center, uniformly spread over the disc
+static void randomPoint(SplitMix& rng, float center_lat, float center_lon, float radius_km, float& lat, float& lon)
+{
+    const double km_per_degree = 111.32;
+    double r = radius_km * std::sqrt(rng.uniform());
+    double angle = rng.uniform() * 2.0 * M_PI;
+    lat = static_cast<float>(center_lat + r * std::cos(angle) / km_per_degree);
+    lon = static_cast<float>(center_lon + r * std::sin(angle) / (km_per_degree * std::cos(center_lat * M_PI / 180.0)));
+}
+
+// rounds the expected number of names per employee up or down at random, so the average comes out right
+static int drawCount(SplitMix& rng, float per_employee)
+{
+    int count = static_cast<int>(per_employee);
+    if (rng.uniform() < per_employee - count) ++count;
+    return count;
+}
+
+void generateRoster(const SyntheticOptions& options, std::vector<Employee>& employees, std::vector<Target>& targets)
+{
+    SplitMix rng(options.seed);
+    employees.clear();
+    targets.clear();
+
+    employees.resize(options.num_employees);
+    for (int i = 0; i < options.num_employees; ++i) {
+        Employee& emp = employees[i];
+        emp.id = i + 1;
+        emp.name = "employee " + std::to_string(emp.id);
+        emp.address = "street " + std::to_string(emp.id);
+        emp.city = "city";
+        randomPoint(rng, options.center_lat, options.center_lon, options.radius_km, emp.lat, emp.lon);
+    }
+
+    // enemies and friends by name, like in the json files (never yourself)
+    if (options.num_employees > 1) {
+        for (auto& emp : employees) {
+            int num_conflicts = drawCount(rng, options.conflicts_per_employee);
+            for (int c = 0; c < num_conflicts; ++c) {
+                int other = rng.below(options.num_employees);
+                if (other + 1 != emp.id) emp.no_pair.push_back(employees[other].name);
+            }
+            int num_friends = drawCount(rng, options.friends_per_employee);
+            for (int f = 0; f < num_friends; ++f) {
+                int other = rng.below(options.num_employees);
+                if (other + 1 != emp.id) emp.friends.push_back(employees[other].name);
+            }
+        }
+    }
+
+    // a roster has an evening and a night shift per day, the targets take turns over those slots
+    int num_slots = options.num_days > 0 ? options.num_days * 2 : 1;
+    std::vector<std::vector<int>> slot_targets(num_slots);
+
+    targets.resize(options.num_targets);
+    for (int j = 0; j < options.num_targets; ++j) {
+        Target& tar = targets[j];
+        tar.target_number = j + 1;
+        tar.address = "target " + std::to_string(tar.target_number);
+        tar.city = "city";
+        tar.country = "nl";
+        tar.req_employees = 1;
+        randomPoint(rng, options.center_lat, options.center_lon, options.radius_km * 0.5f, tar.lat, tar.lon);
+
+        int slot = j % num_slots;
+        if (options.num_days > 0) {
+            tar.day = "day" + std::to_string(slot / 2);
+            tar.shift = slot % 2 == 0 ? "evening" : "night";
+        }
+        slot_targets[slot].push_back(j);
+    }
+
+    // everyone gets at least one person, the rest of a slot's share is handed out at random
+    int per_slot = static_cast<int>(options.num_employees * options.fill);
+    for (const auto& slot : slot_targets) {
+        if (slot.empty()) continue;
+        for (int k = slot.size(); k < per_slot; ++k) {
+            targets[slot[rng.below(slot.size())]].req_employees++;
+        }
+    }
+}
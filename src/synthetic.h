@@ -0,0 +1,35 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <cstdint>
+#include <vector>
+
+#include "assignment.h"
+
+// what a generated roster looks like. the same options (seed included) always give the same roster,
+// on every platform, so benchmark runs can be compared with each other
+struct SyntheticOptions {
+    int num_employees = 100;
+    int num_targets = 10;
+    uint64_t seed = 1;
+
+    // employees are spread around the center, targets somewhat closer to it
+    float center_lat = 52.09f;
+    float center_lon = 5.12f;
+    float radius_km = 60;
+
+    // share of the employees that are needed on the targets in total (<= 1 keeps it feasible)
+    float fill = 0.8f;
+    // average number of no_pair / friends names per employee
+    float conflicts_per_employee = 0.05f;
+    float friends_per_employee = 0.1f;
+
+    // > 0: the targets take turns over this many days ("day0", "day1", ...), each with an evening and a night
+    // shift, and fill applies per shift
+    int num_days = 0;
+};
+
+// a roster with coordinates already filled in (no geocoding needed), named "employee <id>" / "target <n>"
+void generateRoster(const SyntheticOptions& options, std::vector<Employee>& employees, std::vector<Target>& targets);
+
+#endif
@@ -0,0 +1,215 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    // 'X' = complete event (with a duration), 'i' = instant
+    char type;
+    int64_t start_us;
+    int64_t duration_us;
+    int thread;
+    json args;
+};
+
+struct TraceLog {
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    // small numbers instead of the opaque thread ids, the main thread is usually 0
+    std::unordered_map<std::thread::id, int> threads;
+
+    int threadNumber()
+    {
+        auto [it, inserted] = threads.try_emplace(std::this_thread::get_id(), threads.size());
+        return it->second;
+    }
+
+    int64_t micros(std::chrono::steady_clock::time_point t) const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(t - epoch).count();
+    }
+};
+
+TraceLog& traceLog()
+{
+    static TraceLog log;
+    return log;
+}
+}
+
+void enableTracing()
+{
+    traceLog().enabled = true;
+}
+
+bool tracingEnabled()
+{
+    return traceLog().enabled.load(std::memory_order_relaxed);
+}
+
+ScopedTimer::ScopedTimer(const char* name, const char* category) : name(name), category(category), active(tracingEnabled())
+{
+    if (active) start = std::chrono::steady_clock::now();
+}
+
+ScopedTimer::~ScopedTimer()
+{
+    stop();
+}
+
+void ScopedTimer::stop()
+{
+    if (!active) return;
+    active = false;
+    auto end = std::chrono::steady_clock::now();
+
+    json args = json::object();
+    for (const auto& [key, value] : number_args) args[key] = value;
+    for (const auto& [key, value] : string_args) args[key] = value;
+
+    TraceLog& log = traceLog();
+    std::lock_guard<std::mutex> lock(log.mutex);
+    int64_t start_us = log.micros(start);
+    log.events.push_back({name, category, 'X', start_us, log.micros(end) - start_us, log.threadNumber(), std::move(args)});
+}
+
+void ScopedTimer::arg(const char* key, double value)
+{
+    if (active) number_args.emplace_back(key, value);
+}
+
+void ScopedTimer::arg(const char* key, const std::string& value)
+{
+    if (active) string_args.emplace_back(key, value);
+}
+
+void traceInstant(const char* name, const std::vector<std::pair<const char*, double>>& values)
+{
+    if (!tracingEnabled()) return;
+
+    json args = json::object();
+    for (const auto& [key, value] : values) args[key] = value;
+
+    TraceLog& log = traceLog();
+    std::lock_guard<std::mutex> lock(log.mutex);
+    log.events.push_back({name, "stats", 'i', log.micros(std::chrono::steady_clock::now()), 0, log.threadNumber(), std::move(args)});
+}
+
+bool writeChromeTrace(const std::string& path)
+{
+    TraceLog& log = traceLog();
+    json events = json::array();
+    {
+        std::lock_guard<std::mutex> lock(log.mutex);
+        for (const auto& e : log.events) {
+            json event = {
+                {"name", e.name},
+                {"cat", e.category},
+                {"ph", std::string(1, e.type)},
+                {"ts", e.start_us},
+                {"pid", 1},
+                {"tid", e.thread},
+                {"args", e.args},
+            };
+            if (e.type == 'X') {
+                event["dur"] = e.duration_us;
+            } else {
+                // instants span the whole process track
+                event["s"] = "p";
+            }
+            events.push_back(std::move(event));
+        }
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "can't write trace " << path << std::endl;
+        return false;
+    }
+    file << json{{"traceEvents", events}, {"displayTimeUnit", "ms"}}.dump();
+    return file.good();
+}
+
+static std::string formatDuration(int64_t us)
+{
+    char buffer[32];
+    if (us < 1000000) {
+        std::snprintf(buffer, sizeof(buffer), "%.1f ms", us / 1000.0);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%.2f s", us / 1000000.0);
+    }
+    return buffer;
+}
+
+std::string traceSummary()
+{
+    TraceLog& log = traceLog();
+    std::lock_guard<std::mutex> lock(log.mutex);
+
+    // a phase that ran more than once (e.g. a retried solve) is summed up
+    std::vector<std::pair<std::string, int64_t>> phases;
+    std::vector<const TraceEvent*> phase_events;
+    for (const auto& e : log.events) {
+        if (e.type == 'X' && std::string(e.category) == "phase") phase_events.push_back(&e);
+    }
+    std::sort(phase_events.begin(), phase_events.end(), [](const TraceEvent* a, const TraceEvent* b) { return a->start_us < b->start_us; });
+    for (const TraceEvent* e : phase_events) {
+        auto it = std::find_if(phases.begin(), phases.end(), [&](const auto& p) { return p.first == e->name; });
+        if (it == phases.end()) {
+            phases.emplace_back(e->name, e->duration_us);
+        } else {
+            it->second += e->duration_us;
+        }
+    }
+
+    std::ostringstream out;
+    for (size_t p = 0; p < phases.size(); ++p) {
+        out << (p ? " | " : "") << phases[p].first << " " << formatDuration(phases[p].second);
+    }
+
+    // the requests overlap (several workers), so this is the time spent waiting on them, not wall time
+    int num_requests = 0;
+    int64_t request_us = 0;
+    for (const auto& e : log.events) {
+        if (e.type == 'X' && std::string(e.category) == "http") {
+            ++num_requests;
+            request_us += e.duration_us;
+        }
+    }
+    if (num_requests > 0) {
+        out << " | " << num_requests << " http requests " << formatDuration(request_us);
+    }
+
+    for (const auto& e : log.events) {
+        if (e.type != 'i') continue;
+        out << " | " << e.name;
+        for (auto it = e.args.begin(); it != e.args.end(); ++it) {
+            double value = it.value().get<double>();
+            out << " " << it.key() << "=";
+            if (value == std::floor(value) && std::abs(value) < 1e15) {
+                out << static_cast<int64_t>(value);
+            } else {
+                out << value;
+            }
+        }
+    }
+    return out.str();
+}
@@ -0,0 +1,59 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Timing of the pipeline phases, http requests and solves. Off by default: a ScopedTimer then only checks a
+flag and doesn't even read the clock. Once enabled every timer becomes a "complete" event, which can be
+written as a Chrome trace (chrome://tracing or ui.perfetto.dev) or summed up into one line.
+Safe to use from any thread, every thread shows up as its own track. */
+
+void enableTracing();
+bool tracingEnabled();
+
+// name and category have to outlive the trace (string literals)
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const char* name, const char* category = "vrp");
+    ~ScopedTimer();
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    // ends the event before the end of the scope
+    void stop();
+
+    // extra info shown with the event, e.g. the http status
+    void arg(const char* key, double value);
+    void arg(const char* key, const std::string& value);
+
+private:
+    const char* name;
+    const char* category;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+    std::vector<std::pair<const char*, double>> number_args;
+    std::vector<std::pair<const char*, std::string>> string_args;
+};
+
+// the top level steps of a run (loading, geocoding, distances, solving, ...), these make up the summary
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_PHASE(name) ScopedTimer TRACE_CONCAT(trace_phase_, __LINE__)(name, "phase")
+#define TRACE_SCOPE(name) ScopedTimer TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+// a point in time with some numbers attached, e.g. the solver statistics
+void traceInstant(const char* name, const std::vector<std::pair<const char*, double>>& values);
+
+// chrome trace event format, false if the file can't be written
+bool writeChromeTrace(const std::string& path);
+
+// "load 12.0 ms | geocode 3.41 s | ..." over the phases in the order they started, then the number of http
+// requests and the instants (solver statistics)
+std::string traceSummary();
+
+#endif
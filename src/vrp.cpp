@@ -0,0 +1,144 @@
+#include "vrp.h"
+
+#include "haversine.h"
+#include "relations.h"
+#include "roster.h"
+#include "solverlog.h"
+
+namespace vrp {
+
+bool parseMode(const std::string& name, Mode& mode)
+{
+    if (name == "shortest") {
+        mode = Mode::Shortest;
+    } else if (name == "balanced") {
+        mode = Mode::Balanced;
+    } else if (name == "friends") {
+        mode = Mode::Friends;
+    } else if (name == "roster") {
+        mode = Mode::Roster;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+AssignmentResult solve(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets,
+    const RelationGraph& relations, const Options& options)
+{
+    SolverOptions solver_options = options.solver;
+    bool plain_assignment = options.mode == Mode::Shortest || (options.mode == Mode::Friends && relations.empty());
+    bool exact_model = options.mode == Mode::Friends || (plain_assignment && !options.use_flow);
+    // the shortest mode doesn't look at enemies and friends
+    static const RelationGraph no_relations;
+    const RelationGraph& used_relations = plain_assignment ? no_relations : relations;
+
+    if (options.use_heuristic && (plain_assignment || options.mode == Mode::Friends)) {
+        return operations_research::assignEmployeesHeuristic(distances, employees, targets, used_relations, options.heuristic);
+    }
+    if (options.warm_start && exact_model) {
+        AssignmentResult plan = operations_research::assignEmployeesHeuristic(distances, employees, targets, used_relations, options.heuristic);
+        if (plan.solved()) {
+            solver_options.hint.clear();
+            for (const auto& pair : plan.pairs) {
+                solver_options.hint.emplace_back(pair.employee, pair.target);
+            }
+        }
+    }
+
+    if (options.mode == Mode::Roster) {
+        return operations_research::assignRoster(distances, employees, targets, relations, solver_options);
+    } else if (options.mode == Mode::Balanced) {
+        // closer distribution of distances:
+        return operations_research::assignEmployeesBalanced(distances, employees, targets, solver_options);
+    } else if (plain_assignment && options.use_flow) {
+        // shortest amount of distance
+        return operations_research::assignEmployeesMinCostFlow(distances, employees, targets, solver_options);
+    } else if (plain_assignment) {
+        return operations_research::assignEmployees(distances, employees, targets, solver_options);
+    } else if (solver_options.backend == Backend::CpSat) {
+        /// takes into account enemies / people who always want to be on the same location
+        return operations_research::assignEmployeesEnemiesAndFriendsCpSat(distances, employees, targets, relations, solver_options);
+    }
+    return operations_research::assignEmployeesEnemiesAndFriends(distances, employees, targets, relations, solver_options);
+}
+
+const AssignmentResult& Context::solve(const Problem& problem, const Options& options)
+{
+    size_t num_employees = problem.employees.size();
+    size_t num_targets = problem.targets.size();
+
+    // cleared in place so the pairs keep their capacity between calls
+    result.solver.clear();
+    result.status = SolveStatus::NotSolved;
+    result.gap = result.total_km = result.longest_km = 0;
+    result.pairs.clear();
+    result.stats = SolverStats();
+    if (problem.required.size() != num_targets) {
+        solverLog() << "every target needs a requirement (" << num_targets << " targets, " << problem.required.size() << " requirements)" << std::endl;
+        return result;
+    }
+    if (!problem.distances.empty() && problem.distances.size() != num_targets * num_employees) {
+        solverLog() << "the distances don't match " << num_employees << " employees and " << num_targets << " targets" << std::endl;
+        return result;
+    }
+    if (options.mode == Mode::Roster) {
+        solverLog() << "a Problem has no days or shifts, use vrp::solve with the targets for a roster" << std::endl;
+        return result;
+    }
+
+    // the solvers only look at the indices, coordinates and requirements of these records
+    employees.resize(num_employees);
+    matrix.num_employees = num_employees;
+    matrix.emp_lat.resize(num_employees);
+    matrix.emp_lon.resize(num_employees);
+    for (size_t e = 0; e < num_employees; ++e) {
+        employees[e].id = e;
+        employees[e].lat = matrix.emp_lat[e] = problem.employees[e].lat;
+        employees[e].lon = matrix.emp_lon[e] = problem.employees[e].lon;
+    }
+
+    int required = 0;
+    targets.resize(num_targets);
+    matrix.num_targets = num_targets;
+    matrix.tar_lat.resize(num_targets);
+    matrix.tar_lon.resize(num_targets);
+    for (size_t t = 0; t < num_targets; ++t) {
+        if (problem.required[t] < 0) {
+            solverLog() << "target " << t << " requires " << problem.required[t] << " employees" << std::endl;
+            return result;
+        }
+        targets[t].target_number = t;
+        targets[t].req_employees = problem.required[t];
+        targets[t].lat = matrix.tar_lat[t] = problem.targets[t].lat;
+        targets[t].lon = matrix.tar_lon[t] = problem.targets[t].lon;
+        required += problem.required[t];
+    }
+    if (required > (int)num_employees) {
+        solverLog() << "Not enough resources! " << required << " employees required, " << num_employees << " available" << std::endl;
+        return result;
+    }
+
+    if (problem.distances.empty()) {
+        fillDistanceMatrix(matrix);
+    } else {
+        matrix.mapped = nullptr;
+        matrix.mapping.reset();
+        matrix.dist.assign(problem.distances.begin(), problem.distances.end());
+    }
+
+    setRelations(relations, problem.conflicts.data(), problem.conflicts.size(), problem.friends.data(), problem.friends.size(), num_employees);
+
+    // copied field by field, assigning the returned result would replace the context's pairs buffer with the solver's
+    AssignmentResult solved = vrp::solve(matrix, employees, targets, relations, options);
+    result.solver = solved.solver;
+    result.status = solved.status;
+    result.gap = solved.gap;
+    result.total_km = solved.total_km;
+    result.longest_km = solved.longest_km;
+    result.pairs.assign(solved.pairs.begin(), solved.pairs.end());
+    result.stats = solved.stats;
+    return result;
+}
+
+}
@@ -0,0 +1,112 @@
+#ifndef VRP_H
+#define VRP_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "assignment.h"
+#include "heuristic.h"
+
+/* The library side of the planner (the "vrp" target), for calling the solvers in-process instead of running
+main and reading its output. Solvers report progress through solverLog() (solverlog.h), which a service will
+usually switch off. */
+
+namespace vrp {
+
+// read-only view of someone else's array, like std::span<const T>
+template <typename T>
+class Span {
+public:
+    Span() = default;
+    Span(const T* data, size_t size) : ptr(data), count(size) {}
+    Span(const std::vector<T>& values) : ptr(values.data()), count(values.size()) {}
+
+    const T* data() const { return ptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+
+private:
+    const T* ptr = nullptr;
+    size_t count = 0;
+};
+
+enum class Mode {
+    // least total distance
+    Shortest,
+    // smallest longest distance, then the least total distance
+    Balanced,
+    // least total distance, enemies apart and friends rewarded for ending up together
+    Friends,
+    // every day/shift of the targets at once (see roster.h)
+    Roster,
+};
+
+// "shortest", "balanced", "friends" or "roster", false for anything else
+bool parseMode(const std::string& name, Mode& mode);
+
+struct Options {
+    Mode mode = Mode::Friends;
+    // without enemies or friends the assignment is solved as a min cost flow instead of a MIP
+    bool use_flow = true;
+    // shortest/friends: answer with the heuristic plan (heuristic.h) instead of an exact solve
+    bool use_heuristic = false;
+    // shortest/friends with a scip or cp-sat model: start it from the heuristic plan (solver.hint)
+    bool warm_start = false;
+    HeuristicOptions heuristic;
+    SolverOptions solver;
+};
+
+// picks the solver for the mode: without conflicts/friends the model is a plain transportation problem, which the
+// min cost flow solves exactly and a lot faster than the MIP (unless use_flow is off)
+AssignmentResult solve(const DistanceMatrix& distances, std::vector<Employee>& employees, std::vector<Target>& targets,
+    const RelationGraph& relations, const Options& options);
+
+struct Location {
+    float lat;
+    float lon;
+};
+
+// one planning problem, by index: employee e is employees[e], target t is targets[t]. nothing is copied
+// out of these arrays beyond what the solvers need
+struct Problem {
+    Span<Location> employees;
+    Span<Location> targets;
+    // required[t] people on target t, never negative
+    Span<int> required;
+    // employee index pairs, either order, duplicates are fine
+    Span<std::pair<int, int>> conflicts;
+    Span<std::pair<int, int>> friends;
+    // own distances (e.g. over the roads), target-major: distances[t * employees.size() + e].
+    // empty = great circle distances from the locations
+    Span<float> distances;
+};
+
+/* Holds everything a solve needs besides the solver itself: the distance matrix, the employee/target records
+and the relation graph. They keep their capacity between calls, so solving one problem after the other (or
+the same one with other options) only allocates for the models and the solver's own result, which is
+copied into the context's pairs buffer. One context per thread. */
+class Context {
+public:
+    // the result stays valid until the next solve on this context. Mode::Roster isn't available here,
+    // a Problem has no days or shifts
+    const AssignmentResult& solve(const Problem& problem, const Options& options);
+
+    // the distances of the last solve
+    const DistanceMatrix& distances() const { return matrix; }
+
+private:
+    DistanceMatrix matrix;
+    std::vector<Employee> employees;
+    std::vector<Target> targets;
+    RelationGraph relations;
+    AssignmentResult result;
+};
+
+}
+
+#endif
@@ -0,0 +1,64 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "haversine.h"
+
+/* haversineBatch against the scalar haversine() on random points, in both precisions. The scalar formula
+rounds to float along the way, so they're allowed to differ by 1 m plus 0.01% of the distance. */
+
+// deterministic points: mostly around the netherlands (short distances), some anywhere on earth
+static void randomPoints(uint64_t seed, size_t n, std::vector<float>& lat, std::vector<float>& lon)
+{
+    uint64_t state = seed;
+    auto uniform = [&]() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (state >> 11) * (1.0 / 9007199254740992.0);
+    };
+    for (size_t i = 0; i < n; ++i) {
+        if (i % 4 == 0) {
+            lat.push_back(-89.0 + 178.0 * uniform());
+            lon.push_back(-180.0 + 360.0 * uniform());
+        } else {
+            lat.push_back(50.7 + 2.8 * uniform());
+            lon.push_back(3.3 + 3.9 * uniform());
+        }
+    }
+}
+
+static int checkPrecision(Precision precision, const char* name)
+{
+    std::vector<float> from_lat, from_lon, to_lat, to_lon;
+    randomPoints(1, 64, from_lat, from_lon);
+    // an odd count, so the simd tail is covered too
+    randomPoints(2, 1001, to_lat, to_lon);
+
+    PreparedPoints from = preparePoints(from_lat, from_lon, precision);
+    PreparedPoints to = preparePoints(to_lat, to_lon, precision);
+    std::vector<float> out(to.size());
+
+    int failures = 0;
+    double worst = 0;
+    for (size_t i = 0; i < from.size(); ++i) {
+        haversineBatch(from, i, to, out.data());
+        for (size_t j = 0; j < to.size(); ++j) {
+            double expected = haversine(from_lat[i], from_lon[i], to_lat[j], to_lon[j]);
+            double error = std::abs(out[j] - expected);
+            worst = std::max(worst, error);
+            if (error > 0.001 + 1e-4 * expected) {
+                if (++failures <= 5) {
+                    std::printf("%s: (%f, %f) -> (%f, %f): batch %f km, scalar %f km\n", name, from_lat[i], from_lon[i], to_lat[j], to_lon[j], out[j], expected);
+                }
+            }
+        }
+    }
+    std::printf("%s (%s): %d failure(s), largest difference %g km\n", name, haversineKernelName(), failures, worst);
+    return failures;
+}
+
+int main()
+{
+    int failures = checkPrecision(Precision::Single, "single") + checkPrecision(Precision::Double, "double");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "roadgraph.h"
+
+/* The bucket many-to-many query of the contraction hierarchy against a plain dijkstra on a synthetic road
+graph (a grid with a lake in the middle), and a saved hierarchy that has to be rejected once the graph
+changes. */
+
+static const uint32_t UNREACHABLE = std::numeric_limits<uint32_t>::max();
+
+// metres from source to every node over the original (undirected) roads
+static std::vector<uint32_t> dijkstra(const RoadGraph& graph, uint32_t source)
+{
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> adjacency(graph.numNodes());
+    for (const auto& e : graph.edges) {
+        adjacency[e.from].emplace_back(e.to, e.metres);
+        adjacency[e.to].emplace_back(e.from, e.metres);
+    }
+
+    std::vector<uint32_t> dist(graph.numNodes(), UNREACHABLE);
+    using Entry = std::pair<uint32_t, uint32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    dist[source] = 0;
+    queue.emplace(0, source);
+    while (!queue.empty()) {
+        auto [d, v] = queue.top();
+        queue.pop();
+        if (d > dist[v]) continue;
+        for (const auto& [w, metres] : adjacency[v]) {
+            if (d + metres < dist[w]) {
+                dist[w] = d + metres;
+                queue.emplace(dist[w], w);
+            }
+        }
+    }
+    return dist;
+}
+
+static int checkManyToMany(const RoadGraph& graph, const ContractionHierarchy& hierarchy)
+{
+    std::vector<uint32_t> sources, targets;
+    uint32_t n = graph.numNodes();
+    for (uint32_t i = 0; i < 40; ++i) {
+        sources.push_back((i * 7919u) % n);
+    }
+    for (uint32_t i = 0; i < 25; ++i) {
+        targets.push_back((i * 104729u + 13) % n);
+    }
+
+    std::vector<uint32_t> out;
+    hierarchy.manyToMany(sources, targets, out);
+
+    int failures = 0;
+    for (size_t s = 0; s < sources.size(); ++s) {
+        std::vector<uint32_t> expected = dijkstra(graph, sources[s]);
+        for (size_t t = 0; t < targets.size(); ++t) {
+            uint32_t got = out[t * sources.size() + s];
+            if (got != expected[targets[t]] && ++failures <= 5) {
+                std::printf("%u -> %u: hierarchy %u m, dijkstra %u m\n", sources[s], targets[t], got, expected[targets[t]]);
+            }
+        }
+    }
+    std::printf("many-to-many: %zu x %zu pairs, %d failure(s)\n", sources.size(), targets.size(), failures);
+    return failures;
+}
+
+static int checkStaleFile(RoadGraph graph, const ContractionHierarchy& hierarchy)
+{
+    const std::string path = "roadgraph_test.ch";
+    int failures = 0;
+    ContractionHierarchy loaded;
+    if (!hierarchy.save(path) || !loaded.load(path, graph)) {
+        std::printf("saved hierarchy doesn't load for its own graph\n");
+        ++failures;
+    }
+
+    // same junctions and roads, one road got longer
+    graph.edges[graph.edges.size() / 2].metres += 250;
+    if (loaded.load(path, graph)) {
+        std::printf("hierarchy of the old graph was accepted for the edited one\n");
+        ++failures;
+    }
+    std::remove(path.c_str());
+    std::printf("stale hierarchy: %d failure(s)\n", failures);
+    return failures;
+}
+
+int main()
+{
+    RoadGraph graph = syntheticRoadGraph(52.0f, 4.6f, 52.4f, 5.1f, 30, 30);
+    ContractionHierarchy hierarchy(graph);
+    int failures = checkManyToMany(graph, hierarchy) + checkStaleFile(graph, hierarchy);
+    return failures == 0 ? 0 : 1;
+}